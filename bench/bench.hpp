@@ -0,0 +1,62 @@
+#pragma once
+// Shared helpers for the editor_bench target.
+#include "editor.hpp"
+#include <chrono>
+#include <string>
+
+/*** timing ***/
+
+template <typename F>
+double nsPerOp(int iterations, F&& fn) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		fn(i);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// best of a few runs of something slow, in milliseconds
+template <typename F>
+double bestMs(int runs, F&& fn) {
+	double best = 0;
+	for (int i = 0; i < runs; i++) {
+		double ms = nsPerOp(1, fn) / 1e6;
+		if (i == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+// keeps the optimizer from dropping a result
+extern volatile int sink;
+
+/*** results ***/
+
+bool benchEnabled(const char* name);
+void benchRecord(const char* name, const char* corpus, double value, const char* unit, long long iterations);
+
+/*** corpora ***/
+
+struct corpus {
+	const char* name;
+	std::string text;
+};
+
+std::string makeMinified(int size);
+std::string makeTabHeavy(int size);
+std::string makeShortLines(int size);
+std::string makeCommentHeavy(int size);
+std::string makeCrlfLines(int size);
+bool writeLogFile(const std::string& path, long long size);
+
+std::string benchPath(const char* name);
+bool writeFile(const std::string& path, const std::string& text);
+
+// replaces the buffer with text split into rows, without touching the disk
+void loadBuffer(const std::string& text, const char* filename);
+void clearBuffer();
+
+/*** suites ***/
+
+void benchMicro(const corpus* corpora, int count, int size);
+void benchMacro(const corpus* corpora, int count, long long logBytes);
@@ -0,0 +1,162 @@
+// Generated inputs for the benchmarks, deterministic so runs can be compared.
+#include "bench.hpp"
+#include "editorBrackets.hpp"
+#include "editorEol.hpp"
+#include "editorFold.hpp"
+#include "editorMem.hpp"
+#include "editorSymbols.hpp"
+#include "editorWords.hpp"
+#include "editorWrap.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/*** text ***/
+
+static std::string repeatPieces(const char* const* pieces, int count, int size) {
+	std::string s;
+	s.reserve(size);
+	for (int i = 0; (int)s.size() < size; i++)
+		s += pieces[i % count];
+	s.resize(size);
+	return s;
+}
+
+// one huge line, as minified javascript comes
+std::string makeMinified(int size) {
+	static const char* pieces[] = {"var a=1;", "function(b){return b*2}", "if(x){y()}else{z()};", "{\"k\":[1,2,3]},"};
+	return repeatPieces(pieces, 4, size);
+}
+
+// one huge line that is mostly tabs
+std::string makeTabHeavy(int size) {
+	static const char* pieces[] = {"\t", "x", "\t\t", "yy", "zzz", "\t", "w"};
+	return repeatPieces(pieces, 7, size);
+}
+
+// ordinary source, lots of short lines
+std::string makeShortLines(int size) {
+	static const char* pieces[] = {
+		"int main(int argc, char** argv) {\n", "\tint total = 0;\n", "\tfor (int i = 0; i < argc; i++)\n",
+		"\t\ttotal += strlen(argv[i]);\n",	   "\tprintf(\"%d\\n\", total);\n", "\treturn 0;\n",
+		"}\n",								   "\n"};
+	return repeatPieces(pieces, 8, size);
+}
+
+// C where most lines sit inside block comments, the worst case for comment state propagation
+std::string makeCommentHeavy(int size) {
+	static const char* pieces[] = {"/*\n",
+								   " * Lorem ipsum dolor sit amet, consectetur adipiscing elit.\n",
+								   " * if (x) return y; \"not a string\" 12345\n",
+								   " */\n",
+								   "static int value = 42; // trailing comment\n",
+								   "/* short */ int x = 1; /* another */\n"};
+	return repeatPieces(pieces, 6, size);
+}
+
+// the short lines as a Windows editor would save them
+std::string makeCrlfLines(int size) {
+	static const char* pieces[] = {
+		"int main(int argc, char** argv) {\r\n", "\tint total = 0;\r\n", "\tfor (int i = 0; i < argc; i++)\r\n",
+		"\t\ttotal += strlen(argv[i]);\r\n",	   "\tprintf(\"%d\\n\", total);\r\n", "\treturn 0;\r\n",
+		"}\r\n",								   "\r\n"};
+	return repeatPieces(pieces, 8, size);
+}
+
+/*** files ***/
+
+std::string benchPath(const char* name) {
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "kilo_bench";
+	std::filesystem::create_directories(dir);
+	return (dir / name).string();
+}
+
+bool writeFile(const std::string& path, const std::string& text) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(text.data(), text.size());
+	return file.good();
+}
+
+// a server log of about size bytes, written in blocks so it never has to fit in memory
+bool writeLogFile(const std::string& path, long long size) {
+	static const char* levels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+	static const char* messages[] = {"request handled", "cache miss for key user:%d", "slow query took %d ms",
+									 "connection reset by peer %d"};
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	std::string block;
+	char line[160];
+	long long written = 0;
+	unsigned seed = 12345;
+	for (long long n = 0; written < size; n++) {
+		seed = seed * 1103515245u + 12345u;
+		char message[64];
+		snprintf(message, sizeof(message), messages[(seed >> 8) % 4], static_cast<int>(seed >> 16));
+		int len = snprintf(line, sizeof(line), "2024-01-01T%02lld:%02lld:%02lld.%03lld [%s] worker-%u: %s\n",
+						   (n / 3600000) % 24, (n / 60000) % 60, (n / 1000) % 60, n % 1000, levels[(seed >> 4) % 4],
+						   (seed >> 12) % 16, message);
+		block.append(line, len);
+		written += len;
+		if (block.size() >= (1 << 20)) {
+			file.write(block.data(), block.size());
+			block.clear();
+		}
+	}
+	file.write(block.data(), block.size());
+	return file.good();
+}
+
+/*** buffer ***/
+
+void clearBuffer() {
+	for (int i = 0; i < E.numrows; i++)
+		editorFreeRow(&E.row[i]);
+	memFree(MEM_ROWS, E.row);
+	E.row = NULL;
+	E.numrows = 0;
+	E.cx = E.cy = E.rx = 0;
+	E.rowoff = E.wrapoff = E.coloff = 0;
+	E.dirty = 0;
+	E.match_row = -1;
+	free(E.filename);
+	E.filename = NULL;
+	E.syntax = NULL;
+	E.eol = EOL_LF;
+	E.noeol = false;
+	editorWordsFree(E.words);
+	E.words = NULL;
+	editorSymbolsFree(E.symbols);
+	E.symbols = NULL;
+	editorBracketsFree(E.brackets);
+	E.brackets = NULL;
+	editorFoldFree(E.folds);
+	E.folds = NULL;
+	editorWrapFree(E.wraps);
+	E.wraps = NULL;
+}
+
+void loadBuffer(const std::string& text, const char* filename) {
+	clearBuffer();
+	if (filename) {
+		E.filename = strdup(filename);
+		editorSelectSyntaxHighlight();
+	}
+	std::vector<rowText> lines;
+	const char* p = text.data();
+	const char* end = p + text.size();
+	while (p < end) {
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = nl ? nl : end;
+		lines.push_back({p, static_cast<int>(lineEnd - p), false});
+		if (!nl)
+			break;
+		p = nl + 1;
+	}
+	editorSpliceRows(0, 0, lines.data(), static_cast<int>(lines.size()));
+	E.dirty = 0;
+}
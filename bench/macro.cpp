@@ -0,0 +1,95 @@
+// Macro benchmarks: whole file operations through the same paths the editor uses.
+#include "bench.hpp"
+#include "editorMem.hpp"
+#include "editorPager.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static double mbPerSecond(long long bytes, double ms) {
+	return ms > 0 ? bytes / (1024.0 * 1024.0) / (ms / 1e3) : 0;
+}
+
+static void benchFile(const corpus& c) {
+	std::string path = benchPath((std::string(c.name) + ".c").c_str());
+	writeFile(path, c.text);
+	long long bytes = static_cast<long long>(c.text.size());
+
+	if (benchEnabled("open")) {
+		double ms = bestMs(3, [&](int) {
+			clearBuffer();
+			editorOpen(path.c_str());
+		});
+		benchRecord("open", c.name, ms, "ms", 3);
+		benchRecord("open_throughput", c.name, mbPerSecond(bytes, ms), "MB/s", 3);
+	}
+
+	if (benchEnabled("save")) {
+		if (E.numrows == 0)
+			editorOpen(path.c_str());
+		double ms = bestMs(3, [&](int) {
+			E.disk_changed = 0;
+			editorSave();
+		});
+		benchRecord("save", c.name, ms, "ms", 3);
+		benchRecord("save_throughput", c.name, mbPerSecond(bytes, ms), "MB/s", 3);
+	}
+
+	// opening a block comment on the first row recolors everything below it, closing it again too
+	if (benchEnabled("comment_cascade")) {
+		loadBuffer(c.text, "bench.c");
+		erow* row = &E.row[0];
+		double ms = bestMs(3, [&](int) {
+			row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + 3));
+			memmove(row->chars + 2, row->chars, row->size + 1);
+			memcpy(row->chars, "/*", 2);
+			row->size += 2;
+			editorRowChanged(row, 0, 2);
+
+			memmove(row->chars, row->chars + 2, row->size - 1);
+			row->size -= 2;
+			editorRowChanged(row, 0, -2);
+		});
+		benchRecord("comment_cascade", c.name, ms, "ms", 3);
+	}
+
+	clearBuffer();
+	remove(path.c_str());
+}
+
+// the log is far too big to hold as rows, so it goes through the pager like --pager would
+static void benchLog(long long logBytes) {
+	if (logBytes <= 0 || !benchEnabled("log"))
+		return;
+	std::string path = benchPath("server.log");
+	if (!writeLogFile(path, logBytes)) {
+		fprintf(stderr, "cannot write %s\n", path.c_str());
+		return;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "log-%lldM", logBytes >> 20);
+
+	clearBuffer();
+	double ms = bestMs(1, [&](int) { editorPagerOpen(path.c_str()); });
+	benchRecord("log_pager_open", name, ms, "ms", 1);
+	benchRecord("log_pager_goto_end", name, bestMs(1, [&](int) { editorPagerGoto("100%"); }), "ms", 1);
+	benchRecord("log_pager_goto_middle", name, bestMs(1, [&](int) { editorPagerGoto("50%"); }), "ms", 1);
+	benchRecord("log_draw_rows", name, nsPerOp(200, [&](int) {
+					struct abuf ab = {nullptr, 0};
+					editorDrawRows(&ab);
+					sink = ab.len;
+					abFree(&ab);
+				}),
+				"ns", 200);
+
+	editorPagerClose();
+	E.readonly = 0;
+	clearBuffer();
+	remove(path.c_str());
+}
+
+void benchMacro(const corpus* corpora, int count, long long logBytes) {
+	for (int i = 0; i < count; i++)
+		benchFile(corpora[i]);
+	benchLog(logBytes);
+}
@@ -0,0 +1,116 @@
+// Benchmarks for the editor core, built as the editor_bench target.
+//
+//   editor_bench [--json=<file>] [--filter=<name>] [--size-mb=<MB>] [--log-mb=<MB>]
+//
+// Results are printed as a table and, with --json, written out for tracking across releases.
+#include "bench.hpp"
+#include "config.hpp"
+#include "editorTheme.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+volatile int sink;
+
+/*** results ***/
+
+struct benchResult {
+	std::string name;
+	std::string corpus;
+	double value;
+	std::string unit;
+	long long iterations;
+};
+
+static std::vector<benchResult> results;
+static const char* filter = NULL;
+
+bool benchEnabled(const char* name) {
+	return filter == NULL || strstr(name, filter) != NULL || strstr(filter, name) != NULL;
+}
+
+void benchRecord(const char* name, const char* corpus, double value, const char* unit, long long iterations) {
+	if (!benchEnabled(name))
+		return;
+	results.push_back({name, corpus, value, unit, iterations});
+	printf("%-24s %-16s %14.1f %-5s\n", name, corpus, value, unit);
+	fflush(stdout);
+}
+
+static void jsonString(FILE* out, const std::string& s) {
+	fputc('"', out);
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			fputc('\\', out);
+		fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static bool writeJson(const char* path) {
+	FILE* out = fopen(path, "w");
+	if (out == NULL)
+		return false;
+	fprintf(out, "{\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"results\": [\n", KILO_VERSION,
+			static_cast<long long>(time(NULL)));
+	for (size_t i = 0; i < results.size(); i++) {
+		const benchResult& r = results[i];
+		fprintf(out, "    {\"name\": ");
+		jsonString(out, r.name);
+		fprintf(out, ", \"corpus\": ");
+		jsonString(out, r.corpus);
+		fprintf(out, ", \"value\": %.3f, \"unit\": ", r.value);
+		jsonString(out, r.unit);
+		fprintf(out, ", \"iterations\": %lld}%s\n", r.iterations, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+	return fclose(out) == 0;
+}
+
+int main(int argc, char** argv) {
+	const char* json = NULL;
+	long long sizeMb = 8;
+	long long logMb = 1024;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--json=", 7) == 0) {
+			json = argv[i] + 7;
+		} else if (strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if (strncmp(argv[i], "--size-mb=", 10) == 0) {
+			sizeMb = atoll(argv[i] + 10);
+		} else if (strncmp(argv[i], "--log-mb=", 9) == 0) {
+			logMb = atoll(argv[i] + 9);
+		} else {
+			fprintf(stderr, "Usage: %s [--json=<file>] [--filter=<name>] [--size-mb=<MB>] [--log-mb=<MB>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	editorThemeInit();
+	E.screenrows = 24;
+	E.screencols = 80;
+	E.match_row = -1;
+
+	int size = static_cast<int>(sizeMb << 20);
+	corpus corpora[] = {
+		{"short-lines", makeShortLines(size)},
+		{"huge-line", makeMinified(size)},
+		{"tab-heavy", makeTabHeavy(size)},
+		{"comment-heavy", makeCommentHeavy(size)},
+		{"crlf-lines", makeCrlfLines(size)},
+	};
+	int count = sizeof(corpora) / sizeof(corpora[0]);
+
+	printf("%-24s %-16s %14s %-5s\n", "benchmark", "corpus", "value", "unit");
+	fflush(stdout);
+	benchMicro(corpora, count, size);
+	benchMacro(corpora, count, logMb << 20);
+
+	if (json && !writeJson(json)) {
+		fprintf(stderr, "cannot write %s\n", json);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,482 @@
+// Micro benchmarks: single operations on a loaded buffer, reported per call.
+#include "bench.hpp"
+#include "editorBrackets.hpp"
+#include "editorCursor.hpp"
+#include "editorFinder.hpp"
+#include "editorFold.hpp"
+#include "editorMem.hpp"
+#include "editorSelection.hpp"
+#include "editorSymbols.hpp"
+#include "editorWords.hpp"
+#include "editorWrap.hpp"
+#include <cstdlib>
+#include <cstring>
+
+/*** cx/rx ***/
+
+// the conversions as they were before the tab index, kept as the baseline
+static int legacyCxToRx(erow* row, int cx) {
+	int rx = 0;
+	for (int j = 0; j < cx; j++) {
+		if (row->chars[j] == '\t')
+			rx += (TAB_SIZE - 1) - (rx % TAB_SIZE);
+		rx++;
+	}
+	return rx;
+}
+
+static int legacyRxToCx(erow* row, int rx) {
+	int cur_rx = 0;
+	int cx;
+	for (cx = 0; cx < row->size; cx++) {
+		if (row->chars[cx] == '\t')
+			cur_rx += (TAB_SIZE - 1) - (cur_rx % TAB_SIZE);
+		cur_rx++;
+		if (cur_rx > rx)
+			return cx;
+	}
+	return cx;
+}
+
+static void benchLongLine(const char* name, const std::string& text) {
+	loadBuffer(text, NULL);
+	erow* row = &E.row[0];
+	int iterations = 2000;
+	// the linear scans get far fewer rounds, they are slow enough to measure anyway
+	int legacyIterations = 20;
+
+	// a cursor wiggling around the end of the line, as editorScroll sees it on every refresh
+	if (benchEnabled("cx_to_rx")) {
+		benchRecord("cx_to_rx", name, nsPerOp(iterations, [&](int i) { sink = editorRowCxToRx(row, row->size - (i & 7)); }),
+					"ns", iterations);
+		benchRecord("cx_to_rx_legacy", name,
+					nsPerOp(legacyIterations, [&](int i) { sink = legacyCxToRx(row, row->size - (i & 7)); }), "ns",
+					legacyIterations);
+	}
+	if (benchEnabled("rx_to_cx")) {
+		benchRecord("rx_to_cx", name, nsPerOp(iterations, [&](int i) { sink = editorRowRxToCx(row, row->rsize - (i & 7)); }),
+					"ns", iterations);
+		benchRecord("rx_to_cx_legacy", name,
+					nsPerOp(legacyIterations, [&](int i) { sink = legacyRxToCx(row, row->rsize - (i & 7)); }), "ns",
+					legacyIterations);
+	}
+	if (benchEnabled("scroll")) {
+		E.cy = 0;
+		benchRecord("scroll", name, nsPerOp(iterations, [&](int i) {
+						E.cx = row->size - (i & 7);
+						editorScroll();
+					}),
+					"ns", iterations);
+	}
+}
+
+/*** typing ***/
+
+// one keystroke in the middle of a long line followed by a redraw, against rebuilding the whole row
+static void benchTyping(const char* name, const std::string& text) {
+	if (!benchEnabled("keystroke"))
+		return;
+	loadBuffer(text, "bench.c");
+	erow* row = &E.row[0];
+	int at = row->size / 2;
+	E.cy = 0;
+	E.cx = at;
+	E.rowoff = 0;
+	E.coloff = editorRowCxToRx(row, at) - E.screencols / 2;
+
+	auto type = [&](int i, bool full) {
+		// alternately insert and remove a character so the row keeps its size
+		if (i & 1) {
+			memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+			row->size--;
+		} else {
+			row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + 2));
+			memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+			row->chars[at] = 'q';
+			row->size++;
+		}
+		if (full)
+			editorUpdateRow(row);
+		else
+			editorRowChanged(row, at, (i & 1) ? -1 : 1);
+		struct abuf ab = {nullptr, 0};
+		editorDrawRows(&ab);
+		sink = ab.len;
+		abFree(&ab);
+	};
+	benchRecord("keystroke", name, nsPerOp(2000, [&](int i) { type(i, false); }), "ns", 2000);
+	benchRecord("keystroke_full_row", name, nsPerOp(20, [&](int i) { type(i, true); }), "ns", 20);
+	// right after a bracket, its pair is looked up for every frame drawn
+	const char* open = static_cast<const char*>(memchr(&row->chars[at], '[', row->size - at));
+	if (open == NULL)
+		return;
+	at = static_cast<int>(open - row->chars) + 1;
+	E.cx = at;
+	benchRecord("keystroke_bracket", name, nsPerOp(2000, [&](int i) { type(i, false); }), "ns", 2000);
+}
+
+/*** cursors ***/
+
+// a column of cursors down the middle of the buffer, each key goes to all of them
+static void benchCursors(const char* name, const std::string& text) {
+	if (!benchEnabled("cursor_keystroke"))
+		return;
+	loadBuffer(text, "bench.c");
+	int count = E.numrows - 1 < 10000 ? E.numrows - 1 : 10000;
+	if (count < 2)
+		return;
+	E.cy = (E.numrows - count) / 2;
+	E.cx = 0;
+	for (int i = 1; i < count; i++)
+		editorCursorAddVertical(1);
+	int iterations = 20;
+	benchRecord("cursor_keystroke", name,
+				nsPerOp(iterations, [&](int i) { editorCursorsKey((i & 1) ? static_cast<int>(BACKSPACE) : 'q'); }) / 1e3, "us",
+				iterations);
+	// every row split and joined again, each key one splice over the rows the cursors span
+	benchRecord("cursor_newline", name,
+				nsPerOp(iterations, [&](int i) { editorCursorsKey((i & 1) ? static_cast<int>(BACKSPACE) : '\r'); }) / 1e3, "us",
+				iterations);
+	editorCursorsClear();
+}
+
+/*** clipboard ***/
+
+// every row but the first and the last, cut and pasted back and then copied
+static void benchClipboard(const char* name, const std::string& text) {
+	if (!benchEnabled("cut_lines") && !benchEnabled("paste_lines") && !benchEnabled("copy_lines"))
+		return;
+	loadBuffer(text, "bench.c");
+	if (E.numrows < 3)
+		return;
+	auto selectMiddle = [] {
+		E.cy = 1;
+		E.cx = 0;
+		editorSelectionMark();
+		E.cy = E.numrows - 1;
+	};
+	int runs = 3;
+	double cut = 0, paste = 0;
+	for (int i = 0; i < runs; i++) {
+		selectMiddle();
+		double c = nsPerOp(1, [](int) { editorCut(); }) / 1e3;
+		double p = nsPerOp(1, [](int) { editorPaste(); }) / 1e6;
+		cut = i == 0 || c < cut ? c : cut;
+		paste = i == 0 || p < paste ? p : paste;
+		// what the next cut retires is freed between runs, the way idle ticks would
+		while (editorSelectionIdle())
+			;
+	}
+	benchRecord("cut_lines", name, cut, "us", runs);
+	benchRecord("paste_lines", name, paste, "ms", runs);
+	benchRecord("copy_lines", name, bestMs(runs, [&](int) {
+					selectMiddle();
+					editorCopy();
+				}),
+				"ms", runs);
+	editorSelectionClear();
+}
+
+/*** rows ***/
+
+static void benchRows(const char* name, const std::string& text) {
+	loadBuffer(text, "bench.c");
+	int mid = E.numrows / 2;
+	static const char line[] = "\tint inserted = 1; /* row */";
+
+	if (benchEnabled("insert_del_row")) {
+		int iterations = 2000;
+		benchRecord("insert_del_row", name, nsPerOp(iterations, [&](int) {
+						editorInsertRow(mid, line, sizeof(line) - 1);
+						editorDelRow(mid);
+					}),
+					"ns", iterations);
+		benchRecord("insert_del_row_top", name, nsPerOp(iterations, [&](int) {
+						editorInsertRow(0, line, sizeof(line) - 1);
+						editorDelRow(0);
+					}),
+					"ns", iterations);
+	}
+
+	if (benchEnabled("update_syntax")) {
+		int span = E.numrows - mid < 64 ? E.numrows - mid : 64;
+		// fewer rounds when the rows are huge, each one then rescans megabytes
+		long long bytes = 0;
+		for (int i = 0; i < span; i++)
+			bytes += E.row[mid + i].size;
+		long long rounds = (64LL << 20) * span / (bytes + 1);
+		int iterations = static_cast<int>(rounds < 10 ? 10 : rounds > 20000 ? 20000 : rounds);
+		benchRecord("update_syntax", name, nsPerOp(iterations, [&](int i) { editorUpdateSyntax(&E.row[mid + i % span]); }),
+					"ns", iterations);
+	}
+
+	if (benchEnabled("draw_rows")) {
+		int iterations = 2000;
+		E.rowoff = mid;
+		E.coloff = 0;
+		benchRecord("draw_rows", name, nsPerOp(iterations, [&](int) {
+						struct abuf ab = {nullptr, 0};
+						editorDrawRows(&ab);
+						sink = ab.len;
+						abFree(&ab);
+					}),
+					"ns", iterations);
+	}
+}
+
+/*** find ***/
+
+// a search whose only hit is on the last row, so every call scans the whole buffer
+static void benchFind(const char* name, const std::string& text) {
+	if (!benchEnabled("find"))
+		return;
+	loadBuffer(text + "\nneedle_at_the_end\n", "bench.c");
+	char query[] = "needle_at_the_end";
+	int iterations = 20;
+	benchRecord("find", name, nsPerOp(iterations, [&](int) {
+					editorFindCallback(query, 'd');
+					editorFindCallback(query, '\r');
+				}) / 1e3,
+				"us", iterations);
+}
+
+/*** completion ***/
+
+// lines of assignments between made up names, a few hundred thousand of them distinct and the counts
+// skewed the way real code is
+static std::string makeIdentifiers(int lines) {
+	static const char* parts[] = {"get", "set",	 "buffer", "row",	"Index", "count",
+								  "render", "_id", "Size",	"node", "cache", "max"};
+	std::string text;
+	unsigned int x = 1;
+	for (int line = 0; line < lines; line++) {
+		text += "\t";
+		for (int t = 0; t < 4; t++) {
+			x = x * 1103515245 + 12345;
+			int a = (x >> 8) % 12;
+			int b = (x >> 14) % 12;
+			int n = (x >> 20) % ((x >> 28) % 4 == 0 ? 4000 : 40);
+			text += parts[a];
+			text += parts[b];
+			text += std::to_string(n);
+			text += t < 3 ? " = " : ";\n";
+		}
+	}
+	return text;
+}
+
+// a lookup for every one letter prefix and then longer ones, the short ones have the most under them
+static void benchComplete(int lines) {
+	if (!benchEnabled("complete_prefix"))
+		return;
+	loadBuffer(makeIdentifiers(lines), "bench.c");
+	static const char* prefixes[] = {"b", "c", "g", "i", "m", "n", "r", "s", "_", "get", "setIndex", "cacherow1"};
+	std::vector<std::string> out;
+	double worst = 0;
+	for (const char* prefix : prefixes) {
+		int len = static_cast<int>(strlen(prefix));
+		double us = nsPerOp(200, [&](int) { sink = editorWordsComplete(prefix, len, NULL, 0, out, WORDS_MAX_CANDIDATES); }) / 1e3;
+		worst = us > worst ? us : worst;
+	}
+	std::string corpus = std::to_string(lines * 4 / 1000) + "k-identifiers";
+	benchRecord("complete_prefix", corpus.c_str(), worst, "us", 200 * static_cast<int>(sizeof(prefixes) / sizeof(prefixes[0])));
+}
+
+/*** symbols ***/
+
+// a C file of small functions and the types they take, a declaration every few rows
+static std::string makeDeclarations(int lines) {
+	std::string text;
+	for (int n = 0; static_cast<int>(text.size()) < lines * 16; n++) {
+		std::string id = std::to_string(n);
+		if (n % 8 == 0)
+			text += "struct node" + id + " {\n\tint count;\n};\n";
+		text += "static int getNode" + id + "(struct node* n) {\n\treturn n->count + " + id + ";\n}\n";
+	}
+	return text;
+}
+
+// a jump looks at every declaration when the name is missing, a row added at the top shifts them all
+static void benchSymbols(int lines) {
+	if (!benchEnabled("symbol_jump"))
+		return;
+	loadBuffer(makeDeclarations(lines), "bench.c");
+	std::string corpus = std::to_string(E.numrows / 1000) + "k-rows";
+	double us = nsPerOp(200, [&](int) { sink = editorSymbolsFind("missingName", 11, 0); }) / 1e3;
+	benchRecord("symbol_jump", corpus.c_str(), us, "us", 200);
+	us = nsPerOp(200, [&](int i) { editorSymbolsRowsMoved(0, i % 2, 1 - i % 2); }) / 1e3;
+	benchRecord("symbol_row_moved", corpus.c_str(), us, "us", 200);
+}
+
+/*** brackets ***/
+
+// a brace around the whole file matched from its first row, then again after a row went in at the top
+static void benchBrackets(int lines) {
+	if (!benchEnabled("bracket_match"))
+		return;
+	loadBuffer("namespace bench {\n" + makeDeclarations(lines) + "}\n", "bench.c");
+	std::string corpus = std::to_string(E.numrows / 1000) + "k-rows";
+	int col = static_cast<int>(strchr(E.row[0].chars, '{') - E.row[0].chars);
+	int row, at;
+	double us = nsPerOp(1000, [&](int) { sink = editorBracketsMatch(0, col, &row, &at); }) / 1e3;
+	benchRecord("bracket_match", corpus.c_str(), us, "us", 1000);
+	us = nsPerOp(20, [&](int i) {
+		if (i % 2 == 0)
+			editorInsertRow(1, "", 0);
+		else
+			editorDelRow(1);
+		sink = editorBracketsMatch(0, col, &row, &at);
+	}) / 1e3;
+	benchRecord("bracket_match_row_moved", corpus.c_str(), us, "us", 20);
+}
+
+/*** folding ***/
+
+// a key moving over a folded block of a million rows and back, with the scroll and the redraw it causes
+static void benchFold(int lines) {
+	if (!benchEnabled("fold_navigate"))
+		return;
+	std::string text = "int f() {\n";
+	for (int i = 0; i < lines; i++)
+		text += "\tx();\n";
+	text += "}\n";
+	for (int i = 0; i < 200; i++)
+		text += "int y;\n";
+	loadBuffer(text, "bench.c");
+	E.cx = E.cy = E.rowoff = E.coloff = 0;
+	editorFoldToggle();
+	int iterations = 2000;
+	benchRecord("fold_navigate", (std::to_string(lines / 1000) + "k-folded").c_str(), nsPerOp(iterations, [&](int i) {
+					editorMoveCursor(i % 4 < 2 ? ARROW_DOWN : ARROW_UP);
+					editorScroll();
+					struct abuf ab = {nullptr, 0};
+					editorDrawRows(&ab);
+					sink = ab.len + E.cy;
+					abFree(&ab);
+				}) / 1e3,
+				"us", iterations);
+}
+
+/*** soft wrap ***/
+
+// A resize with soft wrap on: the scroll and redraw that follow it, which only lay out the rows around
+// the screen, then what the idle ticks take to measure the rest of the file.
+static void benchWrap(int lines) {
+	if (!benchEnabled("wrap_resize"))
+		return;
+	std::string text;
+	for (int i = 0; i < lines; i++)
+		text += "\tcall(" + std::string(i % 7 == 0 ? 150 + i % 200 : i % 50, 'x') + ");\n";
+	loadBuffer(text, "bench.c");
+	std::string corpus = std::to_string(lines / 1000) + "k-rows";
+	int screencols = E.screencols;
+	editorWrapToggle();
+	E.cx = 0;
+	E.cy = E.rowoff = lines / 2;
+	editorScroll();
+	while (editorWrapIdle())
+		;
+	int iterations = 200;
+	double us = nsPerOp(iterations, [&](int i) {
+		E.screencols = i % 2 == 0 ? 100 : 80;
+		editorScroll();
+		struct abuf ab = {nullptr, 0};
+		editorDrawRows(&ab);
+		sink = ab.len + E.rowoff;
+		abFree(&ab);
+	}) / 1e3;
+	benchRecord("wrap_resize", corpus.c_str(), us, "us", iterations);
+	double ms = nsPerOp(1, [&](int) {
+		E.screencols = 120;
+		editorScroll();
+		while (editorWrapIdle())
+			;
+	}) / 1e6;
+	benchRecord("wrap_relayout_idle", corpus.c_str(), ms, "ms", 1);
+	E.screencols = screencols;
+	editorWrapToggle();
+}
+
+/*** file finder ***/
+
+// a source tree of made up names, deep enough that paths run 40 to 80 bytes like real ones do
+static std::vector<std::string> makePaths(int count) {
+	static const char* words[] = {"src",	"include", "lib",	   "core",	 "editor", "buffer", "render", "util",
+								  "net",	"tests",   "platform", "config", "parser", "syntax", "theme",  "io",
+								  "module", "vendor",  "Widget",   "Event",	 "Stream", "Cache",	 "index",  "docs"};
+	static const char* exts[] = {".cpp", ".hpp", ".c", ".h", ".md", ".txt", ".json", ".py"};
+	const int nwords = sizeof(words) / sizeof(words[0]);
+	std::vector<std::string> paths;
+	paths.reserve(count);
+	unsigned int seed = 12345;
+	auto next = [&seed] {
+		seed = seed * 1103515245 + 12345;
+		return (seed >> 16) & 0x7fff;
+	};
+	for (int i = 0; i < count; i++) {
+		std::string path;
+		int depth = 2 + next() % 4;
+		for (int d = 0; d < depth; d++)
+			path += std::string(words[next() % nwords]) + (d + 1 < depth ? "/" : "");
+		path += "_" + std::to_string(i % 997) + exts[next() % 8];
+		paths.push_back(path);
+	}
+	return paths;
+}
+
+// every keystroke of a query typed into the picker, the worst one is what the frame budget is held to
+static void benchFinder(int files) {
+	if (!benchEnabled("finder_key") && !benchEnabled("finder_first_key"))
+		return;
+	editorFinderUsePaths(makePaths(files));
+	const char* query = "edbufcpp";
+	double worst = 0, first = 0;
+	int runs = 3;
+	for (int r = 0; r < runs; r++) {
+		editorFinderSearch("");
+		std::string typed;
+		for (const char* p = query; *p; p++) {
+			typed.push_back(*p);
+			double ms = nsPerOp(1, [&](int) { sink = editorFinderSearch(typed.c_str()); }) / 1e6;
+			if (p == query)
+				first = r == 0 || ms < first ? ms : first;
+			worst = ms > worst ? ms : worst;
+		}
+	}
+	std::string corpus = std::to_string(files / 1000) + "k-paths";
+	benchRecord("finder_first_key", corpus.c_str(), first, "ms", runs);
+	benchRecord("finder_key", corpus.c_str(), worst, "ms", runs * static_cast<int>(strlen(query)));
+	editorFinderUsePaths({});
+}
+
+void benchMicro(const corpus* corpora, int count, int size) {
+	benchLongLine("minified", makeMinified(1 << 20));
+	benchLongLine("tab-heavy", makeTabHeavy(1 << 20));
+	benchTyping("minified", makeMinified(1 << 20));
+	benchTyping("tab-heavy", makeTabHeavy(1 << 20));
+
+	// the same lines again at --size-mb, to show how the costs grow with the line
+	if (size > (1 << 20)) {
+		std::string suffix = "-" + std::to_string(size >> 20) + "M";
+		std::string minified = "minified" + suffix;
+		std::string tabHeavy = "tab-heavy" + suffix;
+		benchLongLine(minified.c_str(), makeMinified(size));
+		benchLongLine(tabHeavy.c_str(), makeTabHeavy(size));
+		benchTyping(minified.c_str(), makeMinified(size));
+	}
+
+	benchFinder(500000);
+	benchComplete(1000000);
+	benchSymbols(200000);
+	benchBrackets(1000000);
+	benchFold(1000000);
+	benchWrap(1000000);
+
+	for (int i = 0; i < count; i++) {
+		benchRows(corpora[i].name, corpora[i].text);
+		benchFind(corpora[i].name, corpora[i].text);
+		benchCursors(corpora[i].name, corpora[i].text);
+		benchClipboard(corpora[i].name, corpora[i].text);
+	}
+	clearBuffer();
+}
@@ -8,4 +8,45 @@
 #define WELCOME_MESSAGE "Kilo editor -- verison " KILO_VERSION
 #define STATUS_MESSAGE_TIME 5
 #define TAB_SIZE 4
-#pragma endregion
\ No newline at end of file
+// rows longer than this are rendered and highlighted in chunks of about ROW_CHUNK_SIZE characters
+#define ROW_CHUNK_THRESHOLD (64 * 1024)
+#define ROW_CHUNK_SIZE 1024
+// files are read and written through a block of this many bytes
+#define FILE_BLOCK_SIZE (1 << 20)
+// cut or deleted text that is no longer needed is freed this many rows per idle tick
+#define RETIRED_ROWS_SLICE (64 * 1024)
+// built-in theme used unless --theme picks another, see editorTheme.cpp for the others
+#define DEFAULT_THEME "default"
+#pragma endregion
+
+#pragma region buffers
+// past this much tracked memory, buffers not on screen drop their render and highlight caches
+#define BUFFER_CACHE_BUDGET (512LL << 20)
+// closed files kept in memory so reopening them does not read the disk again
+#define BUFFER_CLOSED_CACHE 8
+#pragma endregion
+
+#pragma region panes
+// a pane is only split when both halves keep at least this much room
+#define PANE_MIN_ROWS 2
+#define PANE_MIN_COLS 10
+#pragma endregion
+
+#pragma region pager
+// files above this size open in the read-only pager instead of being loaded whole
+#define PAGER_AUTO_SIZE (4LL << 30)
+// default cap on the memory the pager window may use, change with --pager=<MB>
+#define PAGER_DEFAULT_CAP (64LL << 20)
+// how much is read from disk each time the window slides
+#define PAGER_CHUNK_BYTES (1 << 20)
+// lines longer than this are shown as several rows
+#define PAGER_MAX_LINE (1 << 20)
+// the line index starts with an entry every PAGER_INDEX_STEP lines and thins out past PAGER_INDEX_MAX entries
+#define PAGER_INDEX_STEP 1024
+#define PAGER_INDEX_MAX (1 << 20)
+#pragma endregion
+
+#pragma region trace
+// spans kept per thread for the trace dump, older ones are overwritten
+#define TRACE_RING_EVENTS (1 << 16)
+#pragma endregion
@@ -22,30 +22,125 @@ struct editorSyntax {
 	int flags;
 };
 
+// highlight classes, what the theme gives a color each
+enum editorHighlight {
+	HL_NORMAL = 0,
+	HL_COMMENT,
+	HL_MLCOMMENT,
+	HL_KEYWORD1,
+	HL_KEYWORD2,
+	HL_STRING,
+	HL_NUMBER,
+	HL_MATCH,
+	HL_SELECTION,
+	HL_BRACKET,
+	HL_CLASSES
+};
+
+// a tab or a multibyte character in a row, rx is the screen column just after it. Between two of
+// these every byte is one column, so the list is enough to convert between cx and rx
+struct tabStop {
+	int cx;
+	int rx;
+	int len; // bytes, 1 for a tab
+};
+
+// highlighter state between two characters of a row, so a row can be highlighted piecewise
+struct hlState {
+	int in_string;
+	int in_comment;
+	int prev_sep;
+	int prev_hl;
+	int carry;	  // characters at the start of the next piece that belong to a token from before
+	int carry_hl; // and their highlight
+};
+
+// a run of render bytes drawn in one highlight class. Runs cover the render back to back, so a run
+// starts where the previous one ended; rows long enough to overflow len are chunked long before that.
+// On ASCII text a byte is a column, which is what the drawing fast path relies on
+struct hlSpan {
+	unsigned int len : 24;
+	unsigned int hl : 8;
+};
+
+// a piece of a long row, rendered and highlighted on its own
+struct rowChunk {
+	int cx;			 // first character of the chunk
+	int rx;			 // render column of that character
+	hlState state;	 // highlighter state entering the chunk
+	char* render;	 // render and spans are NULL until the chunk is drawn
+	hlSpan* spans;
+	int nspans;
+	int rlen;		 // bytes in render
+	bool ascii;		 // the chunk's text is all ASCII, so bytes and columns line up
+};
+
 using erow = struct erow {
 	int idx;
 	int size;
-	int rsize;
+	int rsize; // screen columns of the whole row, cached so drawing never has to measure text
+	int rlen;  // bytes in render, the same as rsize when the row is ASCII
+	bool ascii; // set with render, long rows keep it per chunk instead
+	bool crlf;	// the line ended with \r\n, save writes it back the same way
 	char* chars;
 	char* render;
-	unsigned char* hl;
+	hlSpan* spans; // highlight of render as runs, in byte order
+	int nspans;
 	int hl_open_comment;
+	tabStop* tabs; // built on first cx/rx conversion, NULL with ntabs == -1 until then
+	int ntabs;
+	rowChunk* chunks; // rows above ROW_CHUNK_THRESHOLD keep render and spans per chunk, render is NULL then
+	int nchunks;
+	unsigned int* words; // identifiers of the row in the buffer's word index, what it counts for the row
+	int nwords;
+	bool words_stale; // a long row was edited without being indexed again, see editorWordsFlush
 };
 
-struct editorConfig {
+// Everything that belongs to one open file. E holds the shown buffer's as its base, switching buffers
+// copies this part whole, so a field added here travels with its buffer without anything else to update.
+struct bufferState {
 	int cx, cy;
-	int rx;
 	int rowoff;
 	int coloff;
-	int screenrows;
-	int screencols;
 	int numrows;
 	erow* row;
 	int dirty;
 	char* filename;
+	struct editorSyntax* syntax;
+	long long disk_mtime;
+	long long disk_size;
+	int disk_changed;
+	int readonly;
+	int eol;	// editorEol of the file, what new lines end with
+	bool noeol; // the file did not end with a line ending and save keeps it that way
+	struct wordIndex* words; // identifiers of the buffer for completion, NULL until a row is indexed
+	struct symbolIndex* symbols; // declarations of the buffer by row, NULL until one is found
+	struct bracketIndex* brackets; // bracket depth of every row, NULL until a row is added
+	struct foldIndex* folds; // folded blocks of the buffer, NULL until something is folded
+	struct wrapIndex* wraps; // wrapped lines of every row, NULL until soft wrap lays the buffer out
+};
+
+// the view: the shown buffer and what only the screen has
+struct editorConfig : bufferState {
+	int rx;
+	int wrapoff; // lines of the top row scrolled off above the screen, with soft wrap on
+	int screenrows;
+	int screencols;
 	char statusmsg[80];
 	time_t statusmsg_time;
-	struct editorSyntax* syntax;
+	int match_row; // search match drawn on top of the highlighting, -1 for none
+	int match_rx;
+	int match_len;
+	char* panel; // text drawn over the top rows until the next key, NULL for none
+	int viewtop, viewleft; // text area of the focused pane, the whole screen unless split
+	int viewrows, viewcols;
+};
+
+// a line of text that does not own its bytes, used for bulk row operations
+struct rowText {
+	const char* s;
+	int len;
+	bool crlf; // it ended with \r\n, which is not part of s
 };
 
 struct abuf {
@@ -65,15 +160,55 @@ enum editorKey {
 	END_KEY,
 	PAGE_UP,
 	PAGE_DOWN,
+	ALT_ARROW_UP,
+	ALT_ARROW_DOWN,
+	SHIFT_ARROW_UP,
+	SHIFT_ARROW_DOWN,
+	SHIFT_ARROW_LEFT,
+	SHIFT_ARROW_RIGHT,
+	SHIFT_HOME,
+	SHIFT_END,
 };
 extern editorConfig E;
 
 void editorStart(const char* filenameIn);
 void editorSetStatusMessage(const char* fmt, ...);
+// Enter on an empty prompt is an answer too, for pickers that already have an entry selected
+#define PROMPT_ACCEPT_EMPTY 1
+char* editorPrompt(const char* prompt, void (*callback)(char*, int), int flags);
 void editorScroll();
 void editorDrawRows(struct abuf* ab);
+int editorDrawRowSlice(struct abuf* ab, int filerow, int coloff, int cols);
 void editorDrawStatusBar(struct abuf* ab);
 void editorDrawMessageBar(struct abuf* ab);
 void abAppend(struct abuf* ab, const char* s, int len);
 void abFree(struct abuf* ab);
 void editorDrawLineCount(struct abuf* ab);
+void editorDrawScreen(struct abuf* ab);
+void editorIdle();
+
+int is_separator(int c);
+void editorUpdateSyntax(erow* row);
+int editorRowPieces(const erow* row);
+int editorRowPieceAt(const erow* row, int cx);
+void editorRowPieceClasses(erow* row, int k, void (*scan)(const erow* row, int from, int to, const unsigned char* cls));
+void editorRowClasses(erow* row, void (*scan)(const erow* row, int from, int to, const unsigned char* cls));
+void editorRowIndexWords(erow* row);
+int editorRowCxToRx(erow* row, int cx);
+int editorRowRxToCx(erow* row, int rx);
+void editorUpdateRow(erow* row);
+void editorRowChanged(erow* row, int at, int delta);
+void editorRowDelChars(erow* row, int at, int len);
+const char* editorRowPiece(erow* row, int rx, int* start, int* len, const hlSpan** spans, int* nspans, bool* ascii);
+void editorInsertRow(int at, const char* s, size_t len);
+void editorDelRow(int at);
+void editorFreeRow(erow* row);
+void editorRowDropCaches(erow* row);
+void editorSpliceRows(int at, int del, const rowText* lines, int ins);
+erow* editorTakeRows(int at, int n, int spare, int* first);
+void editorSelectSyntaxHighlight();
+bool editorOpen(const char* filename);
+void editorSave();
+void editorFindCallback(char* query, int key);
+void editorMoveCursor(int key);
+bool editorRejectReadOnly();
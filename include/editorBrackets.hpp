@@ -0,0 +1,25 @@
+#pragma once
+#include "editor.hpp"
+
+// rows summed up together at the bottom of the depth tree, a lookup steps through at most this many
+#define BRACKETS_BLOCK 16
+// pieces of rows, chunks of long ones, highlighted at most to find the pair drawn at the cursor
+#define BRACKETS_DRAW_PIECES 8
+// chunks of edited long rows summed again per idle tick
+#define BRACKETS_IDLE_PIECES 64
+
+// The highlighter sums up the brackets of every row it highlights: begin, scan for each piece with the
+// classes it gave the characters, then end. Brackets in strings and comments do not count.
+void editorBracketsBegin();
+void editorBracketsScan(const erow* row, int from, int to, const unsigned char* cls);
+void editorBracketsEnd(const erow* row);
+void editorBracketsStale(const erow* row);
+bool editorBracketsIdle();
+void editorBracketsRowsMoved(int at, int del, int ins);
+void editorBracketsFree(struct bracketIndex* index);
+
+// the bracket matching the one at (row, col), false when there is none there or it is unmatched
+bool editorBracketsMatch(int row, int col, int* matchRow, int* matchCol);
+int editorBracketsOnRow(int row, int* cols);
+bool editorBracketsBlock(int row, int* first, int* last);
+void editorBracketsJump();
@@ -0,0 +1,19 @@
+#pragma once
+#include "editor.hpp"
+
+// A buffer parked while another one is shown, its bufferState as E last had it.
+struct editorBuffer : bufferState {
+	long long lastUsed; // switch count when last shown, the least recently used go cold first
+	bool cold;			// render, spans and tab indexes were dropped, they come back when drawn
+};
+
+bool editorBufferOpen(const char* filename);
+bool editorBufferScratch(const char* name);
+bool editorBufferSwitch(int idx);
+bool editorBufferSwitchTo(const char* target);
+void editorBufferNext();
+bool editorBufferClose();
+int editorBufferCount();
+int editorBufferDirtyCount();
+int editorBufferList(char* buf, int len);
+void editorBufferFreeAll();
@@ -0,0 +1,16 @@
+#pragma once
+#include "editor.hpp"
+
+// one of several cursors. E.cx/E.cy is the primary one, the view follows it
+struct editorCursor {
+	int cx, cy;
+	bool primary;
+};
+
+bool editorCursorsActive();
+int editorCursorCount();
+bool editorCursorsKey(int c);
+void editorCursorAddNextMatch();
+void editorCursorAddVertical(int dir);
+void editorCursorsClear();
+void editorCursorsDraw(struct abuf* ab);
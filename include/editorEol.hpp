@@ -0,0 +1,19 @@
+#pragma once
+
+// line ending style of a buffer, what new lines get and what the status bar shows. Each row also
+// remembers its own ending, so a file with both kinds is written back the way it was read
+enum editorEol {
+	EOL_LF = 0,
+	EOL_CRLF,
+	EOL_MIXED
+};
+
+// line endings seen in some text so far
+struct eolCounts {
+	long long lines; // '\n' bytes
+	long long crlf;	 // those with a '\r' right before them
+};
+
+void eolCount(const char* s, int n, char prev, eolCounts* counts);
+int eolStyle(const eolCounts* counts);
+const char* eolName(int eol);
@@ -0,0 +1,18 @@
+#pragma once
+#include "editor.hpp"
+#include <string>
+#include <vector>
+
+// the listing of every directory under the working directory is kept here between runs, one file
+// per working directory in the cache directory
+#define FINDER_CACHE_FORMAT "kilo-files 1"
+// a keystroke that has to look at more paths than this splits the work over the cores
+#define FINDER_SPLIT_PATHS 65536
+
+void editorFinderOpen();
+bool editorFinderIdle();
+
+// the matcher alone, for the benchmarks: paths take the place of the walked index, and a search
+// returns how many of them match
+void editorFinderUsePaths(const std::vector<std::string>& paths);
+int editorFinderSearch(const char* query);
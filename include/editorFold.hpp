@@ -0,0 +1,18 @@
+#pragma once
+#include "editor.hpp"
+
+// A folded block keeps its first row on screen and hides the rest. Lines are what the screen counts:
+// rows with the hidden ones taken out. Without folds a line is a row, and all of these are that cheap.
+int editorFoldLine(int row);
+int editorFoldRow(int line);
+int editorFoldNext(int row);
+int editorFoldPrev(int row);
+int editorFoldEnd(int row);
+bool editorFoldHidden(int row);
+void editorFoldReveal(int row);
+
+void editorFoldRowsMoved(int at, int del, int ins);
+void editorFoldFree(struct foldIndex* index);
+
+void editorFoldToggle();
+void editorFoldOpenAll();
@@ -0,0 +1,19 @@
+#pragma once
+#include "editor.hpp"
+
+// the buffer the matching lines are listed in, Enter on one of them opens its file there
+#define GREP_BUFFER_NAME "*grep*"
+// how long one idle tick may spend adding results to the buffer, in milliseconds
+#define GREP_DRAIN_BUDGET_MS 20
+// results moved into the buffer per splice, the budget is checked between them
+#define GREP_DRAIN_BATCH 1024
+// the search stops once it has found this many lines
+#define GREP_MAX_RESULTS 100000
+// a file with a zero byte this close to its start is taken for binary and skipped
+#define GREP_BINARY_PROBE 8192
+// matching lines longer than this are cut in the results
+#define GREP_LINE_MAX 240
+
+bool editorGrepStart(const char* pattern, const char* dir);
+bool editorGrepDrain();
+bool editorGrepJump();
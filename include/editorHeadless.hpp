@@ -0,0 +1,21 @@
+#pragma once
+#include "editor.hpp"
+#include <cstdio>
+
+// screen size used by --replay when --size is not given
+#define HEADLESS_DEFAULT_ROWS 24
+#define HEADLESS_DEFAULT_COLS 80
+// keys sent after the script ran out before replay gives up on quitting cleanly
+#define HEADLESS_MAX_QUIT_KEYS 64
+
+bool editorHeadlessStart(const char* script, int rows, int cols);
+bool editorHeadlessActive();
+int editorHeadlessReadKey();
+void editorHeadlessRefreshScreen();
+void editorHeadlessWindowSize();
+const char* editorHeadlessScreenLine(int y);
+void editorHeadlessReport(FILE* out);
+
+bool editorRecordStart(const char* path);
+void editorRecordKey(int key);
+void editorRecordStop();
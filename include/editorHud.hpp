@@ -0,0 +1,21 @@
+#pragma once
+#include "editor.hpp"
+#include <cstdio>
+
+// values below 2^HUD_HIST_BITS microseconds are counted exactly, above that with 2^(HUD_HIST_BITS-1) buckets per power of two
+#define HUD_HIST_BITS 7
+// latencies above 2^HUD_HIST_OCTAVES microseconds land in the last bucket
+#define HUD_HIST_OCTAVES 36
+// frames remembered for the frame rate, it is counted over the last second
+#define HUD_FPS_FRAMES 256
+// how often resident memory is read again, in milliseconds
+#define HUD_RSS_INTERVAL_MS 500
+
+void editorHudKey();
+void editorHudFrame(int bytes);
+void editorHudToggle();
+bool editorHudActive();
+int editorHudStatus(char* buf, int len);
+bool editorHudLogStart(const char* path);
+void editorHudLogStop();
+void editorHudReport(FILE* out);
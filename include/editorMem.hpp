@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+
+// what a tracked allocation is for, the report groups bytes by these
+enum memCategory {
+	MEM_CHARS = 0, // row text
+	MEM_RENDER,	   // rendered rows and chunks
+	MEM_HL,		   // highlight spans of rows and chunks
+	MEM_TABS,	   // tab stop index
+	MEM_CHUNKS,	   // chunk tables of long rows
+	MEM_ROWS,	   // the row array itself
+	MEM_SCRATCH,   // reused work buffers
+	MEM_ABUF,	   // frame being built for the terminal
+	MEM_STREAM,	   // piped stdin waiting to become rows
+	MEM_PAGER,	   // pager line index
+	MEM_WORDS,	   // identifier index for completion
+	MEM_SYMBOLS,   // outline of the declarations in a buffer
+	MEM_BRACKETS,  // bracket depth sums for matching
+	MEM_WRAP,	   // wrapped lines of every row
+	MEM_CATEGORIES
+};
+
+// malloc, realloc and free that keep per category byte counts, the pointers are plain heap pointers
+void* memAlloc(memCategory cat, size_t size);
+void* memRealloc(memCategory cat, void* p, size_t size);
+void memFree(memCategory cat, void* p);
+
+// for memory not obtained through memAlloc, like containers
+void editorMemAdd(memCategory cat, long long delta);
+
+long long editorMemCurrent(memCategory cat);
+long long editorMemPeak(memCategory cat);
+int editorMemReport(char* buf, int len);
@@ -0,0 +1,14 @@
+#pragma once
+#include "editor.hpp"
+
+void editorPagerRequest(long long capBytes);
+bool editorPagerWanted(const char* filename);
+bool editorPagerOpen(const char* filename);
+void editorPagerClose();
+bool editorPagerActive();
+void editorPagerSlide();
+bool editorPagerIdle();
+bool editorPagerGoto(const char* target);
+int editorPagerStatus(char* buf, int len);
+long long editorPagerRowOffset(int row);
+int editorPagerLoadOffset(long long offset);
@@ -0,0 +1,12 @@
+#pragma once
+#include "editor.hpp"
+
+void editorPaneLayout();
+bool editorPaneSplit(bool sideBySide);
+bool editorPaneClose();
+void editorPaneOnly();
+void editorPaneNext();
+int editorPaneCount();
+bool editorPaneDrawLine(struct abuf* ab, int y);
+void editorPanesRowsMoved(int at, int del, int ins);
+void editorPanesReset();
@@ -5,4 +5,19 @@ int enableRawMode();
 void disableRawMode();
 void updateWindowSize();
 int readKey();
-void editorRefreshScreen();
\ No newline at end of file
+bool inputPending();
+void editorRefreshScreen();
+int watchFile(const char* filename);
+void unwatchFile();
+bool fileChangedOnDisk();
+int openStdinStream();
+int readStream(int fd, char* buf, int len);
+void closeStream(int fd);
+long long residentBytes();
+size_t allocationSize(void* p);
+const char* mapFile(const char* path, long long* size);
+void unmapFile(const char* data, long long size);
+bool listDirectory(const char* dir, void (*fn)(void* ctx, const char* name, bool isDir), void* ctx);
+bool currentDirectory(char* buf, int len);
+bool cacheFilePath(const char* name, char* buf, int len);
+bool replaceFile(const char* from, const char* to);
@@ -0,0 +1,11 @@
+#pragma once
+#include "editor.hpp"
+
+// upper bound on the edit distance the line diff will search before replacing the whole changed region
+#define RELOAD_MAX_DIFF 4096
+
+int editorStatFile(const char* filename, long long* mtime, long long* size);
+void editorRememberDiskState();
+bool editorReload();
+void editorCheckFileChanged();
+void editorCheckDiskState();
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+// first occurrence of needle in s[0, n), NULL when there is none. Find and grep both search with it
+const char* searchFind(const char* s, size_t n, const char* needle, size_t len);
+// true if the bytes of q appear in s in order, at gets the leftmost place of each one. q is lower case
+// and letters in s match it in either case. s is read in whole blocks of SEARCH_SUBSEQUENCE_PAD bytes,
+// up to that many past its end must be readable
+#define SEARCH_SUBSEQUENCE_PAD 16
+bool searchSubsequence(const char* s, size_t n, const char* q, size_t qlen, int* at);
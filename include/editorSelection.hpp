@@ -0,0 +1,17 @@
+#pragma once
+#include "editor.hpp"
+
+// The selection runs from the mark to the primary cursor. Shift and a motion key set the mark and
+// drop it again on the next plain motion, Ctrl-Space sets it until it is toggled off or used.
+bool editorSelectionKey(int c);
+bool editorSelectionActive();
+bool editorSelectionOnRow(int filerow, int* from, int* to, bool* eol);
+void editorSelectionMark();
+void editorSelectionClear();
+
+// the register holds what was cut or copied last as lines, pasting puts them back at the cursor
+void editorCopy();
+void editorCut();
+void editorPaste();
+int editorRegisterLines();
+bool editorSelectionIdle();
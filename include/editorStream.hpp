@@ -0,0 +1,14 @@
+#pragma once
+#include "editor.hpp"
+
+// how much the reader thread pulls from the pipe per read call
+#define STREAM_READ_SIZE (1 << 20)
+// batches of lines read ahead of the drain at most, the reader waits for it past that
+#define STREAM_MAX_BATCHES 64
+// how long one idle tick may spend moving streamed lines into the rows, in milliseconds
+#define STREAM_DRAIN_BUDGET_MS 20
+
+bool editorStreamStart(int fd);
+bool editorStreamDrain();
+bool editorStreamActive();
+int editorStreamStatus(char* buf, int len);
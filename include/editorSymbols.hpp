@@ -0,0 +1,25 @@
+#pragma once
+#include "editor.hpp"
+
+// tokens of a row the declaration finder looks at, the rest of a long line is not a declaration
+#define SYMBOLS_MAX_TOKENS 64
+
+enum symbolKind { SYM_FUNCTION = 0, SYM_STRUCT, SYM_UNION, SYM_ENUM, SYM_CLASS, SYM_TYPEDEF, SYM_MACRO, SYM_KINDS };
+
+// a declaration found on a row, the outline lists them in row order
+struct editorSymbol {
+	int row;
+	int col; // where the name starts
+	int kind;
+	std::string name;
+};
+
+// The highlighter hands every row it highlights to editorSymbolsRow with the classes it gave the
+// characters, that is the only place rows are looked at. Rows moving keeps the list in step.
+void editorSymbolsRow(const erow* row, const unsigned char* cls);
+void editorSymbolsRowsMoved(int at, int del, int ins);
+void editorSymbolsFree(struct symbolIndex* index);
+
+int editorSymbolsFind(const char* name, int len, int after);
+void editorSymbolsOutline();
+void editorSymbolsJump();
@@ -0,0 +1,28 @@
+#pragma once
+#include "editor.hpp"
+
+// how many colors the terminal can show, themes are brought down to this
+enum colorDepth {
+	COLOR_16 = 0,
+	COLOR_256,
+	COLOR_TRUE,
+};
+
+// the escape that switches to a highlight class, built once per theme and depth
+struct themeSgr {
+	char seq[40];
+	int len;
+	int id; // classes that look the same share an id, switching between them sends nothing
+};
+
+// indexed by editorHighlight, the draw loop copies these as they are
+extern themeSgr themeSequences[HL_CLASSES];
+// what ends a row, and the id a row starts out with (-1 when even normal text needs its escape)
+extern themeSgr themeReset;
+extern int themeRowStartId;
+
+void editorThemeInit();
+bool editorThemeLoad(const char* theme);
+const char* editorThemeName();
+void editorSetColorDepth(colorDepth depth);
+colorDepth editorColorDepth();
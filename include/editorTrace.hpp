@@ -0,0 +1,38 @@
+#pragma once
+#include "config.hpp"
+
+// Scoped spans around the hot paths, written to Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Built with -DKILO_TRACE=ON, otherwise TRACE_SCOPE compiles to nothing.
+
+#ifndef KILO_TRACE
+#define KILO_TRACE 0
+#endif
+
+bool editorTraceStart(const char* path);
+bool editorTracing();
+void editorTraceThread(const char* name);
+bool editorTraceDump(const char* path);
+void editorTraceStop();
+const char* editorTracePath();
+
+long long editorTraceNow();
+void editorTraceRecord(const char* name, long long start);
+
+// records the time from construction to the end of the scope, name must be a string literal
+struct traceScope {
+	const char* name;
+	long long start;
+	explicit traceScope(const char* name) : name(name), start(editorTracing() ? editorTraceNow() : -1) {}
+	~traceScope() {
+		if (start >= 0)
+			editorTraceRecord(name, start);
+	}
+};
+
+#if KILO_TRACE
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) traceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+
+// the zero width joiner, what glues emoji sequences into one character on screen
+#define UTF8_ZWJ 0x200D
+
+int utf8SkipPlain(const char* s, int n, char stop);
+int utf8AsciiPrefix(const char* s, int n);
+bool utf8IsAscii(const char* s, int n);
+bool utf8Valid(const char* s, int n);
+int utf8Decode(const char* s, int n, int* cp);
+int utf8Encode(int cp, char* out);
+int utf8Width(int cp);
+bool utf8Printable(int cp);
+int utf8NextCluster(const char* s, int n, int at);
+int utf8PrevCluster(const char* s, int n, int at);
@@ -0,0 +1,29 @@
+#pragma once
+#include "editor.hpp"
+#include <string>
+#include <vector>
+
+// identifiers shorter than this are never offered, longer ones are left out of the index
+#define WORDS_MIN_LEN 2
+#define WORDS_MAX_LEN 128
+// candidates one completion cycles through
+#define WORDS_MAX_CANDIDATES 32
+
+// Indexing a row goes through the highlighter: it calls begin, then scan for each piece of the row it
+// highlighted with the classes it gave the characters, then end, which swaps the row's identifiers in
+// the index for the ones just seen.
+void editorWordsBegin(erow* row);
+void editorWordsScan(const erow* row, int from, int to, const unsigned char* cls);
+void editorWordsEnd(erow* row);
+void editorWordsRelease(erow* row);
+void editorWordsReleaseRows(erow* rows, int n);
+bool editorWordsIdle();
+void editorWordsSettle(const erow* from, const erow* to);
+void editorWordsStale(erow* row);
+void editorWordsFlush();
+void editorWordsFree(struct wordIndex* index);
+
+// the most frequent identifiers that start with prefix, the prefix itself left out
+int editorWordsComplete(const char* prefix, int len, const char* self, int selfLen, std::vector<std::string>& out,
+						int max);
+void editorComplete();
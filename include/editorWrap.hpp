@@ -0,0 +1,24 @@
+#pragma once
+#include "editor.hpp"
+
+// rows measured again for a new width per idle tick, the ones on screen are measured right away
+#define WRAP_SLICE (64 * 1024)
+
+// With soft wrap on, a row wider than the text area goes on over as many lines as it needs. Lines here
+// count folds and wrapping both; with wrap off they are the lines of editorFold.hpp and cost the same.
+bool editorWrapActive();
+int editorWrapLine(int row);
+int editorWrapRow(int line, int* sub);
+int editorWrapSub(int rx);
+int editorWrapColumn(int rx);
+int editorWrapTop();
+
+// measures the rows around the screen and the cursor for the current width, before a scroll
+void editorWrapViewport();
+void editorWrapRowSized(int row);
+void editorWrapFoldsChanged(int row);
+void editorWrapRowsMoved(int at, int del, int ins);
+bool editorWrapIdle();
+void editorWrapFree(struct wrapIndex* index);
+
+void editorWrapToggle();
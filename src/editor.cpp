@@ -3,8 +3,30 @@
 /*** includes ***/
 #include "config.hpp"
 #include "editor.hpp"
+#include "editorBrackets.hpp"
+#include "editorBuffer.hpp"
+#include "editorCursor.hpp"
+#include "editorEol.hpp"
+#include "editorFinder.hpp"
+#include "editorFold.hpp"
+#include "editorGrep.hpp"
+#include "editorHud.hpp"
+#include "editorMem.hpp"
+#include "editorPager.hpp"
+#include "editorPane.hpp"
+#include "editorReload.hpp"
+#include "editorSearch.hpp"
+#include "editorSelection.hpp"
+#include "editorStream.hpp"
+#include "editorSymbols.hpp"
+#include "editorTheme.hpp"
+#include "editorTrace.hpp"
+#include "editorUtf8.hpp"
+#include "editorWords.hpp"
+#include "editorWrap.hpp"
 #include <cassert>
 #include <cctype>
+#include <climits>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
@@ -22,17 +44,6 @@
 #define CTRL_KEY(k) ((k) & 0x1f)
 
 
-enum editorHighlight {
-	HL_NORMAL = 0,
-	HL_COMMENT,
-	HL_MLCOMMENT,
-	HL_KEYWORD1,
-	HL_KEYWORD2,
-	HL_STRING,
-	HL_NUMBER,
-	HL_MATCH
-};
-
 #define HL_HIGHLIGHT_NUMBERS (1 << 0)
 #define HL_HIGHLIGHT_STRINGS (1 << 1)
 
@@ -55,7 +66,8 @@ struct editorSyntax HLDB[] = {
 
 /*** prototypes ***/
 void editorSetStatusMessage(const char* fmt, ...);
-char* editorPrompt(const char* prompt, void (*callback)(char*, int));
+char* editorPrompt(const char* prompt, void (*callback)(char*, int), int flags);
+void editorRenderRow(erow* row);
 
 #define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
 
@@ -69,14 +81,68 @@ int is_separator(int c) {
 	return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
 }
 
-void editorUpdateSyntax(erow* row) {
-	row->hl = static_cast<unsigned char*>(realloc(row->hl, row->rsize));
-	memset(row->hl, HL_NORMAL, row->rsize);
+// a keyword or comment delimiter is matched by looking this far past its first character
+#define HL_MAX_LOOKAHEAD 64
+// carry value of a single line comment, it covers the rest of the row however long that gets
+#define HL_CARRY_LINE INT_MAX
+
+void hlInitState(hlState* st, int in_comment) {
+	st->in_string = 0;
+	st->in_comment = in_comment;
+	st->prev_sep = 1;
+	st->prev_hl = HL_NORMAL;
+	st->carry = 0;
+	st->carry_hl = HL_NORMAL;
+}
+
+bool hlStateEquals(const hlState* a, const hlState* b) {
+	return a->in_string == b->in_string && a->in_comment == b->in_comment && a->prev_sep == b->prev_sep &&
+		   a->prev_hl == b->prev_hl && a->carry == b->carry && a->carry_hl == b->carry_hl;
+}
+
+// marks the part of [i, i + len) that falls inside the piece [from, to)
+static void hlMark(unsigned char* out, int from, int to, int i, int len, int hl) {
+	int s = i < from ? from : i;
+	int e = i + len > to ? to : i + len;
+	if (e > s)
+		memset(&out[s - from], hl, e - s);
+}
 
-	if (E.syntax == NULL)
+// scratch space for per character highlight, reused between calls
+static unsigned char* hlScratch(int size) {
+	static unsigned char* buf = NULL;
+	static int cap = 0;
+	if (size > cap) {
+		cap = size < 256 ? 256 : size;
+		buf = static_cast<unsigned char*>(memRealloc(MEM_SCRATCH, buf, cap));
+	}
+	return buf;
+}
+
+// Highlights characters [from, to) of a row into out, one entry per character, starting from st and
+// leaving the state at `to` in it. Tokens may look at characters past `to`; a token that runs past it
+// is handed to the next piece through st->carry.
+void editorHighlightChars(const erow* row, int from, int to, hlState* st, unsigned char* out) {
+	if (to <= from)
 		return;
 
+	int i = from;
+	if (st->carry > 0) {
+		int n = st->carry < to - from ? st->carry : to - from;
+		memset(out, st->carry_hl, n);
+		i += n;
+		if (st->carry != HL_CARRY_LINE)
+			st->carry -= n;
+	}
+
+	memset(&out[i - from], HL_NORMAL, to - i);
+	if (E.syntax == NULL) {
+		st->prev_hl = out[to - 1 - from];
+		return;
+	}
+
 	char** keywords = E.syntax->keywords;
+	const char* chars = row->chars;
 
 	char* scs = E.syntax->singleline_comment_start;
 	char* mcs = E.syntax->multiline_comment_start;
@@ -86,27 +152,29 @@ void editorUpdateSyntax(erow* row) {
 	int mcs_len = mcs ? strlen(mcs) : 0;
 	int mce_len = mce ? strlen(mce) : 0;
 
-	int prev_sep = 1;
-	int in_string = 0;
-	int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+	int prev_sep = st->prev_sep;
+	int in_string = st->in_string;
+	int in_comment = st->in_comment;
 
-	int i = 0;
-	while (i < row->rsize) {
-		char c = row->render[i];
-		unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+	while (i < to) {
+		char c = chars[i];
+		unsigned char prev_hl = (i > from) ? out[i - 1 - from] : st->prev_hl;
 
 		if (scs_len && !in_string && !in_comment) {
-			if (!strncmp(&row->render[i], scs, scs_len)) {
-				memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+			if (c == scs[0] && !strncmp(&chars[i], scs, scs_len)) {
+				memset(&out[i - from], HL_COMMENT, to - i);
+				st->carry = HL_CARRY_LINE;
+				st->carry_hl = HL_COMMENT;
+				i = to;
 				break;
 			}
 		}
 
 		if (mcs_len && mce_len && !in_string) {
 			if (in_comment) {
-				row->hl[i] = HL_MLCOMMENT;
-				if (!strncmp(&row->render[i], mce, mce_len)) {
-					memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+				out[i - from] = HL_MLCOMMENT;
+				if (c == mce[0] && !strncmp(&chars[i], mce, mce_len)) {
+					hlMark(out, from, to, i, mce_len, HL_MLCOMMENT);
 					i += mce_len;
 					in_comment = 0;
 					prev_sep = 1;
@@ -115,8 +183,8 @@ void editorUpdateSyntax(erow* row) {
 					i++;
 					continue;
 				}
-			} else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-				memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+			} else if (c == mcs[0] && !strncmp(&chars[i], mcs, mcs_len)) {
+				hlMark(out, from, to, i, mcs_len, HL_MLCOMMENT);
 				i += mcs_len;
 				in_comment = 1;
 				continue;
@@ -125,9 +193,9 @@ void editorUpdateSyntax(erow* row) {
 
 		if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
 			if (in_string) {
-				row->hl[i] = HL_STRING;
-				if (c == '\\' && i + 1 < row->rsize) {
-					row->hl[i + 1] = HL_STRING;
+				out[i - from] = HL_STRING;
+				if (c == '\\' && i + 1 < row->size) {
+					hlMark(out, from, to, i + 1, 1, HL_STRING);
 					i += 2;
 					continue;
 				}
@@ -139,7 +207,7 @@ void editorUpdateSyntax(erow* row) {
 			} else {
 				if (c == '"' || c == '\'') {
 					in_string = c;
-					row->hl[i] = HL_STRING;
+					out[i - from] = HL_STRING;
 					i++;
 					continue;
 				}
@@ -147,8 +215,9 @@ void editorUpdateSyntax(erow* row) {
 		}
 
 		if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-			if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER)) {
-				row->hl[i] = HL_NUMBER;
+			if ((isdigit(static_cast<unsigned char>(c)) && (prev_sep || prev_hl == HL_NUMBER)) ||
+				(c == '.' && prev_hl == HL_NUMBER)) {
+				out[i - from] = HL_NUMBER;
 				i++;
 				prev_sep = 0;
 				continue;
@@ -158,13 +227,15 @@ void editorUpdateSyntax(erow* row) {
 		if (prev_sep) {
 			int j;
 			for (j = 0; keywords[j]; j++) {
+				if (keywords[j][0] != c)
+					continue;
 				int klen = strlen(keywords[j]);
 				int kw2 = keywords[j][klen - 1] == '|';
 				if (kw2)
 					klen--;
 
-				if (!strncmp(&row->render[i], keywords[j], klen) && is_separator(row->render[i + klen])) {
-					memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+				if (!strncmp(&chars[i], keywords[j], klen) && is_separator(static_cast<unsigned char>(chars[i + klen]))) {
+					hlMark(out, from, to, i, klen, kw2 ? HL_KEYWORD2 : HL_KEYWORD1);
 					i += klen;
 					break;
 				}
@@ -175,34 +246,174 @@ void editorUpdateSyntax(erow* row) {
 			}
 		}
 
-		prev_sep = is_separator(c);
+		prev_sep = is_separator(static_cast<unsigned char>(c));
 		i++;
 	}
 
-	int changed = (row->hl_open_comment != in_comment);
-	row->hl_open_comment = in_comment;
-	if (changed && row->idx + 1 < E.numrows)
-		editorUpdateSyntax(&E.row[row->idx + 1]);
-}
-
-int editorSyntaxToColor(int hl) {
-	switch (hl) {
-	case HL_COMMENT:
-	case HL_MLCOMMENT:
-		return 36;
-	case HL_KEYWORD1:
-		return 33;
-	case HL_KEYWORD2:
-		return 32;
-	case HL_STRING:
-		return 35;
-	case HL_NUMBER:
-		return 31;
-	case HL_MATCH:
-		return 34;
-	default:
-		return 37;
+	if (i > to) {
+		st->carry = i - to;
+		st->carry_hl = out[to - 1 - from];
 	}
+	st->prev_sep = prev_sep;
+	st->in_string = in_string;
+	st->in_comment = in_comment;
+	st->prev_hl = out[to - 1 - from];
+}
+
+// screen columns of the character at chars[j] when it sits at column rx, its length in bytes goes
+// to *len. Bytes that are not UTF-8 are drawn as one symbol each
+static inline int charColumns(const char* chars, int j, int n, int rx, int* len) {
+	unsigned char c = chars[j];
+	if (c < 0x80) {
+		*len = 1;
+		return c == '\t' ? TAB_SIZE - rx % TAB_SIZE : 1;
+	}
+	int cp;
+	*len = utf8Decode(chars + j, n - j, &cp);
+	return utf8Width(cp);
+}
+
+// turns per character highlight into runs over the render bytes, a tab widens the run it is in.
+// spans is reused, the new array is returned with its length in *nspans
+static hlSpan* hlBuildSpans(const char* chars, int n, const unsigned char* cls, int rx, bool ascii, hlSpan* spans,
+							int* nspans) {
+	int runs = n > 0 ? 1 : 0;
+	for (int j = 1; j < n; j++)
+		if (cls[j] != cls[j - 1])
+			runs++;
+	spans = static_cast<hlSpan*>(memRealloc(MEM_HL, spans, sizeof(hlSpan) * (runs > 0 ? runs : 1)));
+	*nspans = runs;
+
+	bool tabs = memchr(chars, '\t', n) != NULL;
+	int idx = 0;
+	int k = -1;
+	if (ascii || !tabs) {
+		for (int j = 0; j < n; j++) {
+			if (j == 0 || cls[j] != cls[j - 1]) {
+				spans[++k].len = 0;
+				spans[k].hl = cls[j];
+			}
+			int width = (tabs && chars[j] == '\t') ? TAB_SIZE - (rx + idx) % TAB_SIZE : 1;
+			spans[k].len += width;
+			idx += width;
+		}
+		return spans;
+	}
+
+	// tab stops depend on the columns taken by the characters in front, which are no longer bytes
+	int col = rx;
+	int next = 0; // first byte of the next character
+	for (int j = 0; j < n; j++) {
+		if (j == 0 || cls[j] != cls[j - 1]) {
+			spans[++k].len = 0;
+			spans[k].hl = cls[j];
+		}
+		if (j < next) {
+			spans[k].len++;
+			continue;
+		}
+		int len;
+		int width = charColumns(chars, j, n, col, &len);
+		spans[k].len += chars[j] == '\t' ? width : 1;
+		col += width;
+		next = j + len;
+	}
+	return spans;
+}
+
+static int chunkEnd(const erow* row, int k) {
+	return k + 1 < row->nchunks ? row->chunks[k + 1].cx : row->size;
+}
+
+static void freeChunkRender(rowChunk* chunk) {
+	memFree(MEM_RENDER, chunk->render);
+	memFree(MEM_HL, chunk->spans);
+	chunk->render = NULL;
+	chunk->spans = NULL;
+	chunk->nspans = 0;
+	chunk->rlen = 0;
+}
+
+// highlights a single row, returns whether its open comment state changed
+int editorHighlightRow(erow* row) {
+	hlState st;
+	hlInitState(&st, row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+
+	// the identifiers for completion, the declarations for the outline and the bracket depths come
+	// from the same pass
+	editorWordsBegin(row);
+	editorBracketsBegin();
+	if (row->chunks) {
+		// only the chunk states are kept, render and spans get rebuilt when a chunk is drawn
+		for (int k = 0; k < row->nchunks; k++) {
+			rowChunk* chunk = &row->chunks[k];
+			int n = chunkEnd(row, k) - chunk->cx;
+			chunk->state = st;
+			freeChunkRender(chunk);
+			unsigned char* cls = hlScratch(n);
+			editorHighlightChars(row, chunk->cx, chunk->cx + n, &st, cls);
+			editorWordsScan(row, chunk->cx, chunk->cx + n, cls);
+			editorBracketsScan(row, chunk->cx, chunk->cx + n, cls);
+		}
+		editorSymbolsRow(row, NULL);
+	} else {
+		unsigned char* cls = hlScratch(row->size);
+		editorHighlightChars(row, 0, row->size, &st, cls);
+		editorWordsScan(row, 0, row->size, cls);
+		editorBracketsScan(row, 0, row->size, cls);
+		editorSymbolsRow(row, cls);
+		row->spans = hlBuildSpans(row->chars, row->size, cls, 0, row->ascii, row->spans, &row->nspans);
+	}
+	editorWordsEnd(row);
+	editorBracketsEnd(row);
+
+	int changed = (row->hl_open_comment != st.in_comment);
+	row->hl_open_comment = st.in_comment;
+	return changed;
+}
+
+// a short row is a single piece, a long one has a piece per chunk
+int editorRowPieces(const erow* row) {
+	return row->chunks ? row->nchunks : 1;
+}
+
+// hands scan the classes of piece k of a row without touching its caches, from the state the last
+// highlight left at its start
+void editorRowPieceClasses(erow* row, int k, void (*scan)(const erow* row, int from, int to, const unsigned char* cls)) {
+	if (row->chunks) {
+		rowChunk* chunk = &row->chunks[k];
+		int n = chunkEnd(row, k) - chunk->cx;
+		hlState st = chunk->state;
+		unsigned char* cls = hlScratch(n);
+		editorHighlightChars(row, chunk->cx, chunk->cx + n, &st, cls);
+		scan(row, chunk->cx, chunk->cx + n, cls);
+	} else {
+		hlState st;
+		hlInitState(&st, row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+		unsigned char* cls = hlScratch(row->size);
+		editorHighlightChars(row, 0, row->size, &st, cls);
+		scan(row, 0, row->size, cls);
+	}
+}
+
+// the same for every piece of the row in order
+void editorRowClasses(erow* row, void (*scan)(const erow* row, int from, int to, const unsigned char* cls)) {
+	for (int k = 0; k < editorRowPieces(row); k++)
+		editorRowPieceClasses(row, k, scan);
+}
+
+// indexes the identifiers of a row again
+void editorRowIndexWords(erow* row) {
+	editorWordsBegin(row);
+	editorRowClasses(row, editorWordsScan);
+	editorWordsEnd(row);
+}
+
+void editorUpdateSyntax(erow* row) {
+	TRACE_SCOPE("editorUpdateSyntax");
+	// walk forward instead of recursing, a toggled comment can reach the end of the file
+	while (editorHighlightRow(row) && row->idx + 1 < E.numrows)
+		row = &E.row[row->idx + 1];
 }
 
 void editorSelectSyntaxHighlight() {
@@ -234,62 +445,484 @@ void editorSelectSyntaxHighlight() {
 
 /*** row operations ***/
 
-int editorRowCxToRx(erow* row, int cx) {
+// Every ASCII character but a tab is one column wide, so the tabs and the multibyte characters
+// alone are enough to convert between cx and rx. The list is built on first use and dropped on edit.
+void editorRowIndexTabs(erow* row) {
+	if (row->ntabs >= 0)
+		return;
+
+	if (!row->ascii) {
+		int count = 0;
+		for (int j = 0; j < row->size;) {
+			int len;
+			charColumns(row->chars, j, row->size, 0, &len);
+			if (len > 1 || row->chars[j] == '\t')
+				count++;
+			j += len;
+		}
+		row->tabs = count ? static_cast<tabStop*>(memAlloc(MEM_TABS, sizeof(tabStop) * count)) : NULL;
+		row->ntabs = count;
+		int rx = 0;
+		int t = 0;
+		for (int j = 0; j < row->size;) {
+			int len;
+			rx += charColumns(row->chars, j, row->size, rx, &len);
+			if (len > 1 || row->chars[j] == '\t') {
+				row->tabs[t].cx = j;
+				row->tabs[t].rx = rx;
+				row->tabs[t].len = len;
+				t++;
+			}
+			j += len;
+		}
+		return;
+	}
+
+	int count = 0;
+	const char* p = row->chars;
+	const char* end = row->chars + row->size;
+	while ((p = static_cast<const char*>(memchr(p, '\t', end - p))) != NULL) {
+		count++;
+		p++;
+	}
+
+	row->tabs = count ? static_cast<tabStop*>(memAlloc(MEM_TABS, sizeof(tabStop) * count)) : NULL;
+	row->ntabs = count;
 	int rx = 0;
-	int j;
-	for (j = 0; j < cx; j++) {
-		if (row->chars[j] == '\t')
-			rx += (TAB_SIZE - 1) - (rx % TAB_SIZE);
-		rx++;
+	int pos = 0;
+	p = row->chars;
+	for (int t = 0; t < count; t++) {
+		p = static_cast<const char*>(memchr(p, '\t', end - p));
+		int cx = static_cast<int>(p - row->chars);
+		rx += cx - pos;
+		rx += TAB_SIZE - (rx % TAB_SIZE);
+		row->tabs[t].cx = cx;
+		row->tabs[t].rx = rx;
+		row->tabs[t].len = 1;
+		pos = cx + 1;
+		p++;
+	}
+}
+
+/*** long rows ***/
+
+// render width of chars [from, to) when the first one sits at render column rx
+static int renderWidth(const char* chars, int from, int to, int rx, bool ascii) {
+	const char* p = chars + from;
+	const char* end = chars + to;
+	if (ascii) {
+		const char* tab;
+		while ((tab = static_cast<const char*>(memchr(p, '\t', end - p))) != NULL) {
+			rx += static_cast<int>(tab - p);
+			rx += TAB_SIZE - (rx % TAB_SIZE);
+			p = tab + 1;
+		}
+		return rx + static_cast<int>(end - p);
+	}
+	// one scan finds both the tabs and the multibyte text, the plain bytes between are a column each
+	while (p < end) {
+		int plain = utf8SkipPlain(p, static_cast<int>(end - p), '\t');
+		rx += plain;
+		p += plain;
+		if (p == end)
+			break;
+		int len;
+		rx += charColumns(p, 0, static_cast<int>(end - p), rx, &len);
+		p += len;
 	}
 	return rx;
 }
 
+// moves a chunk boundary off the continuation bytes of a character, a chunk never splits one
+static int charBoundary(const erow* row, int cx) {
+	for (int steps = 0; steps < 3 && cx < row->size && (row->chars[cx] & 0xc0) == 0x80; steps++)
+		cx++;
+	return cx;
+}
+
+// copies chars [0, n) to out with the tabs expanded, the first character sitting at column rx.
+// Returns the bytes written, *cols gets the column after the last character
+static int renderText(const char* chars, int n, int rx, bool ascii, char* out, int* cols) {
+	int idx = 0;
+	if (ascii) {
+		for (int j = 0; j < n; j++) {
+			if (chars[j] == '\t') {
+				out[idx++] = ' ';
+				while ((rx + idx) % TAB_SIZE != 0)
+					out[idx++] = ' ';
+			} else {
+				out[idx++] = chars[j];
+			}
+		}
+		*cols = rx + idx;
+	} else {
+		int col = rx;
+		for (int j = 0; j < n;) {
+			int len;
+			int width = charColumns(chars, j, n, col, &len);
+			if (chars[j] == '\t') {
+				memset(out + idx, ' ', width);
+				idx += width;
+			} else {
+				memcpy(out + idx, chars + j, len);
+				idx += len;
+			}
+			col += width;
+			j += len;
+		}
+		*cols = col;
+	}
+	out[idx] = '\0';
+	return idx;
+}
+
+static int countTabs(const char* chars, int n) {
+	int tabs = 0;
+	const char* p = chars;
+	const char* end = chars + n;
+	while ((p = static_cast<const char*>(memchr(p, '\t', end - p))) != NULL) {
+		tabs++;
+		p++;
+	}
+	return tabs;
+}
+
+// the chunk holding character cx, the last one for cx == size
+static int chunkAtCx(const erow* row, int cx) {
+	int lo = 0;
+	int hi = row->nchunks - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (row->chunks[mid].cx <= cx)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+// the piece of a row holding character cx
+int editorRowPieceAt(const erow* row, int cx) {
+	return row->chunks ? chunkAtCx(row, cx) : 0;
+}
+
+// the chunk holding render column rx
+static int chunkAtRx(const erow* row, int rx) {
+	int lo = 0;
+	int hi = row->nchunks - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (row->chunks[mid].rx <= rx)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+static void freeChunks(erow* row) {
+	for (int k = 0; k < row->nchunks; k++)
+		freeChunkRender(&row->chunks[k]);
+	memFree(MEM_CHUNKS, row->chunks);
+	row->chunks = NULL;
+	row->nchunks = 0;
+}
+
+// notes whether chunk k is ASCII and returns the column after it, the chunk starting at rx
+static int measureChunk(erow* row, int k, int rx) {
+	rowChunk* chunk = &row->chunks[k];
+	int end = chunkEnd(row, k);
+	chunk->ascii = utf8IsAscii(&row->chars[chunk->cx], end - chunk->cx);
+	return renderWidth(row->chars, chunk->cx, end, rx, chunk->ascii);
+}
+
+// cuts a long row into fresh chunks, the highlighter fills in their states afterwards
+static void chunkRow(erow* row) {
+	freeChunks(row);
+	memFree(MEM_RENDER, row->render);
+	memFree(MEM_HL, row->spans);
+	row->render = NULL;
+	row->spans = NULL;
+	row->nspans = 0;
+
+	row->nchunks = (row->size + ROW_CHUNK_SIZE - 1) / ROW_CHUNK_SIZE;
+	row->chunks = static_cast<rowChunk*>(memAlloc(MEM_CHUNKS, sizeof(rowChunk) * row->nchunks));
+	memset(row->chunks, 0, sizeof(rowChunk) * row->nchunks);
+	int rx = 0;
+	for (int k = 0; k < row->nchunks; k++)
+		row->chunks[k].cx = k == 0 ? 0 : charBoundary(row, k * ROW_CHUNK_SIZE);
+	for (int k = 0; k < row->nchunks; k++) {
+		row->chunks[k].rx = rx;
+		hlInitState(&row->chunks[k].state, 0);
+		rx = measureChunk(row, k, rx);
+	}
+	row->rsize = rx;
+	row->rlen = 0;
+}
+
+// builds render and spans of a chunk the first time it is needed
+static rowChunk* editorRowChunk(erow* row, int k) {
+	rowChunk* chunk = &row->chunks[k];
+	if (chunk->render)
+		return chunk;
+
+	int n = chunkEnd(row, k) - chunk->cx;
+	const char* chars = &row->chars[chunk->cx];
+	chunk->render = static_cast<char*>(memAlloc(MEM_RENDER, n + countTabs(chars, n) * (TAB_SIZE - 1) + 1));
+	int cols;
+	chunk->rlen = renderText(chars, n, chunk->rx, chunk->ascii, chunk->render, &cols);
+
+	hlState st = chunk->state;
+	unsigned char* cls = hlScratch(n);
+	editorHighlightChars(row, chunk->cx, chunk->cx + n, &st, cls);
+	chunk->spans = hlBuildSpans(chars, n, cls, chunk->rx, chunk->ascii, NULL, &chunk->nspans);
+	return chunk;
+}
+
+// the rendered piece of a row that holds column rx: the whole row, or the chunk of a long one.
+// *start is the row column the piece begins at, its first span starts there too. *len counts bytes,
+// which are also columns when *ascii is set
+const char* editorRowPiece(erow* row, int rx, int* start, int* len, const hlSpan** spans, int* nspans, bool* ascii) {
+	if (row->chunks == NULL) {
+		// a row of a buffer that went cold, only its text and comment state were kept
+		if (row->render == NULL) {
+			editorRenderRow(row);
+			editorHighlightRow(row);
+		}
+		*start = 0;
+		*len = row->rlen;
+		*spans = row->spans;
+		*nspans = row->nspans;
+		*ascii = row->ascii;
+		return row->render;
+	}
+	rowChunk* chunk = editorRowChunk(row, chunkAtRx(row, rx));
+	*start = chunk->rx;
+	*len = chunk->rlen;
+	*spans = chunk->spans;
+	*nspans = chunk->nspans;
+	*ascii = chunk->ascii;
+	return chunk->render;
+}
+
+// moves chunks [from, nchunks) right by shift render columns, the first tab after them takes up
+// whatever is not a whole tab stop and only its chunk has to be rendered again
+static void shiftChunks(erow* row, int from, int shift) {
+	if (shift % TAB_SIZE != 0) {
+		int start = row->chunks[from].cx;
+		const char* tab = static_cast<const char*>(memchr(&row->chars[start], '\t', row->size - start));
+		if (tab == NULL) {
+			for (int m = from; m < row->nchunks; m++)
+				row->chunks[m].rx += shift;
+			row->rsize += shift;
+			return;
+		}
+		int k = chunkAtCx(row, static_cast<int>(tab - row->chars));
+		int before = renderWidth(row->chars, row->chunks[k].cx, static_cast<int>(tab - row->chars), row->chunks[k].rx,
+								 row->chunks[k].ascii);
+		int after = before + shift;
+		int settled = (after + TAB_SIZE - after % TAB_SIZE) - (before + TAB_SIZE - before % TAB_SIZE);
+		for (int m = from; m <= k; m++)
+			row->chunks[m].rx += shift;
+		freeChunkRender(&row->chunks[k]);
+		from = k + 1;
+		shift = settled;
+	}
+	for (int m = from; m < row->nchunks; m++)
+		row->chunks[m].rx += shift;
+	row->rsize += shift;
+}
+
+// Updates a long row after an edit at `at` that inserted (delta > 0) or removed (delta < 0) characters.
+// Only the chunks from the edit on are highlighted again, up to the first one whose entry state came
+// out unchanged; everything after it just shifts.
+static void editorRowChangedChunked(erow* row, int at, int delta) {
+	// indexing the whole row on every key is what chunking avoids, completion catches up on it
+	editorWordsStale(row);
+	editorBracketsStale(row);
+	int removedEnd = delta < 0 ? at - delta : at;
+	int k = chunkAtCx(row, at);
+
+	// move the boundaries after the edit, dropping chunks that were deleted entirely
+	int out = k + 1;
+	for (int j = k + 1; j < row->nchunks; j++) {
+		if (row->chunks[j].cx < removedEnd || row->chunks[j].cx + delta <= row->chunks[out - 1].cx ||
+			row->chunks[j].cx + delta >= row->size) {
+			freeChunkRender(&row->chunks[j]);
+			continue;
+		}
+		row->chunks[j].cx += delta;
+		row->chunks[out++] = row->chunks[j];
+	}
+	row->nchunks = out;
+
+	// keep the edited chunk near ROW_CHUNK_SIZE by splitting or merging it
+	int len = chunkEnd(row, k) - row->chunks[k].cx;
+	int last = k;
+	if (len > 2 * ROW_CHUNK_SIZE) {
+		int pieces = len / ROW_CHUNK_SIZE;
+		row->chunks = static_cast<rowChunk*>(memRealloc(MEM_CHUNKS, row->chunks, sizeof(rowChunk) * (row->nchunks + pieces - 1)));
+		memmove(&row->chunks[k + pieces], &row->chunks[k + 1], sizeof(rowChunk) * (row->nchunks - k - 1));
+		for (int j = 1; j < pieces; j++) {
+			rowChunk* chunk = &row->chunks[k + j];
+			memset(chunk, 0, sizeof(rowChunk));
+			chunk->cx = charBoundary(row, row->chunks[k].cx + j * ROW_CHUNK_SIZE);
+		}
+		row->nchunks += pieces - 1;
+		last = k + pieces - 1;
+	} else if (len < ROW_CHUNK_SIZE / 4 && k + 1 < row->nchunks) {
+		freeChunkRender(&row->chunks[k + 1]);
+		memmove(&row->chunks[k + 1], &row->chunks[k + 2], sizeof(rowChunk) * (row->nchunks - k - 2));
+		row->nchunks--;
+	}
+
+	// a token in front of the edit may have looked into the edited text
+	int first = chunkAtCx(row, at > HL_MAX_LOOKAHEAD ? at - HL_MAX_LOOKAHEAD : 0);
+	if (first > k)
+		first = k;
+	hlState st = row->chunks[first].state;
+	int rx = row->chunks[first].rx;
+	bool converged = false;
+	for (int j = first; j < row->nchunks; j++) {
+		rowChunk* chunk = &row->chunks[j];
+		if (j > last && hlStateEquals(&st, &chunk->state)) {
+			shiftChunks(row, j, rx - chunk->rx);
+			converged = true;
+			break;
+		}
+		int n = chunkEnd(row, j) - chunk->cx;
+		chunk->state = st;
+		chunk->rx = rx;
+		freeChunkRender(chunk);
+		editorHighlightChars(row, chunk->cx, chunk->cx + n, &st, hlScratch(n));
+		rx = measureChunk(row, j, rx);
+	}
+	if (converged)
+		return;
+
+	row->rsize = rx;
+	if (row->hl_open_comment != st.in_comment) {
+		row->hl_open_comment = st.in_comment;
+		if (row->idx + 1 < E.numrows)
+			editorUpdateSyntax(&E.row[row->idx + 1]);
+	}
+}
+
+// to be called after the characters of a row changed at `at`, delta is the change in length
+void editorRowChanged(erow* row, int at, int delta) {
+	if (row->chunks == NULL || row->size <= ROW_CHUNK_THRESHOLD) {
+		editorUpdateRow(row);
+		return;
+	}
+	memFree(MEM_TABS, row->tabs);
+	row->tabs = NULL;
+	row->ntabs = -1;
+	editorRowChangedChunked(row, at, delta);
+	editorWrapRowSized(row->idx);
+}
+
+int editorRowCxToRx(erow* row, int cx) {
+	if (row->chunks) {
+		int k = chunkAtCx(row, cx);
+		return renderWidth(row->chars, row->chunks[k].cx, cx, row->chunks[k].rx, row->chunks[k].ascii);
+	}
+	editorRowIndexTabs(row);
+
+	// number of tabs in front of cx
+	int lo = 0;
+	int hi = row->ntabs;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (row->tabs[mid].cx < cx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return cx;
+	const tabStop* tab = &row->tabs[lo - 1];
+	return tab->rx + (cx - tab->cx - tab->len);
+}
+
 int editorRowRxToCx(erow* row, int rx) {
+	if (row->chunks) {
+		int k = chunkAtRx(row, rx);
+		int cur_rx = row->chunks[k].rx;
+		int cx;
+		for (cx = row->chunks[k].cx; cx < row->size;) {
+			int len;
+			cur_rx += charColumns(row->chars, cx, row->size, cur_rx, &len);
+			if (cur_rx > rx)
+				return cx;
+			cx += len;
+		}
+		return cx;
+	}
+	editorRowIndexTabs(row);
+
+	// number of tabs and multibyte characters that end at or before rx
+	int lo = 0;
+	int hi = row->ntabs;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (row->tabs[mid].rx <= rx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	int cx = 0;
 	int cur_rx = 0;
-	int cx;
-	for (cx = 0; cx < row->size; cx++) {
-		if (row->chars[cx] == '\t')
-			cur_rx += (TAB_SIZE - 1) - (cur_rx % TAB_SIZE);
-		cur_rx++;
-
-		if (cur_rx > rx)
-			return cx;
+	if (lo > 0) {
+		cx = row->tabs[lo - 1].cx + row->tabs[lo - 1].len;
+		cur_rx = row->tabs[lo - 1].rx;
 	}
-	return cx;
+	cx += rx - cur_rx;
+	// rx may land inside the expansion of the next tab, or the cells of a wide character
+	if (lo < row->ntabs && cx > row->tabs[lo].cx)
+		cx = row->tabs[lo].cx;
+	return cx < row->size ? cx : row->size;
 }
 
-void editorUpdateRow(erow* row) {
+void editorRenderRow(erow* row) {
+	memFree(MEM_TABS, row->tabs);
+	row->tabs = NULL;
+	row->ntabs = -1;
+
+	if (row->size > ROW_CHUNK_THRESHOLD) {
+		chunkRow(row);
+		return;
+	}
+	freeChunks(row);
+
 	int tabs = 0;
 	int j;
 	for (j = 0; j < row->size; j++)
 		if (row->chars[j] == '\t')
 			tabs++;
 
-	free(row->render);
-	row->render = static_cast<char*>(malloc(row->size + tabs * (TAB_SIZE - 1) + 1));
-
-	int idx = 0;
-	for (j = 0; j < row->size; j++) {
-		if (row->chars[j] == '\t') {
-			row->render[idx++] = ' ';
-			while (idx % TAB_SIZE != 0)
-				row->render[idx++] = ' ';
-		} else {
-			row->render[idx++] = row->chars[j];
-		}
-	}
-	row->render[idx] = '\0';
-	row->rsize = idx;
+	memFree(MEM_RENDER, row->render);
+	row->render = static_cast<char*>(memAlloc(MEM_RENDER, row->size + tabs * (TAB_SIZE - 1) + 1));
+	row->ascii = utf8IsAscii(row->chars, row->size);
+	row->rlen = renderText(row->chars, row->size, 0, row->ascii, row->render, &row->rsize);
+}
 
+void editorUpdateRow(erow* row) {
+	TRACE_SCOPE("editorUpdateRow");
+	editorRenderRow(row);
+	editorWrapRowSized(row->idx);
 	editorUpdateSyntax(row);
 }
 
 void editorInsertRow(int at, const char* s, size_t len) {
 	if (at < 0 || at > E.numrows)
 		return;
+	editorPanesRowsMoved(at, 0, 1);
+	editorSymbolsRowsMoved(at, 0, 1);
+	editorBracketsRowsMoved(at, 0, 1);
+	editorFoldRowsMoved(at, 0, 1);
+	editorWrapRowsMoved(at, 0, 1);
 
-	E.row = static_cast<erow*>(realloc(E.row, sizeof(erow) * (E.numrows + 1)));
+	E.row = static_cast<erow*>(memRealloc(MEM_ROWS, E.row, sizeof(erow) * (E.numrows + 1)));
 	memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
 	for (int j = at + 1; j <= E.numrows; j++)
 		E.row[j].idx++;
@@ -297,14 +930,25 @@ void editorInsertRow(int at, const char* s, size_t len) {
 	E.row[at].idx = at;
 
 	E.row[at].size = len;
-	E.row[at].chars = static_cast<char*>(malloc(len + 1));
+	E.row[at].chars = static_cast<char*>(memAlloc(MEM_CHARS, len + 1));
 	memcpy(E.row[at].chars, s, len);
 	E.row[at].chars[len] = '\0';
 
 	E.row[at].rsize = 0;
+	E.row[at].rlen = 0;
+	E.row[at].ascii = true;
+	E.row[at].crlf = E.eol == EOL_CRLF;
 	E.row[at].render = NULL;
-	E.row[at].hl = NULL;
+	E.row[at].spans = NULL;
+	E.row[at].nspans = 0;
 	E.row[at].hl_open_comment = 0;
+	E.row[at].tabs = NULL;
+	E.row[at].ntabs = -1;
+	E.row[at].chunks = NULL;
+	E.row[at].nchunks = 0;
+	E.row[at].words = NULL;
+	E.row[at].nwords = 0;
+	E.row[at].words_stale = false;
 	editorUpdateRow(&E.row[at]);
 
 	E.numrows++;
@@ -312,14 +956,40 @@ void editorInsertRow(int at, const char* s, size_t len) {
 }
 
 void editorFreeRow(erow* row) {
-	free(row->render);
-	free(row->chars);
-	free(row->hl);
+	memFree(MEM_RENDER, row->render);
+	memFree(MEM_CHARS, row->chars);
+	memFree(MEM_HL, row->spans);
+	memFree(MEM_TABS, row->tabs);
+	memFree(MEM_WORDS, row->words);
+	freeChunks(row);
+}
+
+// frees what can be rebuilt from the text, editorRowPiece brings it back when the row is drawn
+void editorRowDropCaches(erow* row) {
+	memFree(MEM_TABS, row->tabs);
+	row->tabs = NULL;
+	row->ntabs = -1;
+	if (row->chunks) {
+		for (int k = 0; k < row->nchunks; k++)
+			freeChunkRender(&row->chunks[k]);
+		return;
+	}
+	memFree(MEM_RENDER, row->render);
+	memFree(MEM_HL, row->spans);
+	row->render = NULL;
+	row->spans = NULL;
+	row->nspans = 0;
 }
 
 void editorDelRow(int at) {
 	if (at < 0 || at >= E.numrows)
 		return;
+	editorPanesRowsMoved(at, 1, 0);
+	editorSymbolsRowsMoved(at, 1, 0);
+	editorBracketsRowsMoved(at, 1, 0);
+	editorFoldRowsMoved(at, 1, 0);
+	editorWrapRowsMoved(at, 1, 0);
+	editorWordsRelease(&E.row[at]);
 	editorFreeRow(&E.row[at]);
 	memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
 	for (int j = at; j < E.numrows - 1; j++)
@@ -328,32 +998,139 @@ void editorDelRow(int at) {
 	E.dirty++;
 }
 
+// replaces rows [at, at + del) with ins new rows using a single move of the row array
+void editorSpliceRows(int at, int del, const rowText* lines, int ins) {
+	if (at < 0 || at > E.numrows)
+		return;
+	if (del > E.numrows - at)
+		del = E.numrows - at;
+	editorPanesRowsMoved(at, del, ins);
+	editorSymbolsRowsMoved(at, del, ins);
+	editorBracketsRowsMoved(at, del, ins);
+	editorFoldRowsMoved(at, del, ins);
+	editorWrapRowsMoved(at, del, ins);
+
+	for (int j = at; j < at + del; j++) {
+		editorWordsRelease(&E.row[j]);
+		editorFreeRow(&E.row[j]);
+	}
+
+	int numrows = E.numrows - del + ins;
+	if (ins > del)
+		E.row = static_cast<erow*>(memRealloc(MEM_ROWS, E.row, sizeof(erow) * numrows));
+	memmove(&E.row[at + ins], &E.row[at + del], sizeof(erow) * (E.numrows - at - del));
+
+	for (int j = 0; j < ins; j++) {
+		erow* row = &E.row[at + j];
+		row->size = lines[j].len;
+		row->chars = static_cast<char*>(memAlloc(MEM_CHARS, lines[j].len + 1));
+		memcpy(row->chars, lines[j].s, lines[j].len);
+		row->chars[lines[j].len] = '\0';
+		row->rsize = 0;
+		row->rlen = 0;
+		row->ascii = true;
+		row->crlf = lines[j].crlf;
+		row->render = NULL;
+		row->spans = NULL;
+		row->nspans = 0;
+		row->hl_open_comment = 0;
+		row->tabs = NULL;
+		row->ntabs = -1;
+		row->chunks = NULL;
+		row->nchunks = 0;
+		row->words = NULL;
+		row->nwords = 0;
+		row->words_stale = false;
+		editorRenderRow(row);
+		editorWrapRowSized(at + j);
+	}
+	E.numrows = numrows;
+	for (int j = at; j < E.numrows; j++)
+		E.row[j].idx = j;
+
+	// new rows are highlighted in order, then the first untouched row picks up any comment change
+	for (int j = at; j < at + ins; j++)
+		editorHighlightRow(&E.row[j]);
+	if (at + ins < E.numrows)
+		editorUpdateSyntax(&E.row[at + ins]);
+	E.dirty++;
+}
+
+// Moves rows [at, at + n) out of the buffer with their text and caches and returns an array holding them
+// at [*first, *first + n), with at least spare unused slots in front. Whichever side is smaller is what
+// gets copied: when most rows go, the row array goes with them and the rows that stay move to a new one.
+// The caller owns the rows and the array afterwards.
+erow* editorTakeRows(int at, int n, int spare, int* first) {
+	if (at < 0 || at > E.numrows)
+		return NULL;
+	if (n > E.numrows - at)
+		n = E.numrows - at;
+	if (n < 0)
+		n = 0;
+	editorPanesRowsMoved(at, n, 0);
+	editorSymbolsRowsMoved(at, n, 0);
+	editorBracketsRowsMoved(at, n, 0);
+	editorFoldRowsMoved(at, n, 0);
+	editorWrapRowsMoved(at, n, 0);
+	int keep = E.numrows - n;
+	erow* taken;
+	if (n > keep && at >= spare) {
+		taken = E.row;
+		E.row = NULL;
+		if (keep > 0) {
+			E.row = static_cast<erow*>(memAlloc(MEM_ROWS, sizeof(erow) * keep));
+			memcpy(E.row, taken, sizeof(erow) * at);
+			memcpy(&E.row[at], &taken[at + n], sizeof(erow) * (keep - at));
+		}
+		*first = at;
+	} else {
+		taken = static_cast<erow*>(memAlloc(MEM_ROWS, sizeof(erow) * (spare + n)));
+		if (n > 0) {
+			memcpy(&taken[spare], &E.row[at], sizeof(erow) * n);
+			memmove(&E.row[at], &E.row[at + n], sizeof(erow) * (keep - at));
+		}
+		*first = spare;
+	}
+	E.numrows = keep;
+	editorWordsReleaseRows(&taken[*first], n);
+	for (int j = at; j < E.numrows; j++)
+		E.row[j].idx = j;
+	if (at < E.numrows)
+		editorUpdateSyntax(&E.row[at]);
+	E.dirty++;
+	return taken;
+}
+
 void editorRowInsertChar(erow* row, int at, int c) {
 	if (at < 0 || at > row->size)
 		at = row->size;
-	row->chars = static_cast<char*>(realloc(row->chars, row->size + 2));
+	row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + 2));
 	memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
 	row->size++;
 	row->chars[at] = c;
-	editorUpdateRow(row);
+	editorRowChanged(row, at, 1);
 	E.dirty++;
 }
 
 void editorRowAppendString(erow* row, char* s, size_t len) {
-	row->chars = static_cast<char*>(realloc(row->chars, row->size + len + 1));
+	row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + len + 1));
 	memcpy(&row->chars[row->size], s, len);
+	int at = row->size;
 	row->size += len;
 	row->chars[row->size] = '\0';
-	editorUpdateRow(row);
+	editorRowChanged(row, at, static_cast<int>(len));
 	E.dirty++;
 }
 
-void editorRowDelChar(erow* row, int at) {
+// removes len bytes at `at`, a character that is more than one byte wide goes in one edit
+void editorRowDelChars(erow* row, int at, int len) {
 	if (at < 0 || at >= row->size)
 		return;
-	memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-	row->size--;
-	editorUpdateRow(row);
+	if (len > row->size - at)
+		len = row->size - at;
+	memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+	row->size -= len;
+	editorRowChanged(row, at, -len);
 	E.dirty++;
 }
 
@@ -368,15 +1145,20 @@ void editorInsertChar(int c) {
 }
 
 void editorInsertNewline() {
+	// in a file with both line endings the new line gets the ending of the one it came from
 	if (E.cx == 0) {
 		editorInsertRow(E.cy, "", 0);
+		if (E.cy + 1 < E.numrows)
+			E.row[E.cy].crlf = E.row[E.cy + 1].crlf;
 	} else {
 		erow* row = &E.row[E.cy];
 		editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
 		row = &E.row[E.cy];
+		E.row[E.cy + 1].crlf = row->crlf;
+		int removed = row->size - E.cx;
 		row->size = E.cx;
 		row->chars[row->size] = '\0';
-		editorUpdateRow(row);
+		editorRowChanged(row, E.cx, -removed);
 	}
 	E.cy++;
 	E.cx = 0;
@@ -384,10 +1166,9 @@ void editorInsertNewline() {
 
 void editorDelChar() {
 	if (E.cx == 0 && E.cy == 0) {
-		if (E.numrows == 1 && E.row[0].size == 0) {
-			editorFreeRow(&E.row[0]);
-			E.numrows = 0;
-		}
+		// the last row goes the same way any other does, so every index hears of it
+		if (E.numrows == 1 && E.row[0].size == 0)
+			editorDelRow(0);
 		return;
 	}
 	if (E.cy == E.numrows) {
@@ -397,37 +1178,55 @@ void editorDelChar() {
 	}
 	erow* row = &E.row[E.cy];
 	if (E.cx > 0) {
-		editorRowDelChar(row, E.cx - 1);
-		E.cx--;
+		// the whole character with its marks, not just its last byte
+		int from = utf8PrevCluster(row->chars, row->size, E.cx);
+		editorRowDelChars(row, from, E.cx - from);
+		E.cx = from;
 	} else {
 		E.cx = E.row[E.cy - 1].size;
 		editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+		// the joined line ends where the lower one did
+		E.row[E.cy - 1].crlf = row->crlf;
 		editorDelRow(E.cy);
 		E.cy--;
 	}
 }
 
 /*** file i/o ***/
-char* editorRowsToString(int* buflen) {
-	int totlen = 0;
-	int j;
-	for (j = 0; j < E.numrows; j++)
-		totlen += E.row[j].size + 1;
-	*buflen = totlen;
-
-	char* buf = static_cast<char*>(malloc(totlen));
-	char* p = buf;
-	for (j = 0; j < E.numrows; j++) {
-		memcpy(p, E.row[j].chars, E.row[j].size);
-		p += E.row[j].size;
-		*p = '\n';
-		p++;
-	}
 
-	return buf;
+// writes the rows out a block at a time, each with the line ending it was read with, so a save
+// never holds a second copy of the file. Returns the bytes written
+static long long editorWriteRows(std::ofstream& file) {
+	char* block = static_cast<char*>(memAlloc(MEM_SCRATCH, FILE_BLOCK_SIZE));
+	long long total = 0;
+	int used = 0;
+	for (int j = 0; j < E.numrows; j++) {
+		const erow* row = &E.row[j];
+		int eol = j == E.numrows - 1 && E.noeol ? 0 : row->crlf ? 2 : 1;
+		if (used + row->size + eol > FILE_BLOCK_SIZE) {
+			file.write(block, used);
+			total += used;
+			used = 0;
+		}
+		if (row->size + eol > FILE_BLOCK_SIZE) {
+			// a row that does not fit goes out directly
+			file.write(row->chars, row->size);
+			total += row->size;
+		} else {
+			memcpy(block + used, row->chars, row->size);
+			used += row->size;
+		}
+		memcpy(block + used, row->crlf ? "\r\n" : "\n", eol);
+		used += eol;
+	}
+	file.write(block, used);
+	total += used;
+	memFree(MEM_SCRATCH, block);
+	return total;
 }
 
 bool editorOpen(const char* filename) {
+	TRACE_SCOPE("editorOpen");
 	if (E.filename != nullptr) {
 		free(E.filename);
 	}
@@ -449,46 +1248,95 @@ bool editorOpen(const char* filename) {
 		// die("fopen");
 	}
 
-	std::string line;
-	while (std::getline(file, line)) {
-		// Remove trailing newline and carriage return characters
-		while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
-			line.pop_back();
+	// lines are split off each block as they complete, the part of a line still being read waits for the next
+	std::string data;
+	std::vector<rowText> lines;
+	eolCounts counts = {0, 0};
+	bool valid = true;
+	E.noeol = false;
+	while (true) {
+		size_t keep = data.size();
+		data.resize(keep + FILE_BLOCK_SIZE);
+		file.read(&data[keep], FILE_BLOCK_SIZE);
+		int n = static_cast<int>(file.gcount());
+		data.resize(keep + n);
+		bool eof = n < FILE_BLOCK_SIZE;
+
+		long long seen = counts.lines;
+		eolCount(data.data() + keep, n, keep > 0 ? data[keep - 1] : 0, &counts);
+		if (counts.lines == seen && !eof)
+			continue;
+
+		const char* base = data.data();
+		const char* p = base;
+		const char* end = base + data.size();
+		lines.clear();
+		while (p < end) {
+			const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!nl && !eof)
+				break;
+			int len = static_cast<int>((nl ? nl : end) - p);
+			bool crlf = nl && len > 0 && p[len - 1] == '\r';
+			lines.push_back({p, crlf ? len - 1 : len, crlf});
+			if (!nl) {
+				E.noeol = true;
+				p = end;
+				break;
+			}
+			p = nl + 1;
 		}
-		editorInsertRow(E.numrows, line.c_str(), line.size());
+		if (valid)
+			valid = utf8Valid(base, static_cast<int>(p - base));
+		if (!lines.empty())
+			editorSpliceRows(E.numrows, 0, lines.data(), static_cast<int>(lines.size()));
+		data.erase(0, p - base);
+		if (eof)
+			break;
 	}
+	E.eol = eolStyle(&counts);
+	if (!valid)
+		editorSetStatusMessage("%s is not valid UTF-8, the stray bytes show as ?", filename);
+	else if (E.eol == EOL_MIXED)
+		editorSetStatusMessage("%s mixes LF and CRLF line endings, each line keeps its own", filename);
 
 	E.dirty = false;
+	editorRememberDiskState();
+	watchFile(E.filename);
 	return true;
 }
 
 void editorSave() {
+	TRACE_SCOPE("editorSave");
 	if (E.filename == NULL) {
-		E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
+		E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL, 0);
 		if (E.filename == NULL) {
 			editorSetStatusMessage("Save aborted");
 			return;
 		}
 		editorSelectSyntaxHighlight();
+		watchFile(E.filename);
 	}
 
-	int buflen = 0;
-	char* buf = editorRowsToString(&buflen);
+	// someone else wrote the file since we loaded it, make the user confirm the overwrite
+	if (E.disk_changed == 1) {
+		E.disk_changed = 2;
+		editorSetStatusMessage("WARNING!!! File changed on disk. Press Ctrl-S again to overwrite.");
+		return;
+	}
 
 	std::ofstream file(E.filename, std::ios::binary | std::ios::trunc);
 
     if (file.is_open()) {
-		file.write(buf, buflen);
+		long long written = editorWriteRows(file);
         if (file.good()) {
             file.close();
-			free(buf);
             E.dirty = false;
-            editorSetStatusMessage("%d bytes written to disk", buflen);
+            editorRememberDiskState();
+            editorSetStatusMessage("%lld bytes written to disk", written);
             return;
         }
     }
 
-	free(buf);
 	editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
@@ -498,14 +1346,7 @@ void editorFindCallback(char* query, int key) {
 	static int last_match = -1;
 	static int direction = 1;
 
-	static int saved_hl_line;
-	static char* saved_hl = NULL;
-
-	if (saved_hl) {
-		memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-		free(saved_hl);
-		saved_hl = NULL;
-	}
+	E.match_row = -1;
 
 	if (key == '\r' || key == '\x1b') {
 		last_match = -1;
@@ -522,6 +1363,7 @@ void editorFindCallback(char* query, int key) {
 
 	if (last_match == -1)
 		direction = 1;
+	size_t qlen = strlen(query);
 	int current = last_match;
 	int i;
 	for (i = 0; i < E.numrows; i++) {
@@ -532,17 +1374,17 @@ void editorFindCallback(char* query, int key) {
 			current = 0;
 
 		erow* row = &E.row[current];
-		char* match = strstr(row->render, query);
+		const char* match = searchFind(row->chars, row->size, query, qlen);
 		if (match) {
 			last_match = current;
 			E.cy = current;
-			E.cx = editorRowRxToCx(row, match - row->render);
+			E.cx = static_cast<int>(match - row->chars);
 			E.rowoff = E.numrows;
 
-			saved_hl_line = current;
-			saved_hl = static_cast<char*>(malloc(row->rsize));
-			memcpy(saved_hl, row->hl, row->rsize);
-			memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
+			// highlighted while drawing, so long rows need not have their render built here
+			E.match_row = current;
+			E.match_rx = editorRowCxToRx(row, E.cx);
+			E.match_len = editorRowCxToRx(row, E.cx + static_cast<int>(qlen)) - E.match_rx;
 			break;
 		}
 	}
@@ -554,7 +1396,7 @@ void editorFind() {
 	int saved_coloff = E.coloff;
 	int saved_rowoff = E.rowoff;
 
-	char* query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback);
+	char* query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback, 0);
 
 	if (query) {
 		free(query);
@@ -580,28 +1422,46 @@ void abAppend(struct abuf* ab, const char* s, int len) {
 }
 
 void abFree(struct abuf* ab) {
+	// abAppend is too hot to count every append, a frame is counted once it is done
+	if (ab->b) {
+		long long bytes = static_cast<long long>(allocationSize(ab->b));
+		editorMemAdd(MEM_ABUF, bytes);
+		editorMemAdd(MEM_ABUF, -bytes);
+	}
 	free(ab->b);
 }
 
 /*** output ***/
 
 void editorScroll() {
+	editorPaneLayout();
+	// a jump or a search may have landed in a fold
+	editorFoldReveal(E.cy);
 	E.rx = 0;
 	if (E.cy < E.numrows) {
 		E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
 	}
 
-	if (E.cy < E.rowoff) {
-		E.rowoff = E.cy;
+	// folded rows take no lines and wrapped ones several, the screen scrolls by lines
+	editorWrapViewport();
+	int line = editorWrapLine(E.cy) + editorWrapSub(E.rx);
+	int top = editorWrapTop();
+	if (line < top) {
+		top = line;
 	}
-	if (E.cy >= E.rowoff + E.screenrows) {
-		E.rowoff = E.cy - E.screenrows + 1;
+	if (line >= top + E.viewrows) {
+		top = line - E.viewrows + 1;
+	}
+	E.rowoff = editorWrapRow(top, &E.wrapoff);
+	if (editorWrapActive()) {
+		E.coloff = 0;
+		return;
 	}
 	if (E.rx < E.coloff) {
 		E.coloff = E.rx;
 	}
-	if (E.rx >= E.coloff + E.screencols) {
-		E.coloff = E.rx - E.screencols + 1;
+	if (E.rx >= E.coloff + E.viewcols) {
+		E.coloff = E.rx - E.viewcols + 1;
 	}
 }
 
@@ -626,60 +1486,266 @@ void welcomeMessage(abuf* ab, int y) {
     abAppend(ab, WELCOME_MESSAGE, welcomelen);
 }
 
+// everything a refresh shows, in the order the backends write it
+void editorDrawScreen(struct abuf* ab) {
+	editorDrawRows(ab);
+	editorDrawStatusBar(ab);
+	editorDrawMessageBar(ab);
+	editorCursorsDraw(ab);
+	editorDrawLineCount(ab);
+}
+
 void editorDrawLineCount(struct abuf* ab) {
 	char buf[32];
-	snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
+	snprintf(buf, sizeof(buf), "\x1b[%d;%dH", E.viewtop + (editorWrapLine(E.cy) + editorWrapSub(E.rx) - editorWrapTop()) + 1,
+			 E.viewleft + editorWrapColumn(E.rx) + 1);
 	abAppend(ab, buf, strlen(buf));
 }
 
+
+// switches to class hl, the theme's escape is only sent when the class changes
+static const themeSgr* drawClass(struct abuf* ab, int hl, int* color) {
+	const themeSgr* sgr = &themeSequences[hl];
+	if (sgr->id != *color) {
+		abAppend(ab, sgr->seq, sgr->len);
+		*color = sgr->id;
+	}
+	return sgr;
+}
+
+// a character the terminal must not be sent as it is, drawn as an inverse symbol in its place
+static void drawSymbol(struct abuf* ab, char sym, const themeSgr* sgr) {
+	abAppend(ab, "\x1b[7m", 4);
+	abAppend(ab, &sym, 1);
+	abAppend(ab, "\x1b[m", 3);
+	if (sgr->id != themeRowStartId)
+		abAppend(ab, sgr->seq, sgr->len);
+}
+
+// appends len render bytes drawn in class hl
+static void drawRun(struct abuf* ab, const char* s, int len, int hl, int* color) {
+	if (len <= 0)
+		return;
+	const themeSgr* sgr = drawClass(ab, hl, color);
+	int from = 0;
+	for (int j = 0; j < len; j++) {
+		if (!iscntrl(static_cast<unsigned char>(s[j])))
+			continue;
+		abAppend(ab, s + from, j - from);
+		drawSymbol(ab, (s[j] <= 26) ? '@' + s[j] : '?', sgr);
+		from = j + 1;
+	}
+	abAppend(ab, s + from, len - from);
+}
+
+// a column range drawn in a class of its own over the highlighting, the selection, the brackets paired
+// at the cursor or the search match
+struct drawOverlay {
+	int from, to;
+	int hl;
+};
+
+// the overlays of a row, later ones are drawn over earlier ones. Sets eol when the selection takes in
+// the line ending, which is drawn as one selected column after the text
+static int rowOverlays(int filerow, drawOverlay* ov, bool* eol) {
+	int n = 0;
+	int from, to;
+	*eol = false;
+	if (editorSelectionOnRow(filerow, &from, &to, eol)) {
+		erow* row = &E.row[filerow];
+		ov[n].from = from == 0 ? 0 : editorRowCxToRx(row, from);
+		ov[n].to = to == row->size ? row->rsize : editorRowCxToRx(row, to);
+		ov[n++].hl = HL_SELECTION;
+	}
+	int cols[2];
+	int pair = editorBracketsOnRow(filerow, cols);
+	for (int i = 0; i < pair; i++) {
+		erow* row = &E.row[filerow];
+		ov[n].from = editorRowCxToRx(row, cols[i]);
+		ov[n].to = editorRowCxToRx(row, cols[i] + 1);
+		ov[n++].hl = HL_BRACKET;
+	}
+	if (filerow == E.match_row) {
+		ov[n].from = E.match_rx;
+		ov[n].to = E.match_rx + E.match_len;
+		ov[n++].hl = HL_MATCH;
+	}
+	return n;
+}
+
+static int overlayClass(const drawOverlay* ov, int nov, int at, int hl) {
+	for (int i = 0; i < nov; i++)
+		if (at >= ov[i].from && at < ov[i].to)
+			hl = ov[i].hl;
+	return hl;
+}
+
+// a run of columns [from, to) on a row with overlays, split where an overlay starts or ends
+static void drawOverlaidRun(struct abuf* ab, const char* s, int from, int to, int hl, const drawOverlay* ov, int nov,
+							int* color) {
+	int at = from;
+	while (at < to) {
+		int next = to;
+		for (int i = 0; i < nov; i++) {
+			if (ov[i].from > at && ov[i].from < next)
+				next = ov[i].from;
+			if (ov[i].to > at && ov[i].to < next)
+				next = ov[i].to;
+		}
+		drawRun(ab, s + (at - from), next - at, overlayClass(ov, nov, at, hl), color);
+		at = next;
+	}
+}
+
+// Draws columns [col, colEnd) of a piece holding multibyte characters, returns the column it got to.
+// Spans count bytes here, so the walk starts at the front of the piece and measures as it goes.
+// A wide character cut by either edge is drawn as spaces, so the line keeps its width.
+static int drawUtf8Piece(struct abuf* ab, const char* render, int len, int start, const hlSpan* spans, int nspans,
+						 int col, int colEnd, const drawOverlay* ov, int nov, int* color) {
+	static const char spaces[] = "  ";
+	int at = start;
+	int k = 0;
+	int spanEnd = nspans > 0 ? spans[0].len : len;
+	int runFrom = 0;
+	int runLen = 0;
+	int runHl = HL_NORMAL;
+	for (int b = 0; b < len;) {
+		int cp;
+		int n = utf8Decode(render + b, len - b, &cp);
+		int width = utf8Width(cp);
+		if (at >= colEnd && width > 0)
+			break;
+		while (k + 1 < nspans && b >= spanEnd)
+			spanEnd += spans[++k].len;
+		int hl = overlayClass(ov, nov, at, nspans > 0 ? spans[k].hl : static_cast<int>(HL_NORMAL));
+
+		// a mark is shown when the character it sits on is
+		bool visible = width > 0 ? at >= col && at + width <= colEnd : at > col;
+		if (visible && ((cp >= 0 && cp < 0x80) || utf8Printable(cp))) {
+			if (runLen > 0 && hl != runHl) {
+				drawRun(ab, render + runFrom, runLen, runHl, color);
+				runLen = 0;
+			}
+			if (runLen == 0) {
+				runFrom = b;
+				runHl = hl;
+			}
+			runLen += n;
+		} else {
+			drawRun(ab, render + runFrom, runLen, runHl, color);
+			runLen = 0;
+			if (visible) {
+				drawSymbol(ab, '?', drawClass(ab, hl, color));
+			} else if (width > 0 && at + width > col) {
+				int from = at > col ? at : col;
+				int to = at + width < colEnd ? at + width : colEnd;
+				drawRun(ab, spaces, to - from, hl, color);
+			}
+		}
+		at += width;
+		b += n;
+	}
+	drawRun(ab, render + runFrom, runLen, runHl, color);
+	return at < colEnd ? at : colEnd;
+}
+
+// draws line y of the panel, returns false once the panel has no more lines
+static bool editorDrawPanelLine(struct abuf* ab, int y) {
+	if (E.panel == NULL)
+		return false;
+	const char* line = E.panel;
+	for (int i = 0; i < y; i++) {
+		line = strchr(line, '\n');
+		if (line == NULL)
+			return false;
+		line++;
+	}
+	if (*line == '\0')
+		return false;
+	int len = static_cast<int>(strcspn(line, "\n"));
+	if (len > E.screencols)
+		len = E.screencols;
+	abAppend(ab, line, len);
+	abAppend(ab, "\x1b[K", 3);
+	abAppend(ab, "\r\n", 2);
+	return true;
+}
+
+// draws screen columns [coloff, coloff + cols) of a row, returns how many columns that took
+int editorDrawRowSlice(struct abuf* ab, int filerow, int coloff, int cols) {
+	erow* row = &E.row[filerow];
+	int color = themeRowStartId;
+	int col = coloff;
+	int colEnd = coloff + cols < row->rsize ? coloff + cols : row->rsize;
+	drawOverlay ov[4];
+	bool eol;
+	int nov = rowOverlays(filerow, ov, &eol);
+	// long rows hand out their render in chunks, only the visible ones get built
+	while (col < colEnd) {
+		int start, len, nspans;
+		const hlSpan* spans;
+		bool ascii;
+		const char* render = editorRowPiece(row, col, &start, &len, &spans, &nspans, &ascii);
+		if (!ascii) {
+			int reached = drawUtf8Piece(ab, render, len, start, spans, nspans, col, colEnd, ov, nov, &color);
+			if (reached <= col)
+				break;
+			col = reached;
+			continue;
+		}
+		int pieceEnd = start + len < colEnd ? start + len : colEnd;
+		// walk the runs up to the first visible one, pieces are at most a chunk or a short row
+		int runEnd = start;
+		for (int k = 0; k < nspans && col < pieceEnd; k++) {
+			runEnd += spans[k].len;
+			if (runEnd <= col)
+				continue;
+			if (runEnd > pieceEnd)
+				runEnd = pieceEnd;
+			if (nov > 0)
+				drawOverlaidRun(ab, render + (col - start), col, runEnd, spans[k].hl, ov, nov, &color);
+			else
+				drawRun(ab, render + (col - start), runEnd - col, spans[k].hl, &color);
+			col = runEnd;
+		}
+		col = pieceEnd;
+	}
+	int drawn = colEnd > coloff ? colEnd - coloff : 0;
+	if (eol && row->rsize >= coloff && row->rsize < coloff + cols) {
+		drawRun(ab, " ", 1, HL_SELECTION, &color);
+		drawn++;
+	}
+	int folded = editorFoldEnd(filerow) - filerow;
+	if (folded > 0 && drawn < cols) {
+		char note[32];
+		int len = snprintf(note, sizeof(note), " ... %d lines", folded);
+		if (len > cols - drawn)
+			len = cols - drawn;
+		drawRun(ab, note, len, HL_COMMENT, &color);
+		drawn += len;
+	}
+	abAppend(ab, themeReset.seq, themeReset.len);
+	return drawn;
+}
+
 void editorDrawRows(struct abuf* ab) {
 	int y;
+	int top = editorWrapTop();
 	for (y = 0; y < E.screenrows - 2; y++) {
-		int filerow = y + E.rowoff;
+		if (editorDrawPanelLine(ab, y))
+			continue;
+		// split layouts compose the line from their panes
+		if (editorPaneDrawLine(ab, y))
+			continue;
+		int sub;
+		int filerow = editorWrapRow(top + y, &sub);
 		if (filerow >= E.numrows) {
 			welcomeMessage(ab, y);
 			abAppend(ab, "\x1b[K", 3);
 			abAppend(ab, "\r\n", 2);
 			continue;
 		}
-		int len = E.row[filerow].rsize - E.coloff;
-		if (len < 0)
-			len = 0;
-		if (len > E.screencols)
-			len = E.screencols;
-		char* c = &E.row[filerow].render[E.coloff];
-		unsigned char* hl = &E.row[filerow].hl[E.coloff];
-		int current_color = -1;
-		int j;
-		for (j = 0; j < len; j++) {
-			if (c != nullptr && iscntrl(c[j])) {
-				char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-				abAppend(ab, "\x1b[7m", 4);
-				abAppend(ab, &sym, 1);
-				abAppend(ab, "\x1b[m", 3);
-				if (current_color != -1) {
-					char buf[16];
-					int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-					abAppend(ab, buf, clen);
-				}
-			} else if (hl[j] == HL_NORMAL) {
-				if (current_color != -1) {
-					abAppend(ab, "\x1b[39m", 5);
-					current_color = -1;
-				}
-				abAppend(ab, &c[j], 1);
-			} else {
-				int color = editorSyntaxToColor(hl[j]);
-				if (color != current_color) {
-					current_color = color;
-					char buf[16];
-					int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-					abAppend(ab, buf, clen);
-				}
-				abAppend(ab, &c[j], 1);
-			}
-		}
-		abAppend(ab, "\x1b[39m", 5);
+		editorDrawRowSlice(ab, filerow, sub * E.viewcols + E.coloff, E.screencols);
 		abAppend(ab, "\x1b[K", 3);
 		abAppend(ab, "\r\n", 2);
 	}
@@ -687,11 +1753,17 @@ void editorDrawRows(struct abuf* ab) {
 
 void editorDrawStatusBar(struct abuf* ab) {
 	abAppend(ab, "\x1b[7m", 4);
-	char status[80], rstatus[80];
-	int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E.filename ? E.filename : "[No Name]", E.numrows,
-					   E.dirty ? "(modified)" : "");
-	int rlen =
-		snprintf(rstatus, sizeof(rstatus), "%s | %d/%d", E.syntax ? E.syntax->filetype : "no ft", E.cy + 1, E.numrows);
+	char status[80], rstatus[80], stream[48];
+	int streamed = editorStreamStatus(stream, sizeof(stream));
+	const char* name = E.filename ? E.filename : (streamed ? "[stdin]" : "[No Name]");
+	int len = snprintf(status, sizeof(status), "%.20s - %d lines %s%s", name, E.numrows, E.dirty ? "(modified) " : "",
+					   stream);
+	int rlen;
+	if (editorPagerActive())
+		rlen = editorPagerStatus(rstatus, sizeof(rstatus));
+	else
+		rlen = snprintf(rstatus, sizeof(rstatus), "%s%s%s | %d/%d", E.syntax ? E.syntax->filetype : "no ft",
+						E.eol != EOL_LF ? " | " : "", E.eol != EOL_LF ? eolName(E.eol) : "", E.cy + 1, E.numrows);
 	if (len > E.screencols)
 		len = E.screencols;
 	abAppend(ab, status, len);
@@ -710,11 +1782,26 @@ void editorDrawStatusBar(struct abuf* ab) {
 
 void editorDrawMessageBar(struct abuf* ab) {
 	abAppend(ab, "\x1b[K", 3);
+	char hud[96];
+	int hudlen = editorHudStatus(hud, sizeof(hud));
+	if (hudlen > E.screencols)
+		hudlen = E.screencols;
 	int msglen = strlen(E.statusmsg);
+	if (time(NULL) - E.statusmsg_time >= STATUS_MESSAGE_TIME)
+		msglen = 0;
+	// the hud sits at the right end, a long message pushes it out
+	if (hudlen && msglen + 1 + hudlen > E.screencols)
+		hudlen = 0;
 	if (msglen > E.screencols)
 		msglen = E.screencols;
-	if (msglen && time(NULL) - E.statusmsg_time < STATUS_MESSAGE_TIME)
-		abAppend(ab, E.statusmsg, msglen);
+	abAppend(ab, E.statusmsg, msglen);
+	if (hudlen) {
+		for (int i = msglen; i < E.screencols - hudlen; i++)
+			abAppend(ab, " ", 1);
+		abAppend(ab, "\x1b[7m", 4);
+		abAppend(ab, hud, hudlen);
+		abAppend(ab, "\x1b[m", 3);
+	}
 }
 
 
@@ -728,35 +1815,71 @@ void editorSetStatusMessage(const char* fmt, ...) {
 
 /*** input ***/
 
-char* editorPrompt(const char* prompt, void (*callback)(char*, int)) {
+// set while a prompt owns the keyboard, background work must not move rows under its callback
+static int prompt_active = 0;
+
+// called by readKey while it waits for input
+void editorIdle() {
+	// streamed rows only ever get appended, that is safe even under a prompt.
+	// Keep ingesting in short slices for as long as the keyboard is quiet.
+	while (editorStreamDrain()) {
+		editorRefreshScreen();
+		if (inputPending())
+			break;
+	}
+	// so are grep results, a slice per tick while their buffer is shown
+	if (editorGrepDrain())
+		editorRefreshScreen();
+	// retired text is off screen, freeing it is fine under a prompt too
+	editorSelectionIdle();
+	editorWordsIdle();
+	// long rows edited since their brackets were summed, and rows off the screen measured for a new width
+	editorBracketsIdle();
+	editorWrapIdle();
+	// the file picker is a prompt, a walk that finished under it updates the list
+	if (editorFinderIdle())
+		editorRefreshScreen();
+	if (prompt_active)
+		return;
+	if (editorPagerIdle())
+		editorRefreshScreen();
+	editorCheckFileChanged();
+}
+
+char* editorPrompt(const char* prompt, void (*callback)(char*, int), int flags) {
 	size_t bufsize = 128;
 	char* buf = static_cast<char*>(malloc(bufsize));
 
 	size_t buflen = 0;
 	buf[0] = '\0';
 
+	prompt_active++;
 	while (1) {
 		editorSetStatusMessage(prompt, buf);
 		editorRefreshScreen();
 
 		int c = readKey();
 		if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
-			if (buflen != 0)
-				buf[--buflen] = '\0';
+			if (buflen != 0) {
+				buflen = utf8PrevCluster(buf, static_cast<int>(buflen), static_cast<int>(buflen));
+				buf[buflen] = '\0';
+			}
 		} else if (c == '\x1b' || c == CTRL_KEY('q')) {
 			editorSetStatusMessage("");
 			if (callback)
 				callback(buf, c);
 			free(buf);
+			prompt_active--;
 			return NULL;
 		} else if (c == '\r' || c == '\n') {
-			if (buflen != 0) {
+			if (buflen != 0 || (flags & PROMPT_ACCEPT_EMPTY)) {
 				editorSetStatusMessage("");
 				if (callback)
 					callback(buf, c);
+				prompt_active--;
 				return buf;
 			}
-		} else if (!iscntrl(c) && c < 128) {
+		} else if ((c >= 32 && c < 127) || (c >= 128 && c < 256)) {
 			if (buflen == bufsize - 1) {
 				bufsize *= 2;
 				buf = static_cast<char*>(realloc(buf, bufsize));
@@ -770,34 +1893,75 @@ char* editorPrompt(const char* prompt, void (*callback)(char*, int)) {
 	}
 }
 
+// puts the cursor on row cy at screen column rx, the nearest character boundary at or before it
+static void editorMoveToColumn(int cy, int rx) {
+	E.cy = cy;
+	if (E.cy >= E.numrows) {
+		E.cx = 0;
+		return;
+	}
+	erow* row = &E.row[E.cy];
+	E.cx = editorRowRxToCx(row, rx);
+	if (E.cx < row->size)
+		E.cx = utf8PrevCluster(row->chars, row->size, E.cx + 1);
+}
+
+// keeps the cursor on the screen column it had on the row it left
+static void editorMoveVertical(int cy) {
+	editorMoveToColumn(cy, E.cy < E.numrows ? editorRowCxToRx(&E.row[E.cy], E.cx) : 0);
+}
+
+// With soft wrap a line up or down may still be on the same row. Leaving the row keeps the column
+// on the line, the row above is entered on its last line.
+static void editorMoveWrapped(int dir) {
+	int width = E.viewcols > 0 ? E.viewcols : 1;
+	int rx = E.cy < E.numrows ? editorRowCxToRx(&E.row[E.cy], E.cx) : 0;
+	int last = E.cy < E.numrows ? E.row[E.cy].rsize / width : 0;
+	if (dir < 0 && rx >= width) {
+		editorMoveToColumn(E.cy, rx - width);
+	} else if (dir > 0 && rx / width < last) {
+		editorMoveToColumn(E.cy, rx + width);
+	} else if (dir < 0 && E.cy > 0) {
+		int cy = editorFoldPrev(E.cy);
+		editorMoveToColumn(cy, E.row[cy].rsize / width * width + rx % width);
+	} else if (dir > 0 && E.cy < E.numrows) {
+		editorMoveToColumn(editorFoldNext(E.cy), rx % width);
+	}
+}
+
 void editorMoveCursor(int key) {
 	erow* row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
 
+	// left and right step over whole characters, marks and joined emoji included
 	switch (key) {
 	case ARROW_LEFT:
 		if (E.cx != 0) {
-			E.cx--;
+			E.cx = utf8PrevCluster(row->chars, row->size, E.cx);
 		} else if (E.cy > 0) {
-			E.cy--;
+			E.cy = editorFoldPrev(E.cy);
 			E.cx = E.row[E.cy].size;
 		}
 		break;
 	case ARROW_RIGHT:
 		if (row && E.cx < row->size) {
-			E.cx++;
+			E.cx = utf8NextCluster(row->chars, row->size, E.cx);
 		} else if (row && E.cx == row->size) {
-			E.cy++;
+			E.cy = editorFoldNext(E.cy);
 			E.cx = 0;
 		}
 		break;
 	case ARROW_UP:
-		if (E.cy != 0) {
-			E.cy--;
+		if (editorWrapActive()) {
+			editorMoveWrapped(-1);
+		} else if (E.cy != 0) {
+			editorMoveVertical(editorFoldPrev(E.cy));
 		}
 		break;
 	case ARROW_DOWN:
-		if (E.cy < E.numrows) {
-			E.cy++;
+		if (editorWrapActive()) {
+			editorMoveWrapped(1);
+		} else if (E.cy < E.numrows) {
+			editorMoveVertical(editorFoldNext(E.cy));
 		}
 		break;
 	}
@@ -809,30 +1973,301 @@ void editorMoveCursor(int key) {
 	}
 }
 
+// jumps to a 1-based line, or to a position in the file for input like "50%"
+void editorGoto() {
+	char* target = editorPrompt("Go to line (or N%%): %s (ESC to cancel)", NULL, 0);
+	if (target == NULL)
+		return;
+
+	if (editorPagerActive()) {
+		if (!editorPagerGoto(target))
+			editorSetStatusMessage("Not a line number: %s", target);
+		free(target);
+		return;
+	}
+
+	char* end;
+	double value = strtod(target, &end);
+	if (end == target) {
+		editorSetStatusMessage("Not a line number: %s", target);
+	} else {
+		int line = (*end == '%') ? static_cast<int>(E.numrows * value / 100) : static_cast<int>(value) - 1;
+		if (line >= E.numrows)
+			line = E.numrows - 1;
+		if (line < 0)
+			line = 0;
+		E.cy = line;
+		E.cx = 0;
+		E.rowoff = E.cy;
+	}
+	free(target);
+}
+
+/*** commands ***/
+
+// a command typed at the Ctrl-E prompt, args is what follows the name
+struct editorCommandEntry {
+	const char* name;
+	void (*run)(const char* args);
+};
+
+// writes the trace recorded so far, to the --trace file unless another path is given
+static void commandTrace(const char* args) {
+	if (!KILO_TRACE) {
+		editorSetStatusMessage("Tracing is not compiled in, rebuild with -DKILO_TRACE=ON");
+		return;
+	}
+	if (!editorTracing()) {
+		editorSetStatusMessage("Tracing is off, start with --trace=<file>");
+		return;
+	}
+	const char* path = *args ? args : editorTracePath();
+	if (editorTraceDump(path))
+		editorSetStatusMessage("Trace written to %s", path);
+	else
+		editorSetStatusMessage("Can't write trace! I/O error: %s", strerror(errno));
+}
+
+static void commandHud(const char*) {
+	editorHudToggle();
+}
+
+// shows bytes per subsystem with their peaks until the next key
+static void commandMem(const char*) {
+	char report[2048];
+	editorMemReport(report, sizeof(report));
+	free(E.panel);
+	E.panel = strdup(report);
+}
+
+// switches to a built-in theme or a theme file, the name alone says which one is in use
+static void commandTheme(const char* args) {
+	if (*args == '\0')
+		editorSetStatusMessage("Theme: %s (%s colors)", editorThemeName(),
+							   editorColorDepth() == COLOR_TRUE ? "24 bit" : editorColorDepth() == COLOR_256 ? "256" : "16");
+	else if (!editorThemeLoad(args))
+		editorSetStatusMessage("Can't load theme %s", args);
+}
+
+// lists the open buffers until the next key
+static void commandBuffers(const char*) {
+	char list[4096];
+	editorBufferList(list, sizeof(list));
+	free(E.panel);
+	E.panel = strdup(list);
+}
+
+static void commandBuffer(const char* args) {
+	if (*args == '\0')
+		commandBuffers(args);
+	else if (!editorBufferSwitchTo(args))
+		editorSetStatusMessage("No buffer %s", args);
+}
+
+static void commandSplit(const char*) {
+	editorPaneSplit(false);
+}
+
+static void commandVsplit(const char*) {
+	editorPaneSplit(true);
+}
+
+static void commandUnsplit(const char*) {
+	editorPaneClose();
+}
+
+static void commandOnly(const char*) {
+	editorPaneOnly();
+}
+
+static void commandFold(const char*) {
+	editorFoldToggle();
+}
+
+static void commandUnfold(const char*) {
+	editorFoldOpenAll();
+}
+
+static void commandWrap(const char*) {
+	editorWrapToggle();
+}
+
+// grep <text> [directory], text in double quotes may have spaces. The directory defaults to the current one
+static void commandGrep(const char* args) {
+	std::string pattern;
+	const char* rest;
+	if (*args == '"') {
+		const char* close = strchr(args + 1, '"');
+		if (close == NULL) {
+			editorSetStatusMessage("grep: missing closing quote");
+			return;
+		}
+		pattern.assign(args + 1, close - args - 1);
+		rest = close + 1;
+	} else {
+		size_t len = strcspn(args, " ");
+		pattern.assign(args, len);
+		rest = args + len;
+	}
+	rest += strspn(rest, " ");
+	if (pattern.empty()) {
+		editorSetStatusMessage("Usage: grep <text> [directory]");
+		return;
+	}
+	editorGrepStart(pattern.c_str(), *rest ? rest : ".");
+}
+
+static const editorCommandEntry commands[] = {
+	{"trace", commandTrace},
+	{"hud", commandHud},
+	{"mem", commandMem},
+	{"theme", commandTheme},
+	{"buffers", commandBuffers},
+	{"buffer", commandBuffer},
+	{"split", commandSplit},
+	{"vsplit", commandVsplit},
+	{"unsplit", commandUnsplit},
+	{"only", commandOnly},
+	{"fold", commandFold},
+	{"unfold", commandUnfold},
+	{"wrap", commandWrap},
+	{"grep", commandGrep},
+};
+
+void editorCommand() {
+	char* line = editorPrompt("Command: %s (ESC to cancel)", NULL, 0);
+	if (line == NULL)
+		return;
+
+	char* args = line + strcspn(line, " ");
+	if (*args)
+		*args++ = '\0';
+	args += strspn(args, " ");
+
+	bool found = false;
+	for (const editorCommandEntry& command : commands) {
+		if (strcmp(command.name, line) == 0) {
+			command.run(args);
+			found = true;
+			break;
+		}
+	}
+	if (!found)
+		editorSetStatusMessage("Unknown command: %s", line);
+	free(line);
+}
+
+void editorOpenPrompt() {
+	char* filename = editorPrompt("Open: %s (ESC to cancel)", NULL, 0);
+	if (filename == NULL)
+		return;
+	editorBufferOpen(filename);
+	free(filename);
+}
+
+// tells the user why an edit did nothing, returns true when the buffer can't be changed
+bool editorRejectReadOnly() {
+	if (!E.readonly)
+		return false;
+	editorSetStatusMessage("Buffer is read-only");
+	return true;
+}
+
 bool editorProcessKeypress(int c) {
 	static int quit_times = KILO_QUIT_TIMES;
+	static int close_times = 1;
+	static int reload_times = 1;
+
+	if (E.panel) {
+		free(E.panel);
+		E.panel = NULL;
+	}
+
+	// with several cursors the editing and motion keys go to every one of them
+	if (editorCursorsKey(c) || editorSelectionKey(c)) {
+		quit_times = KILO_QUIT_TIMES;
+		close_times = 1;
+		reload_times = 1;
+		return false;
+	}
 
 	switch (c) {
 	case '\n':
 	case '\r':
-		editorInsertNewline();
+		if (editorGrepJump())
+			break;
+		if (!editorRejectReadOnly())
+			editorInsertNewline();
 		break;
 	
-	case CTRL_KEY('q'):
-		if (E.dirty && quit_times > 0) {
-			editorSetStatusMessage("WARNING!!! File has unsaved changes. "
-								   "Press Ctrl-Q %d more times to quit.",
-								   quit_times);
+	case CTRL_KEY('q'): {
+		int dirty = editorBufferDirtyCount();
+		if (dirty && quit_times > 0) {
+			if (dirty > 1)
+				editorSetStatusMessage("WARNING!!! %d buffers have unsaved changes. "
+									   "Press Ctrl-Q %d more times to quit.",
+									   dirty, quit_times);
+			else
+				editorSetStatusMessage("WARNING!!! File has unsaved changes. "
+									   "Press Ctrl-Q %d more times to quit.",
+									   quit_times);
 			quit_times--;
 			return false;
 		}
 		//write(STDOUT_FILENO, "\x1b[2J", 4);
 		//write(STDOUT_FILENO, "\x1b[H", 3);
 		return true;
+	}
+
+	case CTRL_KEY('o'):
+		editorOpenPrompt();
+		break;
+
+	case CTRL_KEY('p'):
+		editorFinderOpen();
+		break;
+
+	case CTRL_KEY('n'):
+		if (!editorRejectReadOnly())
+			editorComplete();
+		break;
+
+	case CTRL_KEY('t'):
+		editorSymbolsOutline();
+		break;
+
+	case CTRL_KEY(']'):
+		editorSymbolsJump();
+		break;
+
+	case CTRL_KEY('k'):
+		editorBracketsJump();
+		break;
+
+	case CTRL_KEY('y'):
+		editorFoldToggle();
+		break;
+
+	case CTRL_KEY('b'):
+		editorBufferNext();
+		break;
+
+	case CTRL_KEY('\\'):
+		editorPaneNext();
+		break;
+
+	case CTRL_KEY('w'):
+		if (E.dirty && close_times > 0) {
+			editorSetStatusMessage("WARNING!!! File has unsaved changes. Press Ctrl-W again to close it.");
+			close_times--;
+			return false;
+		}
+		editorBufferClose();
 		break;
 
 	case CTRL_KEY('s'):
-		editorSave();
+		if (!editorRejectReadOnly())
+			editorSave();
 		break;
 
 	case HOME_KEY:
@@ -848,9 +2283,40 @@ bool editorProcessKeypress(int c) {
 		editorFind();
 		break;
 
+	case CTRL_KEY('g'):
+		editorGoto();
+		break;
+
+	case CTRL_KEY('d'):
+		editorCursorAddNextMatch();
+		break;
+
+	case ALT_ARROW_UP:
+	case ALT_ARROW_DOWN:
+		editorCursorAddVertical(c == ALT_ARROW_UP ? -1 : 1);
+		break;
+
+	case CTRL_KEY('e'):
+		editorCommand();
+		break;
+
+	case CTRL_KEY('r'):
+		if (editorRejectReadOnly())
+			break;
+		if (E.dirty && reload_times > 0) {
+			editorSetStatusMessage("WARNING!!! File has unsaved changes. Press Ctrl-R again to discard them.");
+			reload_times--;
+			return false;
+		}
+		if (!editorReload())
+			editorSetStatusMessage("Can't reload! I/O error: %s", strerror(errno));
+		break;
+
 	case BACKSPACE:
 	case CTRL_KEY('h'):
 	case DEL_KEY:
+		if (editorRejectReadOnly())
+			break;
 		if (c == DEL_KEY)
 			editorMoveCursor(ARROW_RIGHT);
 		editorDelChar();
@@ -858,15 +2324,17 @@ bool editorProcessKeypress(int c) {
 
 	case PAGE_UP:
 	case PAGE_DOWN: {
+		// a page is lines on screen, folded rows are stepped over whole and wrapped ones line by line
+		int sub;
 		if (c == PAGE_UP) {
 			E.cy = E.rowoff;
 		} else if (c == PAGE_DOWN) {
-			E.cy = E.rowoff + E.screenrows - 1;
+			E.cy = editorWrapRow(editorWrapTop() + E.viewrows - 1, &sub);
 			if (E.cy > E.numrows)
 				E.cy = E.numrows;
 		}
 
-		int times = E.screenrows;
+		int times = E.viewrows;
 		while (times--)
 			editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
 	} break;
@@ -883,11 +2351,15 @@ bool editorProcessKeypress(int c) {
 		break;
 
 	default:
-		editorInsertChar(c);
+		if (!editorRejectReadOnly())
+			editorInsertChar(c);
 		break;
 	}
 
+	editorPagerSlide();
 	quit_times = KILO_QUIT_TIMES;
+	close_times = 1;
+	reload_times = 1;
 	return false;
 }
 
@@ -898,6 +2370,7 @@ void initEditor() {
 	E.cy = 0;
 	E.rx = 0;
 	E.rowoff = 0;
+	E.wrapoff = 0;
 	E.coloff = 0;
 	E.numrows = 0;
 	E.row = NULL;
@@ -906,19 +2379,54 @@ void initEditor() {
 	E.statusmsg[0] = '\0';
 	E.statusmsg_time = 0;
 	E.syntax = NULL;
+	E.disk_mtime = -1;
+	E.disk_size = -1;
+	E.disk_changed = 0;
+	E.readonly = 0;
+	E.eol = EOL_LF;
+	E.noeol = false;
+	E.match_row = -1;
+	E.panel = NULL;
+	E.words = NULL;
+	E.symbols = NULL;
+	E.brackets = NULL;
+	E.folds = NULL;
+	E.wraps = NULL;
 
 	updateWindowSize();
+	editorPaneLayout();
 	// E.screenrows -= 2;
 }
 
 
 void editorStart(const char* filenameIn) {
 	initEditor();
+
+	// "-" reads the buffer from a pipe, stdin has to be swapped for the terminal before raw mode
+	int streamFd = -1;
+	if (filenameIn != nullptr && strcmp(filenameIn, "-") == 0) {
+		streamFd = openStdinStream();
+		if (streamFd < 0) {
+			std::cerr << "Nothing is piped into stdin" << std::endl;
+			return;
+		}
+		filenameIn = nullptr;
+	}
+
 	if (enableRawMode() != 0) {
 		return;
 	}
+	editorStreamStart(streamFd);
 
-	if (filenameIn != nullptr) {
+	if (filenameIn != nullptr && editorPagerWanted(filenameIn)) {
+		if (!editorPagerOpen(filenameIn)) {
+			editorSetStatusMessage("%s", "File cannot be opened, Press any key to exit");
+			editorRefreshScreen();
+			readKey();
+			disableRawMode();
+			return;
+		}
+	} else if (filenameIn != nullptr) {
 		// to convert from const to non const, a.k.a making a copy
 		if (!editorOpen(filenameIn)) {
 			editorSetStatusMessage("%s", "File cannot exist, Press any key to exit");
@@ -929,7 +2437,9 @@ void editorStart(const char* filenameIn) {
 		}
 	}
 
-	editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
+	// a warning from loading the file goes first
+	if (E.statusmsg[0] == '\0')
+		editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-G = go to | Ctrl-R = reload");
 	editorRefreshScreen();
 	while (true) {
 		int key = readKey();
@@ -940,11 +2450,19 @@ void editorStart(const char* filenameIn) {
 	}
 
 
+	editorBufferFreeAll();
 	for (int i = 0; i < E.numrows; i++) {
 		editorFreeRow(&E.row[i]);
 	}
+	editorWordsFree(E.words);
+	editorSymbolsFree(E.symbols);
+	editorBracketsFree(E.brackets);
+	editorFoldFree(E.folds);
+	editorWrapFree(E.wraps);
 	if (E.filename)
 		free(E.filename);
+	unwatchFile();
+	editorPagerClose();
 
 
 	disableRawMode();
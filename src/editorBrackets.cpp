@@ -0,0 +1,580 @@
+#include "editorBrackets.hpp"
+#include "editorMem.hpp"
+#include "editorTrace.hpp"
+#include <climits>
+#include <cstring>
+#include <vector>
+
+/*** depth sums ***/
+
+enum { BRACKET_ROUND = 0, BRACKET_SQUARE, BRACKET_CURLY, BRACKET_TYPES };
+
+// Brackets of one type over a stretch of text, an opener counting +1 and a closer -1. low is the lowest
+// the running sum gets from the front and high the highest a sum taken back from the end gets, both
+// counting the empty stretch, so a search walking in can tell whether its match is inside.
+struct bracketDepth {
+	int delta;
+	int low;
+	int high;
+};
+
+struct bracketSum {
+	bracketDepth t[BRACKET_TYPES];
+};
+
+static inline bracketDepth combine(const bracketDepth& a, const bracketDepth& b) {
+	bracketDepth s;
+	s.delta = a.delta + b.delta;
+	s.low = a.low < a.delta + b.low ? a.low : a.delta + b.low;
+	s.high = b.high > b.delta + a.high ? b.high : b.delta + a.high;
+	return s;
+}
+
+static inline bracketSum combine(const bracketSum& a, const bracketSum& b) {
+	bracketSum s;
+	for (int t = 0; t < BRACKET_TYPES; t++)
+		s.t[t] = combine(a.t[t], b.t[t]);
+	return s;
+}
+
+// 0 for no bracket, else 1 + type * 2 + 1 for a closer
+static inline int bracketCode(char c) {
+	switch (c) {
+	case '(':
+		return 1;
+	case ')':
+		return 2;
+	case '[':
+		return 3;
+	case ']':
+		return 4;
+	case '{':
+		return 5;
+	case '}':
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+static inline bool counts(unsigned char hl) {
+	return hl != HL_COMMENT && hl != HL_MLCOMMENT && hl != HL_STRING;
+}
+
+/*** index ***/
+
+// Per row sums and a segment tree over blocks of BRACKETS_BLOCK rows. A row highlighted again updates
+// its block and the blocks above it. Rows moving shift the row sums and leave the tree out of date from
+// their block on, it is brought back by the next lookup, which is what typing a newline costs anyway
+// in moving the row array.
+struct bracketIndex {
+	std::vector<bracketSum> rows;
+	std::vector<bracketSum> tree; // 2 * size nodes, 1 is the root and block b is size + b
+	int size;					  // blocks the tree has room for, a power of two
+	int dirty;					  // first block the tree is out of date from, INT_MAX when it is not
+	int pending;				  // block whose rows changed since the path above it was updated, -1 for none
+	std::vector<int> stale;		  // long rows edited without being summed again
+	long long tracked;			  // bytes reported to the memory accounting
+};
+
+static unsigned long long changes; // any index changed, the pair drawn around the cursor is kept against it
+
+// A stale row summed a few chunks per idle tick, so a key pressed meanwhile is not held up by the row.
+// Editing the row or moving rows starts it over.
+static struct {
+	const bracketIndex* ix;
+	int row; // -1 for none
+	int piece;
+	bracketSum sum;
+} resum = {NULL, -1, 0, {}};
+
+static void track(bracketIndex* ix) {
+	long long bytes = static_cast<long long>((ix->rows.capacity() + ix->tree.capacity()) * sizeof(bracketSum) +
+											 ix->stale.capacity() * sizeof(int));
+	editorMemAdd(MEM_BRACKETS, bytes - ix->tracked);
+	ix->tracked = bytes;
+}
+
+void editorBracketsFree(bracketIndex* ix) {
+	if (ix == NULL)
+		return;
+	editorMemAdd(MEM_BRACKETS, -ix->tracked);
+	if (resum.ix == ix)
+		resum = {NULL, -1, 0, {}};
+	delete ix;
+	changes++;
+}
+
+static bracketSum blockSum(const bracketIndex* ix, int b) {
+	bracketSum s = {};
+	int end = (b + 1) * BRACKETS_BLOCK;
+	if (end > static_cast<int>(ix->rows.size()))
+		end = static_cast<int>(ix->rows.size());
+	for (int r = b * BRACKETS_BLOCK; r < end; r++)
+		s = combine(s, ix->rows[r]);
+	return s;
+}
+
+static void updateBlock(bracketIndex* ix, int b) {
+	int i = ix->size + b;
+	ix->tree[i] = blockSum(ix, b);
+	for (i /= 2; i >= 1; i /= 2)
+		ix->tree[i] = combine(ix->tree[2 * i], ix->tree[2 * i + 1]);
+}
+
+// the blocks from dirty on and every node above them, level by level
+static void rebuild(bracketIndex* ix) {
+	if (ix->pending >= 0 && ix->pending < ix->dirty)
+		updateBlock(ix, ix->pending);
+	ix->pending = -1;
+	if (ix->dirty >= ix->size)
+		return;
+	TRACE_SCOPE("bracketsRebuild");
+	for (int b = ix->dirty; b < ix->size; b++)
+		ix->tree[ix->size + b] = blockSum(ix, b);
+	int lo = (ix->size + ix->dirty) / 2;
+	int hi = (2 * ix->size - 1) / 2;
+	for (; lo >= 1; lo /= 2, hi /= 2)
+		for (int i = lo; i <= hi; i++)
+			ix->tree[i] = combine(ix->tree[2 * i], ix->tree[2 * i + 1]);
+	ix->dirty = INT_MAX;
+}
+
+// rows [at, at + del) were replaced by ins others
+void editorBracketsRowsMoved(int at, int del, int ins) {
+	bracketIndex* ix = E.brackets;
+	if (ix == NULL) {
+		ix = E.brackets = new bracketIndex();
+		ix->rows.assign(E.numrows, bracketSum{});
+		ix->size = 1;
+		ix->tree.assign(2, bracketSum{});
+		ix->dirty = 0;
+		ix->pending = -1;
+		ix->tracked = 0;
+	}
+	int n = static_cast<int>(ix->rows.size());
+	if (at > n)
+		at = n;
+	if (del > n - at)
+		del = n - at;
+	if (del > 0)
+		ix->rows.erase(ix->rows.begin() + at, ix->rows.begin() + at + del);
+	if (ins > 0)
+		ix->rows.insert(ix->rows.begin() + at, ins, bracketSum{});
+
+	size_t out = 0;
+	for (size_t i = 0; i < ix->stale.size(); i++) {
+		int r = ix->stale[i];
+		if (r >= at && r < at + del)
+			continue;
+		ix->stale[out++] = r >= at + del ? r + ins - del : r;
+	}
+	ix->stale.resize(out);
+	resum.row = -1;
+
+	int blocks = (static_cast<int>(ix->rows.size()) + BRACKETS_BLOCK - 1) / BRACKETS_BLOCK;
+	if (blocks > ix->size) {
+		while (ix->size < blocks)
+			ix->size *= 2;
+		ix->tree.assign(2 * ix->size, bracketSum{});
+		ix->dirty = 0;
+	} else if (at / BRACKETS_BLOCK < ix->dirty) {
+		ix->dirty = at / BRACKETS_BLOCK;
+	}
+	changes++;
+	track(ix);
+}
+
+/*** summing rows ***/
+
+static bracketSum acc; // the row being summed
+
+void editorBracketsBegin() {
+	acc = bracketSum{};
+}
+
+void editorBracketsScan(const erow* row, int from, int to, const unsigned char* cls) {
+	if (E.brackets == NULL)
+		return;
+	for (int i = from; i < to; i++) {
+		int code = bracketCode(row->chars[i]);
+		if (code == 0 || !counts(cls[i - from]))
+			continue;
+		bracketDepth* d = &acc.t[(code - 1) >> 1];
+		int v = (code & 1) ? 1 : -1;
+		d->delta += v;
+		if (d->delta < d->low)
+			d->low = d->delta;
+		d->high = d->high + v > 0 ? d->high + v : 0;
+	}
+}
+
+void editorBracketsEnd(const erow* row) {
+	bracketIndex* ix = E.brackets;
+	if (ix == NULL || row->idx >= static_cast<int>(ix->rows.size()))
+		return;
+	// columns may have moved even when the sums did not
+	changes++;
+	if (resum.ix == ix && resum.row == row->idx)
+		resum.row = -1;
+	if (memcmp(&ix->rows[row->idx], &acc, sizeof(acc)) == 0)
+		return;
+	ix->rows[row->idx] = acc;
+	// rows are highlighted in runs, the path above a block is walked once the run leaves it
+	int b = row->idx / BRACKETS_BLOCK;
+	if (b == ix->pending || b >= ix->dirty)
+		return;
+	if (ix->pending >= 0 && ix->pending < ix->dirty)
+		updateBlock(ix, ix->pending);
+	ix->pending = b;
+}
+
+// a long row changed without being highlighted whole, the next lookup sums it again
+void editorBracketsStale(const erow* row) {
+	bracketIndex* ix = E.brackets;
+	if (ix == NULL)
+		return;
+	changes++;
+	if (resum.ix == ix && resum.row == row->idx)
+		resum.row = -1;
+	for (int r : ix->stale)
+		if (r == row->idx)
+			return;
+	ix->stale.push_back(row->idx);
+	track(ix);
+}
+
+static void resumStep(const erow* row, int from, int to, const unsigned char* cls) {
+	acc = resum.sum;
+	editorBracketsScan(row, from, to, cls);
+	resum.sum = acc;
+}
+
+// sums stale rows again for up to budget pieces, returns true when all of them are done
+static bool settle(bracketIndex* ix, int budget) {
+	while (!ix->stale.empty()) {
+		int r = ix->stale.back();
+		if (r >= E.numrows) {
+			ix->stale.pop_back();
+			continue;
+		}
+		erow* row = &E.row[r];
+		if (resum.ix != ix || resum.row != r) {
+			resum = {ix, r, 0, {}};
+		}
+		for (; resum.piece < editorRowPieces(row); resum.piece++) {
+			if (budget-- <= 0)
+				return false;
+			editorRowPieceClasses(row, resum.piece, resumStep);
+		}
+		acc = resum.sum;
+		resum.row = -1;
+		ix->stale.pop_back();
+		editorBracketsEnd(row);
+	}
+	return true;
+}
+
+// a slice of the long rows edited since they were last summed, returns true while some are left
+bool editorBracketsIdle() {
+	bracketIndex* ix = E.brackets;
+	if (ix == NULL || ix->stale.empty() || static_cast<int>(ix->rows.size()) != E.numrows)
+		return false;
+	return !settle(ix, BRACKETS_IDLE_PIECES);
+}
+
+/*** matching ***/
+
+struct bracketEvent {
+	int col;
+	int code;
+};
+
+static std::vector<bracketEvent> events; // the counted brackets of one row or piece of it, in order
+
+static void collect(const erow* row, int from, int to, const unsigned char* cls) {
+	for (int i = from; i < to; i++) {
+		int code = bracketCode(row->chars[i]);
+		if (code != 0 && counts(cls[i - from]))
+			events.push_back({i, code});
+	}
+}
+
+static void rowEvents(int r) {
+	events.clear();
+	editorRowClasses(&E.row[r], collect);
+}
+
+static void pieceEvents(int r, int k) {
+	events.clear();
+	editorRowPieceClasses(&E.row[r], k, collect);
+}
+
+// the first block at or after from that the running depth d reaches zero in, d passes the ones before
+static int firstBlock(const bracketIndex* ix, int node, int lo, int hi, int from, int t, int* d) {
+	if (hi <= from)
+		return -1;
+	const bracketDepth& s = ix->tree[node].t[t];
+	if (lo >= from && *d + s.low > 0) {
+		*d += s.delta;
+		return -1;
+	}
+	if (hi - lo == 1)
+		return lo;
+	int mid = (lo + hi) / 2;
+	int b = firstBlock(ix, 2 * node, lo, mid, from, t, d);
+	return b >= 0 ? b : firstBlock(ix, 2 * node + 1, mid, hi, from, t, d);
+}
+
+// the last block before to that the depth reaches zero in walking back, d counts unmatched closers
+static int lastBlock(const bracketIndex* ix, int node, int lo, int hi, int to, int t, int* d) {
+	if (lo >= to)
+		return -1;
+	const bracketDepth& s = ix->tree[node].t[t];
+	if (hi <= to && *d - s.high > 0) {
+		*d -= s.delta;
+		return -1;
+	}
+	if (hi - lo == 1)
+		return lo;
+	int mid = (lo + hi) / 2;
+	int b = lastBlock(ix, 2 * node + 1, mid, hi, to, t, d);
+	return b >= 0 ? b : lastBlock(ix, 2 * node, lo, mid, to, t, d);
+}
+
+// the row below r the opener is closed on, with the depth left entering it
+static int closingRow(const bracketIndex* ix, int r, int t, int* d) {
+	int n = static_cast<int>(ix->rows.size());
+	for (r++; r < n && r % BRACKETS_BLOCK != 0; r++) {
+		if (*d + ix->rows[r].t[t].low <= 0)
+			return r;
+		*d += ix->rows[r].t[t].delta;
+	}
+	if (r >= n)
+		return -1;
+	int b = firstBlock(ix, 1, 0, ix->size, r / BRACKETS_BLOCK, t, d);
+	if (b < 0)
+		return -1;
+	for (r = b * BRACKETS_BLOCK; r < n; r++) {
+		if (*d + ix->rows[r].t[t].low <= 0)
+			return r;
+		*d += ix->rows[r].t[t].delta;
+	}
+	return -1;
+}
+
+// the row above r the closer is opened on, with the unmatched closers left entering it from the end
+static int openingRow(const bracketIndex* ix, int r, int t, int* d) {
+	for (r--; r >= 0 && (r + 1) % BRACKETS_BLOCK != 0; r--) {
+		if (*d - ix->rows[r].t[t].high <= 0)
+			return r;
+		*d -= ix->rows[r].t[t].delta;
+	}
+	if (r < 0)
+		return -1;
+	int b = lastBlock(ix, 1, 0, ix->size, (r + 1) / BRACKETS_BLOCK, t, d);
+	if (b < 0)
+		return -1;
+	int n = static_cast<int>(ix->rows.size());
+	for (r = (b + 1) * BRACKETS_BLOCK - 1 < n ? (b + 1) * BRACKETS_BLOCK - 1 : n - 1; r >= 0; r--) {
+		if (*d - ix->rows[r].t[t].high <= 0)
+			return r;
+		*d -= ix->rows[r].t[t].delta;
+	}
+	return -1;
+}
+
+// the column of the first event from `from` on the row that brings the depth of type t to zero, -1 if
+// none does
+static int closeIn(int t, int from, int* d) {
+	for (int j = from; j < static_cast<int>(events.size()); j++) {
+		if (((events[j].code - 1) >> 1) != t)
+			continue;
+		*d += (events[j].code & 1) ? 1 : -1;
+		if (*d == 0)
+			return events[j].col;
+	}
+	return -1;
+}
+
+// the same walking back from the event before `before`, d counts unmatched closers
+static int openIn(int t, int before, int* d) {
+	for (int j = before - 1; j >= 0; j--) {
+		if (((events[j].code - 1) >> 1) != t)
+			continue;
+		*d -= (events[j].code & 1) ? 1 : -1;
+		if (*d == 0)
+			return events[j].col;
+	}
+	return -1;
+}
+
+// Sums of rows edited since they were last summed are only trusted once settled: an explicit lookup
+// settles them first, a drawn pair only crosses rows when no other row is waiting.
+static bool ready(bracketIndex* ix, bool settled) {
+	if (ix == NULL || static_cast<int>(ix->rows.size()) != E.numrows)
+		return false;
+	if (settled)
+		settle(ix, INT_MAX);
+	rebuild(ix);
+	return true;
+}
+
+static bool othersStale(const bracketIndex* ix, int row) {
+	for (int r : ix->stale)
+		if (r != row)
+			return true;
+	return false;
+}
+
+// Walks the pieces of row r from piece k on, forward or back, for the bracket that brings d to zero.
+// Each piece highlighted takes one from budget; -1 when the row has none, -2 when the budget ran out.
+static int walkRow(int r, int k, int t, bool forward, int* d, int* budget) {
+	for (; k >= 0 && k < editorRowPieces(&E.row[r]); k += forward ? 1 : -1) {
+		if ((*budget)-- <= 0)
+			return -2;
+		pieceEvents(r, k);
+		int c = forward ? closeIn(t, 0, d) : openIn(t, static_cast<int>(events.size()), d);
+		if (c >= 0)
+			return c;
+	}
+	return -1;
+}
+
+// the match of the bracket at (row, col), highlighting the pieces of rows outward from it and no more
+// than budget of them
+static bool match(bracketIndex* ix, int row, int col, bool settled, int budget, int* matchRow, int* matchCol) {
+	if (row < 0 || row >= E.numrows || col < 0 || col >= E.row[row].size || bracketCode(E.row[row].chars[col]) == 0 ||
+		!ready(ix, settled))
+		return false;
+	TRACE_SCOPE("editorBracketsMatch");
+	int k = editorRowPieceAt(&E.row[row], col);
+	budget--;
+	pieceEvents(row, k);
+	int i = 0;
+	int nevents = static_cast<int>(events.size());
+	while (i < nevents && events[i].col != col)
+		i++;
+	if (i == nevents)
+		return false; // in a string or a comment
+	int t = (events[i].code - 1) >> 1;
+	bool opener = events[i].code & 1;
+	int d = 1;
+	int c = opener ? closeIn(t, i + 1, &d) : openIn(t, i, &d);
+	if (c < 0)
+		c = walkRow(row, opener ? k + 1 : k - 1, t, opener, &d, &budget);
+	int r = row;
+	if (c == -1) {
+		if (!settled && othersStale(ix, row))
+			return false;
+		r = opener ? closingRow(ix, row, t, &d) : openingRow(ix, row, t, &d);
+		if (r < 0)
+			return false;
+		c = walkRow(r, opener ? 0 : editorRowPieces(&E.row[r]) - 1, t, opener, &d, &budget);
+	}
+	if (c < 0)
+		return false;
+	*matchRow = r;
+	*matchCol = c;
+	return true;
+}
+
+bool editorBracketsMatch(int row, int col, int* matchRow, int* matchCol) {
+	return match(E.brackets, row, col, true, INT_MAX, matchRow, matchCol);
+}
+
+// The brace block to fold at row: the outermost one opened on the row and closed below it, otherwise
+// the innermost one around the row. first is the row it opens on, last the row it closes on.
+bool editorBracketsBlock(int row, int* first, int* last) {
+	bracketIndex* ix = E.brackets;
+	if (row < 0 || row >= E.numrows || !ready(ix, true))
+		return false;
+	rowEvents(row);
+	int open = -1;
+	int depth = 0;
+	for (const bracketEvent& ev : events) {
+		if (((ev.code - 1) >> 1) != BRACKET_CURLY)
+			continue;
+		if (ev.code & 1) {
+			if (depth++ == 0)
+				open = ev.col;
+		} else if (depth > 0) {
+			depth--;
+		}
+	}
+	int r = row;
+	if (depth == 0) {
+		int d = 1;
+		r = openingRow(ix, row, BRACKET_CURLY, &d);
+		if (r < 0)
+			return false;
+		rowEvents(r);
+		open = openIn(BRACKET_CURLY, static_cast<int>(events.size()), &d);
+		if (open < 0)
+			return false;
+	}
+	int closeCol;
+	if (!editorBracketsMatch(r, open, last, &closeCol) || *last <= r)
+		return false;
+	*first = r;
+	return true;
+}
+
+/*** cursor ***/
+
+// the pair at the cursor, or just before it, found once for all the rows drawn
+static struct {
+	const bracketIndex* ix;
+	unsigned long long changes;
+	int cx, cy;
+	bool found;
+	int row[2], col[2];
+} pair = {NULL, 0, -1, -1, false, {0, 0}, {0, 0}};
+
+// a drawn pair settles nothing and gives up past BRACKETS_DRAW_PIECES pieces, Ctrl-K goes all the way
+static bool cursorPair(bool drawn, int* row, int* col) {
+	row[0] = col[0] = -1;
+	if (E.cy >= E.numrows)
+		return false;
+	bool settled = !drawn;
+	int budget = drawn ? BRACKETS_DRAW_PIECES : INT_MAX;
+	for (int cx = E.cx; cx >= E.cx - 1 && cx >= 0; cx--) {
+		if (match(E.brackets, E.cy, cx, settled, budget, &row[1], &col[1])) {
+			row[0] = E.cy;
+			col[0] = cx;
+			return true;
+		}
+	}
+	return false;
+}
+
+// the columns of the pair at the cursor on row, how many there are
+int editorBracketsOnRow(int row, int* cols) {
+	if (E.brackets == NULL)
+		return 0;
+	if (pair.ix != E.brackets || pair.changes != changes || pair.cx != E.cx || pair.cy != E.cy) {
+		pair.found = cursorPair(true, pair.row, pair.col);
+		pair.ix = E.brackets;
+		pair.changes = changes;
+		pair.cx = E.cx;
+		pair.cy = E.cy;
+	}
+	if (!pair.found)
+		return 0;
+	int n = 0;
+	for (int i = 0; i < 2; i++)
+		if (pair.row[i] == row)
+			cols[n++] = pair.col[i];
+	return n;
+}
+
+// Ctrl-K, to the bracket matching the one at the cursor
+void editorBracketsJump() {
+	int row[2], col[2];
+	if (!cursorPair(false, row, col)) {
+		editorSetStatusMessage("No matching bracket");
+		return;
+	}
+	E.cy = row[1];
+	E.cx = col[1];
+}
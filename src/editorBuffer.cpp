@@ -0,0 +1,356 @@
+#include "editorBuffer.hpp"
+#include "editorBrackets.hpp"
+#include "editorCursor.hpp"
+#include "editorFold.hpp"
+#include "editorMem.hpp"
+#include "editorPager.hpp"
+#include "editorPane.hpp"
+#include "editorPlatform.hpp"
+#include "editorReload.hpp"
+#include "editorSelection.hpp"
+#include "editorStream.hpp"
+#include "editorSymbols.hpp"
+#include "editorWords.hpp"
+#include "editorWrap.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*** buffer list ***/
+
+// buffers[active] is stale while it is shown, E has the live copy
+static std::vector<editorBuffer> buffers;
+static int active = 0;
+// clean files closed recently, most recent first, kept with their text so reopening skips the disk
+static std::vector<editorBuffer> closed;
+static long long switches = 0;
+
+static editorBuffer emptyBuffer() {
+	editorBuffer b = {};
+	b.disk_mtime = -1;
+	b.disk_size = -1;
+	return b;
+}
+
+// the buffer E started out with gets its slot the first time the list is needed
+static void ensureList() {
+	if (buffers.empty()) {
+		buffers.push_back(emptyBuffer());
+		active = 0;
+	}
+}
+
+static void park(editorBuffer* b) {
+	static_cast<bufferState&>(*b) = E;
+	b->lastUsed = ++switches;
+}
+
+static void show(editorBuffer* b) {
+	static_cast<bufferState&>(E) = *b;
+	E.rx = 0;
+	E.wrapoff = 0;
+	E.match_row = -1;
+	// rows of a cold buffer rebuild their caches as they are drawn
+	b->cold = false;
+	editorPanesReset();
+	editorCursorsClear();
+	editorSelectionClear();
+
+	// only the shown file is watched, whatever happened while it was parked is caught up on here
+	if (E.filename && !E.readonly) {
+		watchFile(E.filename);
+		editorCheckDiskState();
+	} else {
+		unwatchFile();
+	}
+}
+
+static void freeRows(editorBuffer* b) {
+	for (int i = 0; i < b->numrows; i++)
+		editorFreeRow(&b->row[i]);
+	memFree(MEM_ROWS, b->row);
+	free(b->filename);
+	editorWordsFree(b->words);
+	b->words = NULL;
+	editorSymbolsFree(b->symbols);
+	b->symbols = NULL;
+	editorBracketsFree(b->brackets);
+	b->brackets = NULL;
+	editorFoldFree(b->folds);
+	b->folds = NULL;
+	editorWrapFree(b->wraps);
+	b->wraps = NULL;
+	b->row = NULL;
+	b->numrows = 0;
+	b->filename = NULL;
+}
+
+// keeps only the text of a buffer, render, spans and tab indexes go
+static void cool(editorBuffer* b) {
+	if (b->cold)
+		return;
+	for (int i = 0; i < b->numrows; i++)
+		editorRowDropCaches(&b->row[i]);
+	b->cold = true;
+}
+
+// over budget, the least recently shown buffers lose their caches first, then the closed files go
+static void trimCaches() {
+	while (editorMemCurrent(MEM_CATEGORIES) > BUFFER_CACHE_BUDGET) {
+		int victim = -1;
+		for (int i = 0; i < static_cast<int>(buffers.size()); i++) {
+			if (i == active || buffers[i].cold)
+				continue;
+			if (victim < 0 || buffers[i].lastUsed < buffers[victim].lastUsed)
+				victim = i;
+		}
+		if (victim >= 0) {
+			cool(&buffers[victim]);
+		} else if (!closed.empty()) {
+			freeRows(&closed.back());
+			closed.pop_back();
+		} else {
+			break;
+		}
+	}
+}
+
+// the pager window and the stdin reader write straight into E, so their buffer has to stay on screen
+static bool pinned() {
+	if (editorPagerActive()) {
+		editorSetStatusMessage("Close the paged file first (Ctrl-W)");
+		return true;
+	}
+	if (editorStreamActive()) {
+		editorSetStatusMessage("Still reading stdin, switch once it is loaded");
+		return true;
+	}
+	return false;
+}
+
+static const char* bufferName(int idx) {
+	return idx == active ? E.filename : buffers[idx].filename;
+}
+
+/*** switching ***/
+
+// Makes buffers[active] a new slot for a buffer about to be shown, returns true when that is the slot
+// of the empty buffer the editor starts with, which is replaced rather than kept next to the new one
+static bool addBuffer() {
+	bool reuse = E.filename == NULL && E.numrows == 0 && !E.dirty;
+	if (reuse) {
+		memFree(MEM_ROWS, E.row);
+		E.row = NULL;
+		editorWordsFree(E.words);
+		E.words = NULL;
+		editorSymbolsFree(E.symbols);
+		E.symbols = NULL;
+		editorBracketsFree(E.brackets);
+		E.brackets = NULL;
+		editorFoldFree(E.folds);
+		E.folds = NULL;
+		editorWrapFree(E.wraps);
+		E.wraps = NULL;
+	} else {
+		park(&buffers[active]);
+		buffers.push_back(emptyBuffer());
+		active = static_cast<int>(buffers.size()) - 1;
+	}
+	return reuse;
+}
+
+// takes a reopened file out of the closed list if the disk still has what it was closed with
+static bool reopenClosed(const char* filename, editorBuffer* b) {
+	for (size_t k = 0; k < closed.size(); k++) {
+		if (strcmp(closed[k].filename, filename) != 0)
+			continue;
+		*b = closed[k];
+		closed.erase(closed.begin() + k);
+		long long mtime, size;
+		if (editorStatFile(filename, &mtime, &size) == 0 && mtime == b->disk_mtime && size == b->disk_size)
+			return true;
+		freeRows(b);
+		return false;
+	}
+	return false;
+}
+
+// shows filename, switching to it when it is already open and loading it into a new buffer otherwise
+bool editorBufferOpen(const char* filename) {
+	ensureList();
+	for (int i = 0; i < static_cast<int>(buffers.size()); i++) {
+		const char* name = bufferName(i);
+		if (name && strcmp(name, filename) == 0)
+			return editorBufferSwitch(i);
+	}
+	if (pinned())
+		return false;
+
+	int from = active;
+	bool reuse = addBuffer();
+
+	editorBuffer cached;
+	if (reopenClosed(filename, &cached)) {
+		buffers[active] = cached;
+		show(&buffers[active]);
+		editorSetStatusMessage("Reopened %s from cache", filename);
+		trimCaches();
+		return true;
+	}
+
+	buffers[active] = emptyBuffer();
+	show(&buffers[active]);
+	bool opened = editorPagerWanted(filename) ? editorPagerOpen(filename) : editorOpen(filename);
+	if (!opened) {
+		editorPagerClose();
+		editorBuffer failed;
+		park(&failed);
+		freeRows(&failed);
+		if (!reuse)
+			buffers.pop_back();
+		active = from;
+		show(&buffers[active]);
+		editorSetStatusMessage("Can't open %s", filename);
+		return false;
+	}
+	trimCaches();
+	return true;
+}
+
+// shows the buffer called name, making it if there is none. It holds text the editor produced rather
+// than a file, so it is read-only and never saved, watched or reloaded
+bool editorBufferScratch(const char* name) {
+	ensureList();
+	for (int i = 0; i < static_cast<int>(buffers.size()); i++) {
+		const char* other = bufferName(i);
+		if (other && strcmp(other, name) == 0)
+			return editorBufferSwitch(i);
+	}
+	if (pinned())
+		return false;
+	addBuffer();
+	buffers[active] = emptyBuffer();
+	buffers[active].filename = strdup(name);
+	buffers[active].readonly = 1;
+	show(&buffers[active]);
+	trimCaches();
+	return true;
+}
+
+bool editorBufferSwitch(int idx) {
+	ensureList();
+	if (idx < 0 || idx >= static_cast<int>(buffers.size()))
+		return false;
+	if (idx == active)
+		return true;
+	if (pinned())
+		return false;
+	park(&buffers[active]);
+	active = idx;
+	show(&buffers[active]);
+	trimCaches();
+	return true;
+}
+
+// target is a 1-based buffer number or part of a file name
+bool editorBufferSwitchTo(const char* target) {
+	ensureList();
+	char* end;
+	long n = strtol(target, &end, 10);
+	if (end != target && *end == '\0')
+		return editorBufferSwitch(static_cast<int>(n) - 1);
+	for (int i = 0; i < static_cast<int>(buffers.size()); i++) {
+		const char* name = bufferName(i);
+		if (name && strstr(name, target))
+			return editorBufferSwitch(i);
+	}
+	return false;
+}
+
+void editorBufferNext() {
+	ensureList();
+	if (buffers.size() < 2) {
+		editorSetStatusMessage("No other buffers");
+		return;
+	}
+	editorBufferSwitch((active + 1) % static_cast<int>(buffers.size()));
+}
+
+// closes the active buffer and shows the one used before it, unsaved changes are dropped
+bool editorBufferClose() {
+	if (editorStreamActive()) {
+		editorSetStatusMessage("Still reading stdin, close once it is loaded");
+		return false;
+	}
+	ensureList();
+	editorPagerClose();
+
+	editorBuffer closing;
+	park(&closing);
+	closing.cold = false;
+	if (closing.filename && !closing.dirty && !closing.readonly) {
+		cool(&closing);
+		closed.insert(closed.begin(), closing);
+		if (static_cast<int>(closed.size()) > BUFFER_CLOSED_CACHE) {
+			freeRows(&closed.back());
+			closed.pop_back();
+		}
+	} else {
+		freeRows(&closing);
+	}
+
+	buffers.erase(buffers.begin() + active);
+	if (buffers.empty())
+		buffers.push_back(emptyBuffer());
+	active = 0;
+	for (int i = 1; i < static_cast<int>(buffers.size()); i++)
+		if (buffers[i].lastUsed > buffers[active].lastUsed)
+			active = i;
+	show(&buffers[active]);
+	trimCaches();
+	return true;
+}
+
+/*** status ***/
+
+int editorBufferCount() {
+	return buffers.empty() ? 1 : static_cast<int>(buffers.size());
+}
+
+// unsaved buffers, the shown one included
+int editorBufferDirtyCount() {
+	int dirty = E.dirty ? 1 : 0;
+	for (int i = 0; i < static_cast<int>(buffers.size()); i++)
+		if (i != active && buffers[i].dirty)
+			dirty++;
+	return dirty;
+}
+
+// one line per buffer for the panel, returns the length written
+int editorBufferList(char* buf, int len) {
+	ensureList();
+	int at = 0;
+	for (int i = 0; i < static_cast<int>(buffers.size()) && at < len; i++) {
+		const char* name = bufferName(i);
+		bool dirty = i == active ? E.dirty : buffers[i].dirty;
+		int numrows = i == active ? E.numrows : buffers[i].numrows;
+		at += snprintf(buf + at, len - at, "%c%3d  %s - %d lines%s%s\n", i == active ? '*' : ' ', i + 1,
+					   name ? name : "[No Name]", numrows, dirty ? " (modified)" : "",
+					   i != active && buffers[i].cold ? " (cold)" : "");
+	}
+	if (!closed.empty() && at < len)
+		at += snprintf(buf + at, len - at, "      %d closed file%s cached\n", static_cast<int>(closed.size()),
+					   closed.size() == 1 ? "" : "s");
+	return at < len ? at : len - 1;
+}
+
+// frees every buffer but the shown one, that one is still E's to free
+void editorBufferFreeAll() {
+	for (int i = 0; i < static_cast<int>(buffers.size()); i++)
+		if (i != active)
+			freeRows(&buffers[i]);
+	for (editorBuffer& b : closed)
+		freeRows(&b);
+	buffers.clear();
+	closed.clear();
+}
@@ -0,0 +1,473 @@
+#include "editorCursor.hpp"
+#include "editorFold.hpp"
+#include "editorMem.hpp"
+#include "editorSelection.hpp"
+#include "editorTrace.hpp"
+#include "editorUtf8.hpp"
+#include "editorWrap.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*** cursor list ***/
+
+// every cursor, the primary one included, by row and then column. Empty while there is only one
+static std::vector<editorCursor> cursors;
+// screen column that cursors added above and below go to, -1 until a column is being built
+static int columnRx = -1;
+
+bool editorCursorsActive() {
+	return cursors.size() > 1;
+}
+
+int editorCursorCount() {
+	return cursors.empty() ? 1 : static_cast<int>(cursors.size());
+}
+
+void editorCursorsClear() {
+	cursors.clear();
+	columnRx = -1;
+}
+
+static bool before(const editorCursor& a, const editorCursor& b) {
+	return a.cy != b.cy ? a.cy < b.cy : a.cx < b.cx;
+}
+
+// the list starts out with the cursor there already is
+static void ensureList() {
+	if (cursors.empty())
+		cursors.push_back({E.cx, E.cy, true});
+}
+
+// the primary cursor lives in E, the list picks up where it is now
+static void takePrimary() {
+	for (editorCursor& c : cursors)
+		if (c.primary) {
+			c.cx = E.cx;
+			c.cy = E.cy;
+		}
+}
+
+// keeps the cursors on the text and in order, merges those that ran into each other and hands the
+// primary back to E. Down to one cursor, the list goes away again
+static void settle() {
+	for (editorCursor& c : cursors) {
+		if (c.cy > E.numrows)
+			c.cy = E.numrows;
+		if (c.cy < 0)
+			c.cy = 0;
+		int size = c.cy < E.numrows ? E.row[c.cy].size : 0;
+		if (c.cx > size)
+			c.cx = size;
+		if (c.cx < 0)
+			c.cx = 0;
+	}
+	if (!std::is_sorted(cursors.begin(), cursors.end(), before))
+		std::sort(cursors.begin(), cursors.end(), before);
+	size_t out = 0;
+	for (size_t i = 0; i < cursors.size(); i++) {
+		if (out > 0 && cursors[out - 1].cx == cursors[i].cx && cursors[out - 1].cy == cursors[i].cy) {
+			cursors[out - 1].primary |= cursors[i].primary;
+			continue;
+		}
+		cursors[out++] = cursors[i];
+	}
+	cursors.resize(out);
+	for (const editorCursor& c : cursors)
+		if (c.primary) {
+			E.cx = c.cx;
+			E.cy = c.cy;
+		}
+	if (cursors.size() == 1)
+		cursors.clear();
+}
+
+// adds a cursor and makes it the primary one, so the view goes where it is
+static void addCursor(int cx, int cy) {
+	for (editorCursor& c : cursors)
+		c.primary = false;
+	editorCursor added = {cx, cy, true};
+	cursors.insert(std::upper_bound(cursors.begin(), cursors.end(), added, before), added);
+	settle();
+	editorSetStatusMessage("%d cursors", editorCursorCount());
+}
+
+/*** adding cursors ***/
+
+static inline bool separatorAt(const erow* row, int at) {
+	return at < 0 || at >= row->size || is_separator(static_cast<unsigned char>(row->chars[at]));
+}
+
+// first whole-word occurrence of word in row at or after from, -1 if there is none
+static int findWord(const erow* row, int from, const std::string& word) {
+	int len = static_cast<int>(word.size());
+	const char* p = row->chars + from;
+	const char* end = row->chars + row->size;
+	while (end - p >= len) {
+		p = static_cast<const char*>(memchr(p, word[0], end - p - len + 1));
+		if (p == nullptr)
+			return -1;
+		int at = static_cast<int>(p - row->chars);
+		if (memcmp(p, word.data(), len) == 0 && separatorAt(row, at - 1) && separatorAt(row, at + len))
+			return at;
+		p++;
+	}
+	return -1;
+}
+
+// puts a cursor on the next occurrence of the word the primary cursor is on, at the same place in
+// the word. The search wraps at the end of the file and passes over occurrences that have a cursor
+void editorCursorAddNextMatch() {
+	editorSelectionClear();
+	if (E.cy >= E.numrows) {
+		editorSetStatusMessage("No word under the cursor");
+		return;
+	}
+	const erow* row = &E.row[E.cy];
+	int start = E.cx, end = E.cx;
+	while (!separatorAt(row, start - 1))
+		start--;
+	while (!separatorAt(row, end))
+		end++;
+	if (start == end) {
+		editorSetStatusMessage("No word under the cursor");
+		return;
+	}
+	ensureList();
+	takePrimary();
+
+	std::string word(row->chars + start, end - start);
+	int offset = E.cx - start;
+	int cy = E.cy;
+	int from = end;
+	for (int i = 0; i <= E.numrows; i++) {
+		const erow* r = &E.row[cy];
+		int at;
+		while ((at = findWord(r, from, word)) >= 0) {
+			if (cy == E.cy && at == start) {
+				editorSetStatusMessage("Every \"%.30s\" has a cursor", word.c_str());
+				settle();
+				return;
+			}
+			editorCursor probe = {at + offset, cy, false};
+			if (!std::binary_search(cursors.begin(), cursors.end(), probe, before)) {
+				addCursor(at + offset, cy);
+				return;
+			}
+			from = at + static_cast<int>(word.size());
+		}
+		cy = cy + 1 < E.numrows ? cy + 1 : 0;
+		from = 0;
+	}
+	settle();
+}
+
+// adds a cursor on the row above the topmost or below the bottommost one, in the column the
+// primary cursor was in when the column was started, so dragging over short rows does not drift
+void editorCursorAddVertical(int dir) {
+	editorSelectionClear();
+	ensureList();
+	takePrimary();
+	if (columnRx < 0)
+		columnRx = E.cy < E.numrows ? editorRowCxToRx(&E.row[E.cy], E.cx) : 0;
+	int cy = dir < 0 ? cursors.front().cy - 1 : cursors.back().cy + 1;
+	if (cy < 0 || cy >= E.numrows) {
+		settle();
+		return;
+	}
+	erow* row = &E.row[cy];
+	int cx = editorRowRxToCx(row, columnRx);
+	if (cx < row->size)
+		cx = utf8PrevCluster(row->chars, row->size, cx + 1);
+	addCursor(cx, cy);
+}
+
+/*** editing ***/
+
+enum cursorEditKind {
+	EDIT_INSERT,
+	EDIT_NEWLINE,
+	EDIT_BACKSPACE,
+	EDIT_DELETE
+};
+
+// what a keystroke does at one cursor: bytes [from, to) of its row give way to the typed text
+struct cursorEdit {
+	int from;
+	int to;
+};
+
+// Edits that stay within their rows. All edits on a row are applied in one pass over its bytes
+// with a single realloc, then the row is rendered and highlighted once however many cursors it has.
+// A row with one cursor goes through editorRowChanged, so long rows only redo the chunks touched.
+static void editRows(const std::vector<cursorEdit>& edits, const char* text, int len) {
+	size_t n = cursors.size();
+	for (size_t i = 0; i < n;) {
+		int cy = cursors[i].cy;
+		int delta = 0;
+		size_t j = i;
+		for (; j < n && cursors[j].cy == cy; j++)
+			delta += len - (edits[j].to - edits[j].from);
+		erow* row = &E.row[cy];
+		if (len > 0) {
+			// the tail moves first, so every byte is moved before anything lands on it
+			row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + delta + 1));
+			int end = row->size + 1;
+			for (size_t c = j; c-- > i;) {
+				int at = edits[c].from;
+				int shift = static_cast<int>(c - i + 1) * len;
+				memmove(row->chars + at + shift, row->chars + at, end - at);
+				memcpy(row->chars + at + shift - len, text, len);
+				cursors[c].cx = at + shift;
+				end = at;
+			}
+		} else {
+			int write = edits[i].from;
+			for (size_t c = i; c < j; c++) {
+				int next = c + 1 < j ? edits[c + 1].from : row->size + 1;
+				cursors[c].cx = write;
+				memmove(row->chars + write, row->chars + edits[c].to, next - edits[c].to);
+				write += next - edits[c].to;
+			}
+		}
+		row->size += delta;
+		if (delta != 0) {
+			if (j - i == 1)
+				editorRowChanged(row, edits[i].from, delta);
+			else
+				editorUpdateRow(row);
+		}
+		i = j;
+	}
+	E.dirty++;
+}
+
+// Edits that split or join rows. The rows from the first cursor to the last are written out once
+// with the edits applied and put back with a single splice, rather than one row insert or delete
+// per cursor, each moving every row after it.
+static void editRange(const std::vector<cursorEdit>& edits, const std::vector<int>& joins, const char* text,
+					  int len) {
+	int a = cursors.front().cy;
+	int b = cursors.back().cy;
+	for (int r : joins) {
+		a = std::min(a, r);
+		b = std::max(b, r + 1);
+	}
+	std::vector<char> join(b - a + 1, 0);
+	for (int r : joins)
+		join[r - a] = 1;
+
+	size_t bytes = 0;
+	for (int r = a; r <= b; r++)
+		bytes += E.row[r].size;
+	std::string out;
+	out.reserve(bytes + cursors.size() * len);
+	std::vector<rowText> lines;
+	std::vector<size_t> starts;
+	size_t lineStart = 0;
+	auto endLine = [&](bool crlf) {
+		lines.push_back({nullptr, static_cast<int>(out.size() - lineStart), crlf});
+		starts.push_back(lineStart);
+		lineStart = out.size();
+	};
+
+	size_t c = 0;
+	for (int r = a; r <= b; r++) {
+		const erow* row = &E.row[r];
+		int pos = 0;
+		for (; c < cursors.size() && cursors[c].cy == r; c++) {
+			out.append(row->chars + pos, edits[c].from - pos);
+			for (int t = 0; t < len; t++) {
+				if (text[t] == '\n')
+					endLine(row->crlf);
+				else
+					out.push_back(text[t]);
+			}
+			cursors[c].cy = a + static_cast<int>(lines.size());
+			cursors[c].cx = static_cast<int>(out.size() - lineStart);
+			pos = edits[c].to;
+		}
+		out.append(row->chars + pos, row->size - pos);
+		// a joined row carries on into the next one, which then decides the line ending
+		if (!join[r - a])
+			endLine(row->crlf);
+	}
+	for (size_t i = 0; i < lines.size(); i++)
+		lines[i].s = out.data() + starts[i];
+	editorSpliceRows(a, b - a + 1, lines.data(), static_cast<int>(lines.size()));
+}
+
+static void editAll(int kind, const char* text, int len) {
+	TRACE_SCOPE("editorCursorsEdit");
+	bool inserting = kind == EDIT_INSERT || kind == EDIT_NEWLINE;
+	// typing below the last row starts a new one, as it does with a single cursor
+	if (inserting && cursors.back().cy >= E.numrows)
+		editorInsertRow(E.numrows, "", 0);
+	// deleting there only steps back onto the text, that cursor sits the edit out
+	bool below = !inserting && cursors.back().cy >= E.numrows;
+	editorCursor last = cursors.back();
+	if (below)
+		cursors.pop_back();
+
+	size_t n = cursors.size();
+	std::vector<cursorEdit> edits(n);
+	std::vector<int> joins;
+	for (size_t i = 0; i < n; i++) {
+		const editorCursor* c = &cursors[i];
+		const erow* row = &E.row[c->cy];
+		edits[i] = {c->cx, c->cx};
+		// neighbours on the same row bound the delete, so two edits never overlap
+		if (kind == EDIT_BACKSPACE) {
+			if (c->cx > 0) {
+				int from = utf8PrevCluster(row->chars, row->size, c->cx);
+				if (i > 0 && cursors[i - 1].cy == c->cy && from < cursors[i - 1].cx)
+					from = cursors[i - 1].cx;
+				edits[i].from = from;
+			} else if (c->cy > 0) {
+				joins.push_back(c->cy - 1);
+			}
+		} else if (kind == EDIT_DELETE) {
+			if (c->cx < row->size) {
+				int to = utf8NextCluster(row->chars, row->size, c->cx);
+				if (i + 1 < n && cursors[i + 1].cy == c->cy && to > cursors[i + 1].cx)
+					to = cursors[i + 1].cx;
+				edits[i].to = to;
+			} else if (c->cy + 1 < E.numrows) {
+				joins.push_back(c->cy);
+			}
+		}
+	}
+	if (n > 0) {
+		if (kind == EDIT_NEWLINE || !joins.empty())
+			editRange(edits, joins, text, len);
+		else
+			editRows(edits, text, len);
+	}
+
+	if (below) {
+		if (kind == EDIT_BACKSPACE && E.numrows > 0) {
+			last.cy = E.numrows - 1;
+			last.cx = E.row[last.cy].size;
+		}
+		cursors.push_back(last);
+	}
+}
+
+static void moveAll(int key) {
+	for (editorCursor& c : cursors) {
+		E.cx = c.cx;
+		E.cy = c.cy;
+		if (key == HOME_KEY)
+			E.cx = 0;
+		else if (key == END_KEY)
+			E.cx = E.cy < E.numrows ? E.row[E.cy].size : 0;
+		else
+			editorMoveCursor(key);
+		c.cx = E.cx;
+		c.cy = E.cy;
+	}
+}
+
+// runs a key at every cursor, returns false when the key is not one several cursors take part in.
+// Such a key leaves only the primary cursor and goes through the usual path
+bool editorCursorsKey(int c) {
+	if (!editorCursorsActive())
+		return false;
+	takePrimary();
+	switch (c) {
+	case CTRL_KEY('d'):
+		editorCursorAddNextMatch();
+		return true;
+	case ALT_ARROW_UP:
+	case ALT_ARROW_DOWN:
+		editorCursorAddVertical(c == ALT_ARROW_UP ? -1 : 1);
+		return true;
+	case '\x1b':
+		editorCursorsClear();
+		return true;
+	}
+
+	columnRx = -1;
+	switch (c) {
+	case ARROW_UP:
+	case ARROW_DOWN:
+	case ARROW_LEFT:
+	case ARROW_RIGHT:
+	case HOME_KEY:
+	case END_KEY:
+		moveAll(c);
+		break;
+	case '\r':
+	case '\n':
+		if (!editorRejectReadOnly())
+			editAll(EDIT_NEWLINE, "\n", 1);
+		break;
+	case BACKSPACE:
+	case CTRL_KEY('h'):
+		if (!editorRejectReadOnly())
+			editAll(EDIT_BACKSPACE, "", 0);
+		break;
+	case DEL_KEY:
+		if (!editorRejectReadOnly())
+			editAll(EDIT_DELETE, "", 0);
+		break;
+	default:
+		if (c == '\t' || (c >= 32 && c < 256 && c != 127)) {
+			if (!editorRejectReadOnly()) {
+				char ch = static_cast<char>(c);
+				editAll(EDIT_INSERT, &ch, 1);
+			}
+			break;
+		}
+		editorCursorsClear();
+		return false;
+	}
+	settle();
+	return true;
+}
+
+/*** drawing ***/
+
+// what is drawn inverted at a cursor on screen column col, the character under it or a space where
+// there is none to show
+static int cursorGlyph(const erow* row, int cx, int col, char* out, int size) {
+	out[0] = ' ';
+	if (cx >= row->size)
+		return 1;
+	int cp;
+	utf8Decode(row->chars + cx, row->size - cx, &cp);
+	int width = utf8Width(cp);
+	int n = utf8NextCluster(row->chars, row->size, cx) - cx;
+	if (cp < 0x20 || cp == 0x7f || (cp >= 0x80 && !utf8Printable(cp)) || width == 0 || n > size ||
+		col + width > E.viewcols)
+		return 1;
+	memcpy(out, row->chars + cx, n);
+	return n;
+}
+
+// the cursors other than the primary one, the terminal shows that one itself
+void editorCursorsDraw(struct abuf* ab) {
+	if (!editorCursorsActive() || E.panel)
+		return;
+	editorCursor top = {0, E.rowoff, false};
+	auto it = std::lower_bound(cursors.begin(), cursors.end(), top, before);
+	int topLine = editorWrapTop();
+	for (; it != cursors.end() && editorWrapLine(it->cy) < topLine + E.viewrows; ++it) {
+		if (it->primary || it->cy >= E.numrows || editorFoldHidden(it->cy))
+			continue;
+		erow* row = &E.row[it->cy];
+		int rx = editorRowCxToRx(row, it->cx);
+		int line = editorWrapLine(it->cy) + editorWrapSub(rx) - topLine;
+		int col = editorWrapColumn(rx);
+		if (line < 0 || line >= E.viewrows || col < 0 || col >= E.viewcols)
+			continue;
+		char glyph[16];
+		int len = cursorGlyph(row, it->cx, col, glyph, sizeof(glyph));
+		char buf[48];
+		int n = snprintf(buf, sizeof(buf), "\x1b[%d;%dH\x1b[7m", E.viewtop + line + 1, E.viewleft + col + 1);
+		abAppend(ab, buf, n);
+		abAppend(ab, glyph, len);
+		abAppend(ab, "\x1b[m", 3);
+	}
+}
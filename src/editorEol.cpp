@@ -0,0 +1,78 @@
+#include "editorEol.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EOL_SSE2 1
+#endif
+
+/*** line endings ***/
+
+#if defined(EOL_SSE2)
+static inline int bitCount(unsigned int mask) {
+#if defined(_MSC_VER)
+	return static_cast<int>(__popcnt(mask));
+#else
+	return __builtin_popcount(mask);
+#endif
+}
+#endif
+
+// Adds the line endings in s to counts, prev is the byte before s or 0 at the start of the text.
+// Files are read in blocks and every block passes through here once, 16 bytes a step on SSE2: a
+// '\n' is a CRLF when the '\r' mask shifted up by one has its bit set too.
+void eolCount(const char* s, int n, char prev, eolCounts* counts) {
+	long long lines = 0, crlf = 0;
+#if defined(EOL_SSE2)
+	int i = 0;
+	unsigned int cr = prev == '\r' ? 1 : 0;
+	__m128i nls = _mm_set1_epi8('\n');
+	__m128i crs = _mm_set1_epi8('\r');
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+		unsigned int lf = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nls)));
+		unsigned int r = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, crs)));
+		if (lf) {
+			lines += bitCount(lf);
+			crlf += bitCount(lf & ((r << 1) | cr));
+		}
+		cr = r >> 15;
+	}
+	for (; i < n; i++) {
+		if (s[i] == '\n') {
+			lines++;
+			crlf += cr;
+		}
+		cr = s[i] == '\r' ? 1 : 0;
+	}
+#else
+	// memchr is vectorized by the C library wherever it matters
+	const char* end = s + n;
+	const char* p = s;
+	while ((p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+		lines++;
+		if ((p > s ? p[-1] : prev) == '\r')
+			crlf++;
+		p++;
+	}
+#endif
+	counts->lines += lines;
+	counts->crlf += crlf;
+}
+
+int eolStyle(const eolCounts* counts) {
+	if (counts->crlf == 0)
+		return EOL_LF;
+	return counts->crlf == counts->lines ? EOL_CRLF : EOL_MIXED;
+}
+
+const char* eolName(int eol) {
+	switch (eol) {
+	case EOL_CRLF:
+		return "CRLF";
+	case EOL_MIXED:
+		return "mixed";
+	default:
+		return "LF";
+	}
+}
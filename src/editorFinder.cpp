@@ -0,0 +1,576 @@
+#include "editorFinder.hpp"
+#include "editorBuffer.hpp"
+#include "editorHeadless.hpp"
+#include "editorPlatform.hpp"
+#include "editorReload.hpp"
+#include "editorSearch.hpp"
+#include "editorTrace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*** index ***/
+
+// one directory as it was listed, the listing holds for as long as the directory keeps its mtime
+struct finderDir {
+	std::string path;
+	long long mtime;
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+};
+
+// The paths packed for the matcher: path i is text[start[i], start[i + 1]). mask has a bit for each
+// byte a path has, folded to lower case, and a query with a byte the path lacks is turned away on that
+// alone
+struct finderIndex {
+	int count;
+	std::vector<char> text;
+	std::vector<uint32_t> start;
+	std::vector<uint32_t> name; // where the file name starts, from the start of the path
+	std::vector<uint64_t> mask;
+};
+
+// What the walk hands to the main thread. The walk holds on to it too, so it can finish after the
+// editor is gone
+struct finderShared {
+	std::mutex lock;
+	std::shared_ptr<const finderIndex> index;
+	std::atomic<int> generation{0};
+	std::atomic<bool> walking{false};
+};
+
+static std::shared_ptr<finderShared> shared = std::make_shared<finderShared>();
+
+static inline char fold(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c;
+}
+
+static inline uint64_t maskBit(char c) {
+	return 1ULL << (static_cast<unsigned char>(c) & 63);
+}
+
+static void addPath(finderIndex* index, const std::string& path, size_t name) {
+	uint64_t mask = 0;
+	for (char c : path)
+		mask |= maskBit(fold(c));
+	index->text.insert(index->text.end(), path.begin(), path.end());
+	index->start.push_back(static_cast<uint32_t>(index->text.size()));
+	index->name.push_back(static_cast<uint32_t>(name));
+	index->mask.push_back(mask);
+	index->count++;
+}
+
+static std::shared_ptr<finderIndex> emptyIndex() {
+	std::shared_ptr<finderIndex> index = std::make_shared<finderIndex>();
+	index->count = 0;
+	index->start.push_back(0);
+	return index;
+}
+
+static std::shared_ptr<finderIndex> buildIndex(const std::vector<finderDir>& dirs) {
+	TRACE_SCOPE("finderBuildIndex");
+	std::shared_ptr<finderIndex> index = emptyIndex();
+	std::string path;
+	for (const finderDir& dir : dirs) {
+		for (const std::string& file : dir.files) {
+			path = dir.path == "." ? file : dir.path + "/" + file;
+			addPath(index.get(), path, path.size() - file.size());
+		}
+	}
+	return index;
+}
+
+// the matcher reads the last path in whole blocks too
+static void publish(finderShared* to, std::shared_ptr<finderIndex> index) {
+	index->text.resize(index->text.size() + SEARCH_SUBSEQUENCE_PAD, '\0');
+	std::lock_guard<std::mutex> guard(to->lock);
+	to->index = std::move(index);
+	to->generation++;
+}
+
+/*** cache ***/
+
+// one cache file per working directory, named after a hash of its path
+static bool cachePath(char* buf, int len) {
+	char cwd[4096];
+	if (!currentDirectory(cwd, sizeof(cwd)))
+		return false;
+	uint64_t h = 1469598103934665603ULL;
+	for (const char* p = cwd; *p; p++) {
+		h ^= static_cast<unsigned char>(*p);
+		h *= 1099511628211ULL;
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "files-%016llx", static_cast<unsigned long long>(h));
+	return cacheFilePath(name, buf, len);
+}
+
+// A line for each directory, "D<mtime> <path>", followed by a line for each of its entries, "f<name>"
+// for a file and "d<name>" for a directory. The directories are in walk order
+static void loadCache(const char* path, std::vector<finderDir>& dirs) {
+	long long size;
+	const char* data = mapFile(path, &size);
+	if (data == NULL)
+		return;
+	const char* end = data + size;
+	const char* p = data;
+	size_t header = strlen(FINDER_CACHE_FORMAT);
+	bool ok = size > static_cast<long long>(header) && memcmp(p, FINDER_CACHE_FORMAT, header) == 0 && p[header] == '\n';
+	p += header + 1;
+	while (ok && p < end) {
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (nl == NULL)
+			break;
+		if (*p == 'D') {
+			char* space;
+			long long mtime = strtoll(p + 1, &space, 10);
+			if (space >= nl || *space != ' ') {
+				ok = false;
+				break;
+			}
+			dirs.push_back({std::string(static_cast<const char*>(space) + 1, nl), mtime, {}, {}});
+		} else if ((*p == 'f' || *p == 'd') && !dirs.empty()) {
+			(*p == 'f' ? dirs.back().files : dirs.back().dirs).emplace_back(p + 1, nl);
+		} else {
+			ok = false;
+		}
+		p = nl + 1;
+	}
+	unmapFile(data, size);
+	// a cache that does not read back whole is walked again from scratch
+	if (!ok)
+		dirs.clear();
+}
+
+// written beside the cache and moved over it, a walk cut short never leaves half a cache behind
+static void saveCache(const char* path, const std::vector<finderDir>& dirs) {
+	std::string temp = std::string(path) + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == NULL)
+		return;
+	bool ok = fprintf(file, "%s\n", FINDER_CACHE_FORMAT) > 0;
+	for (const finderDir& dir : dirs) {
+		ok = ok && fprintf(file, "D%lld %s\n", dir.mtime, dir.path.c_str()) > 0;
+		for (const std::string& name : dir.files)
+			ok = ok && fprintf(file, "f%s\n", name.c_str()) > 0;
+		for (const std::string& name : dir.dirs)
+			ok = ok && fprintf(file, "d%s\n", name.c_str()) > 0;
+	}
+	if (fclose(file) != 0 || !ok || !replaceFile(temp.c_str(), path))
+		remove(temp.c_str());
+}
+
+/*** walk ***/
+
+static void listEntry(void* ctx, const char* name, bool isDir) {
+	finderDir* dir = static_cast<finderDir*>(ctx);
+	// hidden entries are left out the same as grep does, and a newline would break the cache lines
+	if (name[0] == '.' || strchr(name, '\n'))
+		return;
+	(isDir ? dir->dirs : dir->files).push_back(name);
+}
+
+// Only directories whose mtime moved since the cache was written are listed again, the rest keep their
+// cached listing. Adding, removing or renaming an entry changes the mtime of the directory it is in, so
+// a tree that did not change costs a stat per directory
+static void finderWalk(std::shared_ptr<finderShared> to) {
+	editorTraceThread("finder walk");
+	char cache[4096];
+	bool cached = cachePath(cache, sizeof(cache));
+	std::vector<finderDir> old;
+	if (cached)
+		loadCache(cache, old);
+	// what the last run saw is good enough to start matching against
+	if (!old.empty())
+		publish(to.get(), buildIndex(old));
+
+	std::unordered_map<std::string, finderDir*> known;
+	for (finderDir& dir : old)
+		known[dir.path] = &dir;
+	std::vector<finderDir> dirs;
+	std::vector<std::string> stack = {"."};
+	bool changed = old.empty();
+	while (!stack.empty()) {
+		std::string path = std::move(stack.back());
+		stack.pop_back();
+		long long mtime, size;
+		if (editorStatFile(path.c_str(), &mtime, &size) != 0) {
+			changed = true;
+			continue;
+		}
+		auto it = known.find(path);
+		if (it != known.end() && it->second->mtime == mtime) {
+			dirs.push_back(std::move(*it->second));
+			known.erase(it);
+		} else {
+			// the mtime was read first, a change during the listing shows up next time
+			finderDir dir = {path, mtime, {}, {}};
+			listDirectory(path.c_str(), listEntry, &dir);
+			std::sort(dir.files.begin(), dir.files.end());
+			std::sort(dir.dirs.begin(), dir.dirs.end());
+			dirs.push_back(std::move(dir));
+			changed = true;
+		}
+		const finderDir& dir = dirs.back();
+		for (auto sub = dir.dirs.rbegin(); sub != dir.dirs.rend(); ++sub)
+			stack.push_back(path == "." ? *sub : path + "/" + *sub);
+	}
+	// directories that are gone
+	if (!known.empty())
+		changed = true;
+
+	if (changed) {
+		publish(to.get(), buildIndex(dirs));
+		if (cached)
+			saveCache(cache, dirs);
+	}
+	to->walking = false;
+}
+
+// brings the index up to date in the background, a walk already under way is left to finish
+static void finderRefresh() {
+	if (shared->walking.exchange(true))
+		return;
+	std::thread(finderWalk, shared).detach();
+}
+
+/*** matching ***/
+
+struct finderMatch {
+	uint32_t path;
+	int score;
+	int len;
+};
+
+// a path that matches, end is just past the leftmost match
+struct finderHit {
+	uint32_t path;
+	uint32_t end;
+};
+
+// The paths that match the first len bytes of the query, each level narrows the one below it. The
+// leftmost match of a longer query starts out as the leftmost match of the shorter one, so a level
+// only looks for the bytes it adds, from where the level below left off
+struct finderLevel {
+	size_t len;
+	std::vector<finderHit> hits;
+};
+
+static std::shared_ptr<const finderIndex> current;
+static int indexGeneration = -1;
+static std::string folded;
+static std::vector<finderLevel> levels;
+static std::vector<finderMatch> matches;
+static int matched;
+
+enum finderClass { CLASS_OTHER, CLASS_SEPARATOR, CLASS_LOWER, CLASS_UPPER };
+
+struct finderClasses {
+	unsigned char of[256];
+};
+
+static constexpr finderClasses makeClasses() {
+	finderClasses t = {};
+	for (int c = 0; c < 256; c++) {
+		if (c == '/' || c == '\\' || c == '_' || c == '-' || c == '.' || c == ' ')
+			t.of[c] = CLASS_SEPARATOR;
+		else if (c >= 'a' && c <= 'z')
+			t.of[c] = CLASS_LOWER;
+		else if (c >= 'A' && c <= 'Z')
+			t.of[c] = CLASS_UPPER;
+	}
+	return t;
+}
+
+static constexpr finderClasses classes = makeClasses();
+
+// what a matched byte earns for the byte before it, by the class of each: a word starts after a
+// separator or where lower case steps up to upper case. Looked up rather than tested, the tests are a
+// coin toss for the branch predictor on every path
+static const int boundaryBonus[4][4] = {
+	{0, 0, 0, 0},
+	{10, 10, 10, 10},
+	{0, 0, 0, 8},
+	{0, 0, 0, 0},
+};
+
+// The leftmost match only proves there is one, and only where it ended is read from at[qlen - 1].
+// Walking back from there pulls the bytes as close together as they go, then each byte scores for
+// where it landed: after a separator or at a lower to upper case step, right after the byte before
+// it, inside the file name
+static int scoreMatch(const finderIndex* ix, uint32_t i, const char* q, int qlen, int* at) {
+	const char* text = &ix->text[ix->start[i]];
+	for (int k = qlen - 2; k >= 0; k--) {
+		int p = at[k + 1] - 1;
+		while (fold(text[p]) != q[k])
+			p--;
+		at[k] = p;
+	}
+	int name = static_cast<int>(ix->name[i]);
+	int score = 16 * qlen;
+	for (int k = 0; k < qlen; k++) {
+		int p = at[k];
+		int before = p > 0 ? classes.of[static_cast<unsigned char>(text[p - 1])] : static_cast<int>(CLASS_SEPARATOR);
+		score += boundaryBonus[before][classes.of[static_cast<unsigned char>(text[p])]];
+		score += p >= name ? 4 : 0;
+		if (k > 0) {
+			int gap = p - at[k - 1] - 1;
+			score += gap == 0 ? 6 : -std::min(gap, 8);
+		}
+	}
+	score += at[0] == name ? 8 : 0;
+	return score;
+}
+
+static bool betterMatch(const finderMatch& a, const finderMatch& b) {
+	if (a.score != b.score)
+		return a.score > b.score;
+	if (a.len != b.len)
+		return a.len < b.len;
+	return a.path < b.path;
+}
+
+// keeps m if it is among the best limit so far, best is in ranking order
+static void keepBest(std::vector<finderMatch>& best, int limit, const finderMatch& m) {
+	// most paths lose to the worst one kept on the first compare
+	if (static_cast<int>(best.size()) == limit && !betterMatch(m, best.back()))
+		return;
+	best.insert(std::upper_bound(best.begin(), best.end(), m, betterMatch), m);
+	if (static_cast<int>(best.size()) > limit)
+		best.pop_back();
+}
+
+// one query against one level, the same for every part it is split into
+struct finderScan {
+	const finderIndex* ix;
+	const finderLevel* below; // NULL to start from every path
+	bool again;				  // below is this query's own level, it only needs scoring
+	const char* q;
+	int qlen;
+	int done; // query bytes below already matched
+	uint64_t mask;
+	int limit;
+};
+
+// what a part of the scan found, hits in index order
+struct finderPart {
+	std::vector<finderHit> hits;
+	std::vector<finderMatch> best;
+};
+
+static void scanRange(const finderScan* scan, int from, int to, finderPart* part) {
+	const finderIndex* ix = scan->ix;
+	int qlen = scan->qlen;
+	std::vector<int> at(qlen);
+	if (!scan->again)
+		part->hits.reserve(to - from);
+	for (int j = from; j < to; j++) {
+		finderHit hit = scan->below ? scan->below->hits[j] : finderHit{static_cast<uint32_t>(j), 0};
+		uint32_t i = hit.path;
+		int len = static_cast<int>(ix->start[i + 1] - ix->start[i]);
+		if (scan->again) {
+			at[qlen - 1] = hit.end - 1;
+		} else {
+			if ((ix->mask[i] & scan->mask) != scan->mask)
+				continue;
+			const char* text = &ix->text[ix->start[i]];
+			int done = scan->done;
+			if (!searchSubsequence(text + hit.end, len - hit.end, scan->q + done, qlen - done, at.data() + done))
+				continue;
+			at[qlen - 1] += hit.end;
+			part->hits.push_back({i, static_cast<uint32_t>(at[qlen - 1] + 1)});
+		}
+		keepBest(part->best, scan->limit, {i, scoreMatch(ix, i, scan->q, qlen, at.data()), len});
+	}
+}
+
+// Ranks the index against query and keeps the best limit of them in matches, returns how many paths
+// match. A query that grows from the last one only looks at what the last one matched, and a scan
+// long enough to be worth it is split over the cores, a part each
+static int finderMatchQuery(const char* query, int limit) {
+	TRACE_SCOPE("finderMatch");
+	{
+		std::lock_guard<std::mutex> guard(shared->lock);
+		if (shared->generation != indexGeneration) {
+			current = shared->index;
+			indexGeneration = shared->generation;
+			levels.clear();
+			folded.clear();
+		}
+	}
+	matches.clear();
+	if (!current)
+		return matched = 0;
+
+	std::string q;
+	for (const char* p = query; *p; p++)
+		q.push_back(fold(*p));
+	size_t same = 0;
+	while (same < q.size() && same < folded.size() && q[same] == folded[same])
+		same++;
+	while (!levels.empty() && levels.back().len > same)
+		levels.pop_back();
+	folded = q;
+
+	const finderIndex* ix = current.get();
+	if (q.empty()) {
+		for (int i = 0; i < ix->count && i < limit; i++)
+			matches.push_back({static_cast<uint32_t>(i), 0, 0});
+		return matched = ix->count;
+	}
+	finderScan scan;
+	scan.ix = ix;
+	scan.below = levels.empty() ? NULL : &levels.back();
+	// back at a query already matched, as after a backspace
+	scan.again = scan.below && scan.below->len == q.size();
+	scan.q = q.data();
+	scan.qlen = static_cast<int>(q.size());
+	scan.done = scan.below ? static_cast<int>(scan.below->len) : 0;
+	scan.mask = 0;
+	for (char c : q)
+		scan.mask |= maskBit(c);
+	scan.limit = limit;
+	int n = scan.below ? static_cast<int>(scan.below->hits.size()) : ix->count;
+
+	static const int cores = static_cast<int>(std::thread::hardware_concurrency());
+	int parts = n >= FINDER_SPLIT_PATHS && cores > 1 ? std::min(cores, n / (FINDER_SPLIT_PATHS / 2)) : 1;
+	std::vector<finderPart> found(parts);
+	std::vector<std::thread> threads;
+	for (int k = 1; k < parts; k++)
+		threads.emplace_back(scanRange, &scan, static_cast<int>(1LL * n * k / parts),
+							 static_cast<int>(1LL * n * (k + 1) / parts), &found[k]);
+	scanRange(&scan, 0, n / parts, &found[0]);
+	for (std::thread& t : threads)
+		t.join();
+
+	for (const finderPart& part : found)
+		for (const finderMatch& m : part.best)
+			keepBest(matches, limit, m);
+	if (scan.again)
+		return matched = n;
+	finderLevel level;
+	level.len = q.size();
+	if (parts == 1) {
+		level.hits = std::move(found[0].hits);
+	} else {
+		size_t total = 0;
+		for (const finderPart& part : found)
+			total += part.hits.size();
+		level.hits.reserve(total);
+		for (const finderPart& part : found)
+			level.hits.insert(level.hits.end(), part.hits.begin(), part.hits.end());
+	}
+	matched = static_cast<int>(level.hits.size());
+	levels.push_back(std::move(level));
+	return matched;
+}
+
+/*** picker ***/
+
+static bool pickerOpen = false;
+static std::string pickerQuery;
+static int selected;
+static bool shownWalking;
+
+static std::string pathOf(const finderMatch& m) {
+	const finderIndex* ix = current.get();
+	return std::string(&ix->text[ix->start[m.path]], ix->start[m.path + 1] - ix->start[m.path]);
+}
+
+// the best matches go in the panel over the top rows, best first
+static void pickerShow() {
+	shownWalking = shared->walking;
+	char header[96];
+	snprintf(header, sizeof(header), "%d of %d files%s\n", matched, current ? current->count : 0,
+			 shownWalking ? ", indexing" : "");
+	std::string panel = header;
+	for (int k = 0; k < static_cast<int>(matches.size()); k++) {
+		panel += k == selected ? "> " : "  ";
+		panel += pathOf(matches[k]);
+		panel += "\n";
+	}
+	free(E.panel);
+	E.panel = strdup(panel.c_str());
+}
+
+static void pickerRun() {
+	// the header takes a row, the status and message bars two more
+	finderMatchQuery(pickerQuery.c_str(), E.screenrows - 3 > 1 ? E.screenrows - 3 : 1);
+	selected = 0;
+	pickerShow();
+}
+
+static void pickerCallback(char* query, int key) {
+	if (key == '\r' || key == '\n' || key == '\x1b' || key == CTRL_KEY('q'))
+		return;
+	if (key == ARROW_UP || key == ARROW_DOWN) {
+		if (key == ARROW_UP && selected > 0)
+			selected--;
+		else if (key == ARROW_DOWN && selected + 1 < static_cast<int>(matches.size()))
+			selected++;
+		pickerShow();
+		return;
+	}
+	pickerQuery = query;
+	pickerRun();
+}
+
+// Ctrl-P, a file under the working directory picked by a few of the letters in its path
+void editorFinderOpen() {
+	finderRefresh();
+	// a replayed script sees the whole tree, the same way every time
+	while (editorHeadlessActive() && shared->walking)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	pickerOpen = true;
+	pickerQuery.clear();
+	pickerRun();
+	char* picked = editorPrompt("Open file: %s (Use ESC/Arrows/Enter)", pickerCallback, PROMPT_ACCEPT_EMPTY);
+	pickerOpen = false;
+	free(E.panel);
+	E.panel = NULL;
+	if (picked) {
+		if (matches.empty())
+			editorSetStatusMessage("No file matches %s", picked);
+		else
+			editorBufferOpen(pathOf(matches[selected]).c_str());
+		free(picked);
+	}
+	// the index stays for next time, what matched this query does not
+	levels.clear();
+	folded.clear();
+	matches.clear();
+}
+
+// a walk that finished while the picker is up shows its files at once, returns true if the screen changed
+bool editorFinderIdle() {
+	if (!pickerOpen)
+		return false;
+	if (shared->generation == indexGeneration && shared->walking == shownWalking)
+		return false;
+	pickerRun();
+	return true;
+}
+
+/*** benchmarks ***/
+
+void editorFinderUsePaths(const std::vector<std::string>& paths) {
+	std::shared_ptr<finderIndex> ix = emptyIndex();
+	for (const std::string& path : paths) {
+		size_t slash = path.rfind('/');
+		addPath(ix.get(), path, slash == std::string::npos ? 0 : slash + 1);
+	}
+	publish(shared.get(), ix);
+}
+
+int editorFinderSearch(const char* query) {
+	return finderMatchQuery(query, 32);
+}
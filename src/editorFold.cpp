@@ -0,0 +1,250 @@
+#include "editorFold.hpp"
+#include "editorBrackets.hpp"
+#include "editorPager.hpp"
+#include "editorWrap.hpp"
+#include <algorithm>
+#include <vector>
+
+/*** fold list ***/
+
+// rows start + 1 to end are hidden, start stays on screen with a note of how many
+struct foldRange {
+	int start;
+	int end;
+};
+
+// Folds of a buffer by row, never overlapping, with the rows hidden in front of each one so a row and
+// its line convert with a binary search. Folding a block that holds folds takes them in.
+struct foldIndex {
+	std::vector<foldRange> list;
+	std::vector<int> hidden; // rows hidden by the folds before each one, one more entry than list
+};
+
+void editorFoldFree(foldIndex* ix) {
+	delete ix;
+}
+
+static bool none(const foldIndex* ix) {
+	return ix == NULL || ix->list.empty();
+}
+
+static void count(foldIndex* ix) {
+	ix->hidden.resize(ix->list.size() + 1);
+	ix->hidden[0] = 0;
+	for (size_t i = 0; i < ix->list.size(); i++)
+		ix->hidden[i + 1] = ix->hidden[i] + ix->list[i].end - ix->list[i].start;
+}
+
+// the last fold starting above row, -1 for none
+static int above(const foldIndex* ix, int row) {
+	auto it = std::lower_bound(ix->list.begin(), ix->list.end(), row,
+							   [](const foldRange& f, int r) { return f.start < r; });
+	return static_cast<int>(it - ix->list.begin()) - 1;
+}
+
+// the line row is on, a hidden row is on the line of its fold
+int editorFoldLine(int row) {
+	const foldIndex* ix = E.folds;
+	if (none(ix))
+		return row;
+	int i = above(ix, row);
+	if (i >= 0 && row <= ix->list[i].end)
+		return ix->list[i].start - ix->hidden[i];
+	return row - ix->hidden[i + 1];
+}
+
+int editorFoldRow(int line) {
+	const foldIndex* ix = E.folds;
+	if (none(ix))
+		return line;
+	// folds whose first row is on a line above this one, the rows they hide come before it
+	int lo = 0;
+	int hi = static_cast<int>(ix->list.size());
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (ix->list[mid].start - ix->hidden[mid] < line)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return line + ix->hidden[lo];
+}
+
+bool editorFoldHidden(int row) {
+	const foldIndex* ix = E.folds;
+	if (none(ix))
+		return false;
+	int i = above(ix, row);
+	return i >= 0 && row <= ix->list[i].end;
+}
+
+// the row on the line below row's
+int editorFoldNext(int row) {
+	const foldIndex* ix = E.folds;
+	if (none(ix))
+		return row + 1;
+	int i = above(ix, row + 1);
+	if (i >= 0 && row <= ix->list[i].end)
+		return ix->list[i].end + 1;
+	return row + 1;
+}
+
+// the row on the line above row's
+int editorFoldPrev(int row) {
+	const foldIndex* ix = E.folds;
+	if (none(ix) || row <= 0)
+		return row - 1;
+	int i = above(ix, row - 1);
+	if (i >= 0 && row - 1 <= ix->list[i].end)
+		return ix->list[i].start;
+	return row - 1;
+}
+
+// the last row a fold starting at row hides, row itself when none does
+int editorFoldEnd(int row) {
+	const foldIndex* ix = E.folds;
+	if (none(ix))
+		return row;
+	int i = above(ix, row + 1);
+	return i >= 0 && ix->list[i].start == row ? ix->list[i].end : row;
+}
+
+// opens the fold hiding row, a jump or a search that lands there shows what it found
+void editorFoldReveal(int row) {
+	foldIndex* ix = E.folds;
+	if (none(ix))
+		return;
+	int i = above(ix, row);
+	if (i < 0 || row > ix->list[i].end)
+		return;
+	editorWrapFoldsChanged(ix->list[i].start);
+	ix->list.erase(ix->list.begin() + i);
+	count(ix);
+}
+
+// Rows [at, at + del) were replaced by ins others. A fold they land in or take rows from opens, the
+// ones below move along.
+void editorFoldRowsMoved(int at, int del, int ins) {
+	foldIndex* ix = E.folds;
+	if (none(ix))
+		return;
+	size_t out = 0;
+	for (size_t i = 0; i < ix->list.size(); i++) {
+		foldRange f = ix->list[i];
+		if (f.end < at) {
+			ix->list[out++] = f;
+		} else if (f.start >= at + del) {
+			f.start += ins - del;
+			f.end += ins - del;
+			ix->list[out++] = f;
+		} else {
+			editorWrapFoldsChanged(f.start);
+		}
+	}
+	// moving keeps what each fold hides, only opening one changes the counts
+	if (out == ix->list.size())
+		return;
+	ix->list.resize(out);
+	count(ix);
+}
+
+/*** folding ***/
+
+struct commentScan {
+	bool comment;
+	bool code;
+};
+
+static commentScan scanned;
+
+static void scanComment(const erow* row, int from, int to, const unsigned char* cls) {
+	for (int i = from; i < to; i++) {
+		if (row->chars[i] == ' ' || row->chars[i] == '\t')
+			continue;
+		if (cls[i - from] == HL_COMMENT || cls[i - from] == HL_MLCOMMENT)
+			scanned.comment = true;
+		else
+			scanned.code = true;
+	}
+}
+
+// nothing but comment on the row. Rows inside a block comment are known from the flags alone
+static bool commentRow(int row) {
+	if (row < 0 || row >= E.numrows)
+		return false;
+	if (row > 0 && E.row[row - 1].hl_open_comment && E.row[row].hl_open_comment)
+		return true;
+	scanned = {false, false};
+	editorRowClasses(&E.row[row], scanComment);
+	return scanned.comment && !scanned.code;
+}
+
+// the comment lines around row, or the brace block it opens or sits in
+static bool foldAt(int row, int* first, int* last) {
+	if (commentRow(row)) {
+		*first = row;
+		*last = row;
+		while (commentRow(*first - 1))
+			(*first)--;
+		while (commentRow(*last + 1))
+			(*last)++;
+		if (*last > *first)
+			return true;
+	}
+	return editorBracketsBlock(row, first, last);
+}
+
+static void addFold(int first, int last) {
+	foldIndex* ix = E.folds;
+	if (ix == NULL)
+		ix = E.folds = new foldIndex();
+	// folds inside the block go into it
+	auto from = std::lower_bound(ix->list.begin(), ix->list.end(), first,
+								 [](const foldRange& f, int r) { return f.end < r; });
+	auto to = from;
+	while (to != ix->list.end() && to->start <= last) {
+		if (to->start < first)
+			first = to->start;
+		if (to->end > last)
+			last = to->end;
+		++to;
+	}
+	from = ix->list.erase(from, to);
+	ix->list.insert(from, foldRange{first, last});
+	count(ix);
+	editorWrapFoldsChanged(first);
+}
+
+// Ctrl-Y, folds the block at the cursor or opens the fold it is on
+void editorFoldToggle() {
+	if (editorPagerActive()) {
+		editorSetStatusMessage("Folding is off in the pager");
+		return;
+	}
+	if (E.cy >= E.numrows)
+		return;
+	if (editorFoldEnd(E.cy) > E.cy) {
+		editorFoldReveal(E.cy + 1);
+		return;
+	}
+	int first, last;
+	if (!foldAt(E.cy, &first, &last)) {
+		editorSetStatusMessage("Nothing to fold here");
+		return;
+	}
+	addFold(first, last);
+	// the cursor goes to the line left showing
+	if (E.cy != first) {
+		E.cy = first;
+		E.cx = 0;
+	}
+}
+
+void editorFoldOpenAll() {
+	foldIndex* ix = E.folds;
+	if (none(ix))
+		return;
+	editorWrapFoldsChanged(ix->list.front().start);
+	ix->list.clear();
+	count(ix);
+}
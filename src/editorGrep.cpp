@@ -0,0 +1,314 @@
+#include "editorGrep.hpp"
+#include "editorBuffer.hpp"
+#include "editorEol.hpp"
+#include "editorHeadless.hpp"
+#include "editorPager.hpp"
+#include "editorPlatform.hpp"
+#include "editorSearch.hpp"
+#include "editorTrace.hpp"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*** work ***/
+
+// a directory to list or a file to search
+struct grepTask {
+	std::string path;
+	bool dir;
+};
+
+// Each worker takes from the back of its own queue, and steals from the front of the others once it
+// runs dry. What a directory lists goes onto the queue of whoever listed it, so the walk spreads out
+// over the workers on its own as they steal.
+struct grepQueue {
+	std::mutex lock;
+	std::deque<grepTask> tasks;
+};
+
+// a matching line, text is what its row in the results buffer shows
+struct grepResult {
+	std::string text;
+	std::string path;
+	int line;
+	int col;
+};
+
+// One search. The workers hold on to it too, so a search that is replaced finishes winding down on
+// its own without anyone waiting for it
+struct grepJob {
+	std::string pattern;
+	std::vector<std::unique_ptr<grepQueue>> queues;
+	std::atomic<long long> queued{0}; // tasks pushed and not done yet, the search is over at zero
+	std::atomic<int> running{0};
+	std::atomic<bool> cancel{false};
+	std::atomic<long long> files{0};
+	std::atomic<long long> found{0};
+	std::mutex resultLock;
+	std::deque<grepResult> results; // waiting for the main thread
+};
+
+static void pushTask(grepJob* job, int self, std::string path, bool dir) {
+	job->queued++;
+	grepQueue* q = job->queues[self].get();
+	std::lock_guard<std::mutex> guard(q->lock);
+	q->tasks.push_back({std::move(path), dir});
+}
+
+static bool takeTask(grepJob* job, int self, grepTask* task) {
+	int n = static_cast<int>(job->queues.size());
+	for (int k = 0; k < n; k++) {
+		grepQueue* q = job->queues[(self + k) % n].get();
+		std::lock_guard<std::mutex> guard(q->lock);
+		if (q->tasks.empty())
+			continue;
+		if (k == 0) {
+			*task = std::move(q->tasks.back());
+			q->tasks.pop_back();
+		} else {
+			*task = std::move(q->tasks.front());
+			q->tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+/*** searching ***/
+
+static long long countLines(const char* from, const char* to) {
+	eolCounts counts = {0, 0};
+	while (from < to) {
+		int n = to - from < INT_MAX ? static_cast<int>(to - from) : INT_MAX;
+		eolCount(from, n, 0, &counts);
+		from += n;
+	}
+	return counts.lines;
+}
+
+static void addResult(grepJob* job, std::vector<grepResult>& out, const std::string& path, long long line,
+					  const char* start, const char* end, const char* match) {
+	int len = static_cast<int>(end - start);
+	if (len > 0 && start[len - 1] == '\r')
+		len--;
+	// a cut never leaves half a character behind
+	if (len > GREP_LINE_MAX) {
+		len = GREP_LINE_MAX;
+		while (len > 0 && (static_cast<unsigned char>(start[len]) & 0xC0) == 0x80)
+			len--;
+	}
+	grepResult r;
+	r.text = path + ":" + std::to_string(line) + ": ";
+	r.text.append(start, len);
+	r.path = path;
+	r.line = static_cast<int>(line);
+	r.col = static_cast<int>(match - start);
+	out.push_back(std::move(r));
+	if (job->found.fetch_add(1) + 1 >= GREP_MAX_RESULTS)
+		job->cancel = true;
+}
+
+// one result per matching line, in file order
+static void searchFile(grepJob* job, const std::string& path) {
+	TRACE_SCOPE("grepSearchFile");
+	long long size;
+	const char* data = mapFile(path.c_str(), &size);
+	if (data == NULL)
+		return;
+	if (memchr(data, '\0', size < GREP_BINARY_PROBE ? size : GREP_BINARY_PROBE)) {
+		unmapFile(data, size);
+		return;
+	}
+	job->files++;
+
+	std::vector<grepResult> out;
+	const std::string& pattern = job->pattern;
+	const char* end = data + size;
+	const char* p = data;
+	long long line = 1;
+	while (p < end && !job->cancel) {
+		const char* match = searchFind(p, end - p, pattern.data(), pattern.size());
+		if (match == NULL)
+			break;
+		// p is always at the start of a line, so the lines in between are whole
+		const char* start = match;
+		while (start > p && start[-1] != '\n')
+			start--;
+		line += countLines(p, start);
+		const char* nl = static_cast<const char*>(memchr(match, '\n', end - match));
+		const char* lineEnd = nl ? nl : end;
+		addResult(job, out, path, line, start, lineEnd, match);
+		if (nl == NULL)
+			break;
+		p = nl + 1;
+		line++;
+	}
+	unmapFile(data, size);
+	if (out.empty())
+		return;
+	std::lock_guard<std::mutex> guard(job->resultLock);
+	for (grepResult& r : out)
+		job->results.push_back(std::move(r));
+}
+
+struct walkContext {
+	grepJob* job;
+	int self;
+	const std::string* dir;
+};
+
+// hidden entries are left out, .git and the like are not what anyone greps for
+static void walkEntry(void* ctx, const char* name, bool isDir) {
+	walkContext* walk = static_cast<walkContext*>(ctx);
+	if (name[0] == '.')
+		return;
+	std::string path = *walk->dir == "." ? std::string(name) : *walk->dir + "/" + name;
+	pushTask(walk->job, walk->self, std::move(path), isDir);
+}
+
+static void grepWorker(std::shared_ptr<grepJob> job, int self) {
+	editorTraceThread("grep worker");
+	grepTask task;
+	while (!job->cancel) {
+		if (!takeTask(job.get(), self, &task)) {
+			if (job->queued == 0)
+				break;
+			// the others are still busy and may list more
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+		if (task.dir) {
+			walkContext walk = {job.get(), self, &task.path};
+			// what was asked for may be a file
+			if (!listDirectory(task.path.c_str(), walkEntry, &walk))
+				searchFile(job.get(), task.path);
+		} else {
+			searchFile(job.get(), task.path);
+		}
+		job->queued--;
+	}
+	job->running--;
+}
+
+/*** results buffer ***/
+
+// where each row of the results buffer points
+struct grepHit {
+	std::string path;
+	int line;
+	int col;
+};
+
+static std::shared_ptr<grepJob> job;
+static std::vector<grepHit> hits;
+
+static bool resultsShown() {
+	return E.filename && strcmp(E.filename, GREP_BUFFER_NAME) == 0;
+}
+
+// searches every file under dir for pattern, the results buffer is shown and fills in as they come
+bool editorGrepStart(const char* pattern, const char* dir) {
+	if (job)
+		job->cancel = true;
+	job.reset();
+	if (!editorBufferScratch(GREP_BUFFER_NAME))
+		return false;
+	if (E.numrows > 0)
+		editorSpliceRows(0, E.numrows, NULL, 0);
+	E.dirty = 0;
+	E.cx = E.cy = E.rowoff = E.coloff = 0;
+	hits.clear();
+
+	// a core is left to the keyboard and the screen
+	int threads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+	if (threads < 1)
+		threads = 1;
+	job = std::make_shared<grepJob>();
+	job->pattern = pattern;
+	for (int i = 0; i < threads; i++)
+		job->queues.push_back(std::unique_ptr<grepQueue>(new grepQueue));
+	pushTask(job.get(), 0, dir, true);
+	job->running = threads;
+	for (int i = 0; i < threads; i++)
+		std::thread(grepWorker, job, i).detach();
+	editorSetStatusMessage("grep: searching %s for \"%s\"", dir, pattern);
+	return true;
+}
+
+// Moves found lines into the results buffer while it is shown, returns true if the screen changed.
+// A search still running shows its progress in the status bar.
+bool editorGrepDrain() {
+	if (!job || !resultsShown())
+		return false;
+	TRACE_SCOPE("editorGrepDrain");
+	// a replayed script sees the search whole, the same way every time
+	while (editorHeadlessActive() && job->running > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	auto start = std::chrono::steady_clock::now();
+	bool added = false;
+	std::vector<grepResult> batch;
+	std::vector<rowText> lines;
+	while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(GREP_DRAIN_BUDGET_MS)) {
+		batch.clear();
+		{
+			std::lock_guard<std::mutex> guard(job->resultLock);
+			while (!job->results.empty() && batch.size() < GREP_DRAIN_BATCH) {
+				batch.push_back(std::move(job->results.front()));
+				job->results.pop_front();
+			}
+		}
+		if (batch.empty())
+			break;
+		lines.clear();
+		for (const grepResult& r : batch) {
+			lines.push_back({r.text.data(), static_cast<int>(r.text.size()), false});
+			hits.push_back({r.path, r.line, r.col});
+		}
+		// results are not an edit
+		int dirty = E.dirty;
+		editorSpliceRows(E.numrows, 0, lines.data(), static_cast<int>(lines.size()));
+		E.dirty = dirty;
+		added = true;
+	}
+
+	bool done = false;
+	if (job->running == 0) {
+		std::lock_guard<std::mutex> guard(job->resultLock);
+		done = job->results.empty();
+	}
+	if (added || done) {
+		long long files = job->files;
+		editorSetStatusMessage("grep \"%s\": %d line%s in %lld files%s", job->pattern.c_str(),
+							   static_cast<int>(hits.size()), hits.size() == 1 ? "" : "s", files,
+							   !done ? ", searching" : job->found >= GREP_MAX_RESULTS ? ", stopped at the limit" : "");
+	}
+	if (done)
+		job.reset();
+	return added || done;
+}
+
+// Enter on a row of the results buffer opens the file at that line, returns false in other buffers
+bool editorGrepJump() {
+	if (!resultsShown())
+		return false;
+	if (E.cy >= static_cast<int>(hits.size()))
+		return true;
+	grepHit hit = hits[E.cy];
+	if (!editorBufferOpen(hit.path.c_str()))
+		return true;
+	if (editorPagerActive()) {
+		editorPagerGoto(std::to_string(hit.line).c_str());
+		return true;
+	}
+	E.cy = hit.line - 1 < E.numrows ? hit.line - 1 : E.numrows;
+	E.cx = E.cy < E.numrows && hit.col <= E.row[E.cy].size ? hit.col : 0;
+	return true;
+}
@@ -0,0 +1,381 @@
+#include "editorHeadless.hpp"
+#include "editorHud.hpp"
+#include "editorUtf8.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*** key names ***/
+
+// Scripts are text, one or more keys per line. Printable characters stand for themselves,
+// everything else is written as <NAME>. Lines starting with # are comments.
+struct keyName {
+	int key;
+	const char* name;
+};
+
+static const keyName keyNames[] = {
+	{'\r', "CR"},		  {'\n', "LF"},		   {'\t', "TAB"},		{ESC, "ESC"},		 {BACKSPACE, "BS"},
+	{'<', "LT"},		  {ARROW_UP, "UP"},	   {ARROW_DOWN, "DOWN"}, {ARROW_LEFT, "LEFT"}, {ARROW_RIGHT, "RIGHT"},
+	{HOME_KEY, "HOME"},	  {END_KEY, "END"},	   {PAGE_UP, "PGUP"},	{PAGE_DOWN, "PGDN"}, {DEL_KEY, "DEL"},
+	{'#', "HASH"},		  {ALT_ARROW_UP, "A-UP"}, {ALT_ARROW_DOWN, "A-DOWN"}, {CTRL_KEY(' '), "C-SPACE"},
+	{SHIFT_ARROW_UP, "S-UP"}, {SHIFT_ARROW_DOWN, "S-DOWN"}, {SHIFT_ARROW_LEFT, "S-LEFT"}, {SHIFT_ARROW_RIGHT, "S-RIGHT"},
+	{SHIFT_HOME, "S-HOME"}, {SHIFT_END, "S-END"},
+};
+
+// the idle tick, so a script can let streaming and reloads catch up at a point of its choosing
+#define KEY_IDLE (-2)
+
+static std::string nameOfKey(int key) {
+	for (const keyName& k : keyNames)
+		if (k.key == key)
+			return std::string("<") + k.name + ">";
+	if (key == KEY_IDLE)
+		return "<IDLE>";
+	if (key >= 1 && key <= 26)
+		return std::string("<C-") + static_cast<char>('A' + key - 1) + ">";
+	if (key >= 32 && key < 127)
+		return std::string(1, static_cast<char>(key));
+	return "<K-" + std::to_string(key) + ">";
+}
+
+// parses the name between < and >, returns -1 if it is not one
+static int keyOfName(const std::string& name) {
+	for (const keyName& k : keyNames)
+		if (name == k.name)
+			return k.key;
+	if (name == "IDLE")
+		return KEY_IDLE;
+	if (name.size() == 3 && name[0] == 'C' && name[1] == '-' && name[2] >= 'A' && name[2] <= 'Z')
+		return CTRL_KEY(name[2]);
+	if (name.size() > 2 && name[0] == 'K' && name[1] == '-')
+		return atoi(name.c_str() + 2);
+	return -1;
+}
+
+/*** script ***/
+
+static bool headless = false;
+static int screenRows = HEADLESS_DEFAULT_ROWS;
+static int screenCols = HEADLESS_DEFAULT_COLS;
+static std::vector<int> script;
+static size_t next = 0;
+static int quitKeys = 0;
+
+static bool parseScript(const char* path) {
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+	std::string line;
+	while (getline(file, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty() && line[0] == '#')
+			continue;
+		for (size_t i = 0; i < line.size(); i++) {
+			if (line[i] == '<') {
+				size_t end = line.find('>', i);
+				if (end != std::string::npos) {
+					int key = keyOfName(line.substr(i + 1, end - i - 1));
+					if (key != -1) {
+						script.push_back(key);
+						i = end;
+						continue;
+					}
+				}
+			}
+			script.push_back(static_cast<unsigned char>(line[i]));
+		}
+	}
+	return true;
+}
+
+/*** screen ***/
+
+// What a terminal would show after the last refresh, enough of VT100 for the escapes the editor writes.
+// A cell holds one character as UTF-8 with any marks on it, the cell right of a wide one is left empty
+static std::vector<std::vector<std::string>> screen;
+static int cursorRow = 0;
+static int cursorCol = 0;
+
+static void screenPut(const char* s, int len) {
+	int cp;
+	utf8Decode(s, len, &cp);
+	int width = utf8Width(cp);
+	if (cursorRow >= screenRows) {
+		cursorCol += width;
+		return;
+	}
+	std::vector<std::string>& line = screen[cursorRow];
+	if (width == 0) {
+		if (cursorCol > 0 && cursorCol <= screenCols)
+			line[cursorCol - 1].append(s, len);
+		return;
+	}
+	if (cursorCol < screenCols) {
+		line[cursorCol].assign(s, len);
+		if (width == 2 && cursorCol + 1 < screenCols)
+			line[cursorCol + 1].clear();
+	}
+	cursorCol += width;
+}
+
+static void screenClear(std::vector<std::string>& line, int from) {
+	for (int col = from; col < screenCols; col++)
+		line[col] = " ";
+}
+
+static std::string screenText(int y) {
+	std::string text;
+	for (const std::string& cell : screen[y])
+		text += cell;
+	return text;
+}
+
+static void screenEscape(const char* params, int len, char final) {
+	int args[2] = {0, 0};
+	int nargs = 0;
+	for (int i = 0; i < len && nargs < 2; i++) {
+		if (params[i] >= '0' && params[i] <= '9')
+			args[nargs] = args[nargs] * 10 + (params[i] - '0');
+		else if (params[i] == ';')
+			nargs++;
+	}
+	switch (final) {
+	case 'H':
+		cursorRow = args[0] > 0 ? args[0] - 1 : 0;
+		cursorCol = args[1] > 0 ? args[1] - 1 : 0;
+		break;
+	case 'K':
+		if (cursorRow < screenRows && cursorCol < screenCols)
+			screenClear(screen[cursorRow], cursorCol);
+		break;
+	case 'J':
+		for (std::vector<std::string>& line : screen)
+			screenClear(line, 0);
+		break;
+	}
+	// colors, cursor visibility and anything else do not change the text
+}
+
+static void screenFeed(const char* s, int len) {
+	for (int i = 0; i < len; i++) {
+		char c = s[i];
+		if (c == '\x1b' && i + 1 < len && s[i + 1] == '[') {
+			int start = i + 2;
+			int j = start;
+			while (j < len && !(s[j] >= 0x40 && s[j] <= 0x7e))
+				j++;
+			if (j < len)
+				screenEscape(&s[start], j - start, s[j]);
+			i = j;
+		} else if (c == '\r') {
+			cursorCol = 0;
+		} else if (c == '\n') {
+			cursorRow++;
+		} else {
+			// a frame is fed whole, so a character never arrives split
+			int cp;
+			int n = utf8Decode(&s[i], len - i, &cp);
+			screenPut(&s[i], n);
+			i += n - 1;
+		}
+	}
+}
+
+const char* editorHeadlessScreenLine(int y) {
+	static std::string text;
+	if (y < 0 || y >= screenRows)
+		return NULL;
+	text = screenText(y);
+	return text.c_str();
+}
+
+/*** timing ***/
+
+using clockType = std::chrono::steady_clock;
+
+struct keySample {
+	int key;
+	long long keyNs;  // from the key being handed out until the next one is asked for
+	long long drawNs; // the part of that spent refreshing the screen
+};
+
+static std::vector<keySample> samples;
+static int currentKey = 0;
+static bool keyInFlight = false;
+static clockType::time_point keyStart;
+static clockType::time_point replayStart;
+static long long drawNs = 0;
+
+static long long nsSince(clockType::time_point start) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(clockType::now() - start).count();
+}
+
+static void finishKey() {
+	if (!keyInFlight)
+		return;
+	samples.push_back({currentKey, nsSince(keyStart), drawNs});
+	keyInFlight = false;
+}
+
+static void startKey(int key) {
+	currentKey = key;
+	keyInFlight = true;
+	drawNs = 0;
+	keyStart = clockType::now();
+}
+
+/*** backend ***/
+
+bool editorHeadlessStart(const char* path, int rows, int cols) {
+	if (!parseScript(path))
+		return false;
+	headless = true;
+	screenRows = rows > 2 ? rows : HEADLESS_DEFAULT_ROWS;
+	screenCols = cols > 0 ? cols : HEADLESS_DEFAULT_COLS;
+	screen.assign(screenRows, std::vector<std::string>(screenCols, " "));
+	replayStart = clockType::now();
+	return true;
+}
+
+bool editorHeadlessActive() {
+	return headless;
+}
+
+int editorHeadlessReadKey() {
+	finishKey();
+	while (next < script.size() && script[next] == KEY_IDLE) {
+		next++;
+		startKey(KEY_IDLE);
+		editorIdle();
+		finishKey();
+	}
+	if (next < script.size()) {
+		int key = script[next++];
+		startKey(key);
+		return key;
+	}
+
+	// out of keys: keep asking to quit, Ctrl-Q also cancels prompts and answers the dirty buffer warning
+	if (++quitKeys > HEADLESS_MAX_QUIT_KEYS) {
+		editorHeadlessReport(stdout);
+		fprintf(stderr, "replay: the editor did not quit after the script ended\n");
+		exit(1);
+	}
+	return CTRL_KEY('q');
+}
+
+void editorHeadlessRefreshScreen() {
+	clockType::time_point start = clockType::now();
+	editorScroll();
+	struct abuf ab = {nullptr, 0};
+	abAppend(&ab, "\x1b[H", 3);
+	editorDrawScreen(&ab);
+	screenFeed(ab.b, ab.len);
+	editorHudFrame(ab.len);
+	abFree(&ab);
+	drawNs += nsSince(start);
+}
+
+void editorHeadlessWindowSize() {
+	E.screenrows = screenRows - 2;
+	E.screencols = screenCols;
+}
+
+/*** report ***/
+
+static long long percentile(std::vector<long long>& values, int pct) {
+	size_t at = (values.size() - 1) * pct / 100;
+	std::nth_element(values.begin(), values.begin() + at, values.end());
+	return values[at];
+}
+
+// per key statistics in microseconds, then the final screen so runs can be compared
+void editorHeadlessReport(FILE* out) {
+	finishKey();
+	long long total = nsSince(replayStart);
+
+	// all printable keys insert text, they are reported together
+	std::map<std::string, std::vector<const keySample*>> groups;
+	for (const keySample& s : samples) {
+		bool text = (s.key >= 32 && s.key < 127 && s.key != '<') || (s.key >= 128 && s.key < 256);
+		groups[text ? "<text>" : nameOfKey(s.key)].push_back(&s);
+	}
+
+	fprintf(out, "replay: %zu keys in %.1f ms, %dx%d screen\n", samples.size(), total / 1e6, screenRows, screenCols);
+	fprintf(out, "%-10s %7s %10s %9s %9s %9s %9s %9s %9s\n", "key", "count", "total ms", "mean us", "p50 us", "p99 us",
+			"max us", "draw us", "draw max");
+	for (auto& group : groups) {
+		std::vector<long long> keyNs;
+		long long sum = 0, drawSum = 0, drawMax = 0;
+		for (const keySample* s : group.second) {
+			keyNs.push_back(s->keyNs);
+			sum += s->keyNs;
+			drawSum += s->drawNs;
+			drawMax = std::max(drawMax, s->drawNs);
+		}
+		double n = static_cast<double>(keyNs.size());
+		long long p50 = percentile(keyNs, 50);
+		long long p99 = percentile(keyNs, 99);
+		long long max = *std::max_element(keyNs.begin(), keyNs.end());
+		fprintf(out, "%-10s %7zu %10.2f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", group.first.c_str(), keyNs.size(),
+				sum / 1e6, sum / n / 1e3, p50 / 1e3, p99 / 1e3, max / 1e3, drawSum / n / 1e3, drawMax / 1e3);
+	}
+
+	fprintf(out, "screen:\n");
+	for (int y = 0; y < screenRows; y++) {
+		std::string line = screenText(y);
+		size_t end = line.find_last_not_of(' ');
+		fprintf(out, "|%s\n", end == std::string::npos ? "" : line.substr(0, end + 1).c_str());
+	}
+}
+
+/*** recording ***/
+
+static FILE* recordFile = NULL;
+static bool recordInText = false;
+
+bool editorRecordStart(const char* path) {
+	recordFile = fopen(path, "w");
+	if (recordFile == NULL)
+		return false;
+	fprintf(recordFile, "# kilo keystroke script, replay with --replay=<file>\n");
+	return true;
+}
+
+// printable keys are kept together on one line, named keys each get their own
+void editorRecordKey(int key) {
+	if (recordFile == NULL)
+		return;
+	// bytes of UTF-8 text are written as they are, the script reads back as the same bytes
+	if ((key >= 32 && key < 127 && key != '<') || (key >= 128 && key < 256)) {
+		// a # at the start of a line would read back as a comment
+		if (key == '#' && !recordInText)
+			fputs("<HASH>", recordFile);
+		else
+			fputc(key, recordFile);
+		recordInText = true;
+	} else {
+		if (recordInText)
+			fputc('\n', recordFile);
+		fprintf(recordFile, "%s\n", nameOfKey(key).c_str());
+		recordInText = false;
+	}
+	// flushed every key, a session that ends in a crash is the one worth replaying
+	fflush(recordFile);
+}
+
+void editorRecordStop() {
+	if (recordFile == NULL)
+		return;
+	if (recordInText)
+		fputc('\n', recordFile);
+	fclose(recordFile);
+	recordFile = NULL;
+}
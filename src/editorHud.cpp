@@ -0,0 +1,210 @@
+#include "editorHud.hpp"
+#include "editorPlatform.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+/*** histogram ***/
+
+// Keystroke latency in microseconds, bucketed the way HdrHistogram does it: exact up to 2^HUD_HIST_BITS,
+// then a fixed number of linear steps per power of two, so the relative error stays under 2%.
+#define HIST_DIRECT (1 << HUD_HIST_BITS)
+#define HIST_STEPS (1 << (HUD_HIST_BITS - 1))
+#define HIST_BUCKETS (HIST_DIRECT + HUD_HIST_OCTAVES * HIST_STEPS)
+
+struct latencyHistogram {
+	long long counts[HIST_BUCKETS];
+	long long total;
+	long long sum;
+	long long max;
+};
+
+static int bucketOf(long long us) {
+	if (us < HIST_DIRECT)
+		return us < 0 ? 0 : static_cast<int>(us);
+	int msb = HUD_HIST_BITS;
+	while (us >> (msb + 1))
+		msb++;
+	int shift = msb - HUD_HIST_BITS + 1;
+	int idx = HIST_DIRECT + (msb - HUD_HIST_BITS) * HIST_STEPS + static_cast<int>((us >> shift) - HIST_STEPS);
+	return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+// the largest value that falls into a bucket
+static long long bucketValue(int idx) {
+	if (idx < HIST_DIRECT)
+		return idx;
+	int octave = (idx - HIST_DIRECT) / HIST_STEPS;
+	int step = (idx - HIST_DIRECT) % HIST_STEPS;
+	int shift = octave + 1;
+	return (static_cast<long long>(HIST_STEPS + step + 1) << shift) - 1;
+}
+
+static void histRecord(latencyHistogram* h, long long us) {
+	h->counts[bucketOf(us)]++;
+	h->total++;
+	h->sum += us;
+	if (us > h->max)
+		h->max = us;
+}
+
+static long long histPercentile(const latencyHistogram* h, double pct) {
+	if (h->total == 0)
+		return 0;
+	long long want = static_cast<long long>(h->total * pct / 100.0 + 0.5);
+	if (want < 1)
+		want = 1;
+	long long seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= want)
+			return bucketValue(i) < h->max ? bucketValue(i) : h->max;
+	}
+	return h->max;
+}
+
+/*** sampling ***/
+
+using hudClock = std::chrono::steady_clock;
+
+static latencyHistogram latency;
+static bool hudVisible = false;
+static bool keyWaiting = false;
+static hudClock::time_point keyTime;
+
+static hudClock::time_point frameTimes[HUD_FPS_FRAMES];
+static int frameHead = 0;
+static long long frames = 0;
+static long long frameBytes = 0;
+static int lastFrameBytes = 0;
+
+static long long rss = -1;
+static hudClock::time_point rssTime;
+
+static char* logPath = nullptr;
+
+static long long usSince(hudClock::time_point t) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(hudClock::now() - t).count();
+}
+
+// a key came back from readKey, the next frame written is the one that shows it
+void editorHudKey() {
+	// if several keys arrive before a frame, the oldest one decides the latency
+	if (!keyWaiting) {
+		keyWaiting = true;
+		keyTime = hudClock::now();
+	}
+}
+
+// a frame of bytes was just written to the terminal
+void editorHudFrame(int bytes) {
+	hudClock::time_point now = hudClock::now();
+	if (keyWaiting) {
+		histRecord(&latency, usSince(keyTime));
+		keyWaiting = false;
+	}
+	frameTimes[frameHead] = now;
+	frameHead = (frameHead + 1) % HUD_FPS_FRAMES;
+	frames++;
+	frameBytes += bytes;
+	lastFrameBytes = bytes;
+}
+
+/*** overlay ***/
+
+void editorHudToggle() {
+	hudVisible = !hudVisible;
+}
+
+bool editorHudActive() {
+	return hudVisible;
+}
+
+static int framesInLastSecond() {
+	hudClock::time_point now = hudClock::now();
+	int n = 0;
+	int count = frames < HUD_FPS_FRAMES ? static_cast<int>(frames) : HUD_FPS_FRAMES;
+	for (int i = 1; i <= count; i++) {
+		const hudClock::time_point& t = frameTimes[(frameHead - i + HUD_FPS_FRAMES) % HUD_FPS_FRAMES];
+		if (now - t > std::chrono::seconds(1))
+			break;
+		n++;
+	}
+	return n;
+}
+
+static void formatMs(char* buf, int len, long long us) {
+	snprintf(buf, len, "%.1f", us / 1000.0);
+}
+
+// formats the overlay for the message bar, returns 0 when the hud is hidden
+int editorHudStatus(char* buf, int len) {
+	if (!hudVisible) {
+		buf[0] = '\0';
+		return 0;
+	}
+	// reading /proc on every frame would show up in the numbers it is reporting
+	if (rss < 0 || usSince(rssTime) > HUD_RSS_INTERVAL_MS * 1000LL) {
+		rss = residentBytes();
+		rssTime = hudClock::now();
+	}
+	char p50[16], p99[16], max[16], mem[16];
+	formatMs(p50, sizeof(p50), histPercentile(&latency, 50));
+	formatMs(p99, sizeof(p99), histPercentile(&latency, 99));
+	formatMs(max, sizeof(max), latency.max);
+	if (rss < 0)
+		snprintf(mem, sizeof(mem), "?");
+	else
+		snprintf(mem, sizeof(mem), "%.1fMB", rss / (1024.0 * 1024.0));
+	return snprintf(buf, len, "[p50 %s p99 %s max %s ms | %.1fKB/f | %d fps | %s]", p50, p99, max,
+					lastFrameBytes / 1024.0, framesInLastSecond(), mem);
+}
+
+/*** log ***/
+
+// the latency histogram is written to path when the editor exits
+bool editorHudLogStart(const char* path) {
+	FILE* probe = fopen(path, "w");
+	if (probe == NULL)
+		return false;
+	fclose(probe);
+	free(logPath);
+	logPath = strdup(path);
+	return true;
+}
+
+void editorHudLogStop() {
+	if (logPath == nullptr)
+		return;
+	FILE* out = fopen(logPath, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", logPath);
+		return;
+	}
+	editorHudReport(out);
+	fclose(out);
+}
+
+// the percentile distribution in the layout HdrHistogram prints, values in milliseconds
+void editorHudReport(FILE* out) {
+	fprintf(out, "# keystroke to write latency, %lld samples\n", latency.total);
+	fprintf(out, "%12s %14s %10s %14s\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+	long long seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		if (latency.counts[i] == 0)
+			continue;
+		seen += latency.counts[i];
+		double fraction = static_cast<double>(seen) / latency.total;
+		long long value = bucketValue(i) < latency.max ? bucketValue(i) : latency.max;
+		if (fraction < 1.0)
+			fprintf(out, "%12.3f %14.12f %10lld %14.2f\n", value / 1000.0, fraction, seen, 1.0 / (1.0 - fraction));
+		else
+			fprintf(out, "%12.3f %14.12f %10lld\n", value / 1000.0, fraction, seen);
+	}
+	double mean = latency.total ? static_cast<double>(latency.sum) / latency.total / 1000.0 : 0;
+	fprintf(out, "#[Mean    = %12.3f, Max = %12.3f]\n", mean, latency.max / 1000.0);
+	fprintf(out, "#[p50     = %12.3f, p99 = %12.3f, p99.9 = %12.3f]\n", histPercentile(&latency, 50) / 1000.0,
+			histPercentile(&latency, 99) / 1000.0, histPercentile(&latency, 99.9) / 1000.0);
+	fprintf(out, "#[Frames  = %12lld, Bytes/frame = %12.1f]\n", frames,
+			frames ? static_cast<double>(frameBytes) / frames : 0.0);
+}
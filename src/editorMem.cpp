@@ -0,0 +1,92 @@
+#include "editorMem.hpp"
+#include "editorPlatform.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+/*** accounting ***/
+
+// Counts what the allocator actually handed out, so slack from rounding shows up too.
+// The stdin reader thread allocates as well, hence the atomics.
+struct memCounter {
+	std::atomic<long long> current;
+	std::atomic<long long> peak;
+};
+
+static memCounter counters[MEM_CATEGORIES + 1]; // the extra one is the total
+
+static const char* categoryNames[MEM_CATEGORIES] = {"row text", "render", "hl spans", "tab index", "chunk tables",
+													"row array", "scratch",	  "frame",	   "stdin queue", "pager index", "words",	"outline",	"brackets", "wrap"};
+
+static void bump(memCounter* c, long long delta) {
+	long long now = c->current.fetch_add(delta, std::memory_order_relaxed) + delta;
+	long long peak = c->peak.load(std::memory_order_relaxed);
+	while (now > peak && !c->peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+		;
+}
+
+void editorMemAdd(memCategory cat, long long delta) {
+	if (delta == 0)
+		return;
+	bump(&counters[cat], delta);
+	bump(&counters[MEM_CATEGORIES], delta);
+}
+
+void* memAlloc(memCategory cat, size_t size) {
+	void* p = malloc(size);
+	if (p)
+		editorMemAdd(cat, static_cast<long long>(allocationSize(p)));
+	return p;
+}
+
+void* memRealloc(memCategory cat, void* p, size_t size) {
+	long long before = p ? static_cast<long long>(allocationSize(p)) : 0;
+	void* q = realloc(p, size);
+	if (q)
+		editorMemAdd(cat, static_cast<long long>(allocationSize(q)) - before);
+	return q;
+}
+
+void memFree(memCategory cat, void* p) {
+	if (p == NULL)
+		return;
+	editorMemAdd(cat, -static_cast<long long>(allocationSize(p)));
+	free(p);
+}
+
+long long editorMemCurrent(memCategory cat) {
+	return counters[cat].current.load(std::memory_order_relaxed);
+}
+
+long long editorMemPeak(memCategory cat) {
+	return counters[cat].peak.load(std::memory_order_relaxed);
+}
+
+/*** report ***/
+
+static void formatBytes(char* buf, int len, long long bytes) {
+	if (bytes < 1024)
+		snprintf(buf, len, "%lld B", bytes);
+	else if (bytes < (1LL << 20))
+		snprintf(buf, len, "%.1f KB", bytes / 1024.0);
+	else
+		snprintf(buf, len, "%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+// one line per category with current and peak bytes, returns the length written
+int editorMemReport(char* buf, int len) {
+	int at = snprintf(buf, len, "%-14s %12s %12s\n", "memory", "current", "peak");
+	char cur[24], peak[24];
+	for (int i = 0; i <= MEM_CATEGORIES && at < len; i++) {
+		formatBytes(cur, sizeof(cur), counters[i].current.load(std::memory_order_relaxed));
+		formatBytes(peak, sizeof(peak), counters[i].peak.load(std::memory_order_relaxed));
+		at += snprintf(buf + at, len - at, "%-14s %12s %12s\n", i < MEM_CATEGORIES ? categoryNames[i] : "total", cur,
+					   peak);
+	}
+	long long rss = residentBytes();
+	if (rss >= 0 && at < len) {
+		formatBytes(cur, sizeof(cur), rss);
+		at += snprintf(buf + at, len - at, "%-14s %12s\n", "resident", cur);
+	}
+	return at < len ? at : len - 1;
+}
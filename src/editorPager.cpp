@@ -0,0 +1,478 @@
+#include "editorPager.hpp"
+#include "editorMem.hpp"
+#include "editorReload.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*** pager ***/
+
+// The pager keeps only a window of the file in E.row, so drawing, highlighting and find work
+// unchanged. The window slides as the cursor nears either end and is trimmed to stay under the cap.
+struct pagerState {
+	bool requested;
+	bool active;
+	long long cap;
+	std::ifstream file;
+	long long fileSize;
+	long long winStart;        // file offset of E.row[0]
+	long long winEnd;          // file offset just past the last loaded row
+	std::deque<int> rowBytes;  // bytes each loaded row takes on disk, terminator included
+	long long firstLine;       // line number of E.row[0]
+	bool lineExact;            // false while firstLine is only an estimate
+};
+
+static pagerState P = {false, false, PAGER_DEFAULT_CAP, {}, 0, 0, 0, {}, 0, false};
+
+// sparse line index, lineIndex[k] is the offset of line k * indexStep
+static std::mutex indexLock;
+static std::vector<long long> lineIndex;
+static long long indexStep = PAGER_INDEX_STEP;
+static long long indexedBytes = 0;
+static long long indexedLines = 0;
+static std::atomic<bool> indexDone(false);
+static std::atomic<bool> indexStop(false);
+static std::thread indexer;
+
+static void indexThread(std::string path) {
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> buf(PAGER_CHUNK_BYTES);
+	long long offset = 0;
+	long long line = 0;
+	while (!indexStop && file) {
+		file.read(buf.data(), buf.size());
+		long long n = file.gcount();
+		if (n <= 0)
+			break;
+		const char* p = buf.data();
+		const char* end = p + n;
+		const char* nl;
+		std::lock_guard<std::mutex> guard(indexLock);
+		while ((nl = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+			line++;
+			p = nl + 1;
+			if (line % indexStep != 0)
+				continue;
+			size_t cap = lineIndex.capacity();
+			lineIndex.push_back(offset + (p - buf.data()));
+			editorMemAdd(MEM_PAGER, static_cast<long long>(lineIndex.capacity() - cap) * sizeof(long long));
+			// thin the index out instead of letting it grow with the file
+			if (lineIndex.size() >= PAGER_INDEX_MAX) {
+				for (size_t k = 0; k * 2 < lineIndex.size(); k++)
+					lineIndex[k] = lineIndex[k * 2];
+				lineIndex.resize((lineIndex.size() + 1) / 2);
+				indexStep *= 2;
+			}
+		}
+		offset += n;
+		indexedBytes = offset;
+		indexedLines = line;
+	}
+	indexDone = true;
+}
+
+static long long averageLineBytes() {
+	std::lock_guard<std::mutex> guard(indexLock);
+	if (indexedLines == 0)
+		return indexedBytes > 0 ? indexedBytes : 80;
+	long long avg = indexedBytes / indexedLines;
+	return avg > 0 ? avg : 1;
+}
+
+static int readAt(long long offset, char* buf, int len) {
+	P.file.clear();
+	P.file.seekg(offset);
+	P.file.read(buf, len);
+	return static_cast<int>(P.file.gcount());
+}
+
+// moves forward from offset past count newlines, returns the offset reached
+static long long skipLines(long long offset, long long count) {
+	std::vector<char> buf(PAGER_CHUNK_BYTES);
+	while (count > 0 && offset < P.fileSize) {
+		int n = readAt(offset, buf.data(), buf.size());
+		if (n <= 0)
+			break;
+		const char* p = buf.data();
+		const char* end = p + n;
+		const char* nl;
+		while (count > 0 && (nl = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+			count--;
+			p = nl + 1;
+		}
+		offset += (count == 0) ? (p - buf.data()) : n;
+	}
+	return offset;
+}
+
+static long long countLines(long long from, long long to) {
+	std::vector<char> buf(PAGER_CHUNK_BYTES);
+	long long lines = 0;
+	while (from < to) {
+		int want = static_cast<int>(std::min<long long>(buf.size(), to - from));
+		int n = readAt(from, buf.data(), want);
+		if (n <= 0)
+			break;
+		lines += std::count(buf.data(), buf.data() + n, '\n');
+		from += n;
+	}
+	return lines;
+}
+
+// the first line start at or after offset
+static long long nextLineStart(long long offset) {
+	if (offset <= 0)
+		return 0;
+	if (offset >= P.fileSize)
+		return P.fileSize;
+	long long start = skipLines(offset - 1, 1);
+	// no newline within reach means one enormous line, so any offset is as good as a line start
+	return (start - offset > PAGER_MAX_LINE) ? offset : start;
+}
+
+// the start of the line that ends at offset, its newline included; a line longer than
+// PAGER_MAX_LINE is cut into rows anyway, so the search goes no further back than one row
+static long long prevLineStart(long long offset) {
+	if (offset <= 0)
+		return 0;
+	char last;
+	if (readAt(offset - 1, &last, 1) != 1)
+		return offset;
+	long long lineEnd = offset - (last == '\n' ? 1 : 0);
+	long long stop = std::max<long long>(0, lineEnd - PAGER_MAX_LINE);
+	std::vector<char> buf(PAGER_CHUNK_BYTES);
+	for (long long to = lineEnd; to > stop;) {
+		long long from = std::max<long long>(stop, to - static_cast<long long>(buf.size()));
+		int n = readAt(from, buf.data(), static_cast<int>(to - from));
+		if (n != to - from)
+			break;
+		for (int i = n - 1; i >= 0; i--)
+			if (buf[i] == '\n')
+				return from + i + 1;
+		to = from;
+	}
+	return stop;
+}
+
+// exact offset of a line when the indexer already got past it, -1 otherwise
+static long long indexedLineOffset(long long line) {
+	long long base, baseLine;
+	{
+		std::lock_guard<std::mutex> guard(indexLock);
+		if (line > indexedLines || lineIndex.empty())
+			return -1;
+		size_t k = static_cast<size_t>(line / indexStep);
+		if (k >= lineIndex.size())
+			k = lineIndex.size() - 1;
+		base = lineIndex[k];
+		baseLine = static_cast<long long>(k) * indexStep;
+	}
+	return skipLines(base, line - baseLine);
+}
+
+// exact line number of a line start when the indexer already got past it, -1 otherwise
+static long long indexedOffsetLine(long long offset) {
+	long long base, baseLine;
+	{
+		std::lock_guard<std::mutex> guard(indexLock);
+		if (offset > indexedBytes || lineIndex.empty())
+			return -1;
+		auto it = std::upper_bound(lineIndex.begin(), lineIndex.end(), offset);
+		size_t k = (it - lineIndex.begin()) - 1;
+		base = lineIndex[k];
+		baseLine = static_cast<long long>(k) * indexStep;
+	}
+	return baseLine + countLines(base, offset);
+}
+
+// splits buf into rows, lines past PAGER_MAX_LINE are cut into several rows.
+// Returns the number of bytes consumed, a trailing partial line is left alone unless eof.
+static int splitWindow(const char* buf, int len, bool eof, std::vector<rowText>& lines, std::vector<int>& bytes) {
+	const char* p = buf;
+	const char* end = buf + len;
+	while (p < end) {
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (nl == nullptr && !eof && end - p < PAGER_MAX_LINE && p != buf)
+			break;
+		const char* lineEnd = nl ? nl : end;
+		if (lineEnd - p > PAGER_MAX_LINE)
+			lineEnd = p + PAGER_MAX_LINE;
+		int rowLen = static_cast<int>(lineEnd - p);
+		int diskLen = rowLen + (lineEnd == nl ? 1 : 0);
+		while (rowLen > 0 && p[rowLen - 1] == '\r')
+			rowLen--;
+		bool crlf = lineEnd == nl && rowLen < lineEnd - p;
+		lines.push_back({p, rowLen, crlf});
+		bytes.push_back(diskLen);
+		p += diskLen;
+	}
+	return static_cast<int>(p - buf);
+}
+
+static int pagerGrowForward() {
+	if (P.winEnd >= P.fileSize)
+		return 0;
+	int want = static_cast<int>(std::min<long long>(PAGER_CHUNK_BYTES, P.fileSize - P.winEnd));
+	std::vector<char> buf(want);
+	int n = readAt(P.winEnd, buf.data(), want);
+	if (n <= 0)
+		return 0;
+
+	std::vector<rowText> lines;
+	std::vector<int> bytes;
+	int used = splitWindow(buf.data(), n, P.winEnd + n >= P.fileSize, lines, bytes);
+	editorSpliceRows(E.numrows, 0, lines.data(), static_cast<int>(lines.size()));
+	P.rowBytes.insert(P.rowBytes.end(), bytes.begin(), bytes.end());
+	P.winEnd += used;
+	return static_cast<int>(lines.size());
+}
+
+static int pagerGrowBackward() {
+	if (P.winStart <= 0)
+		return 0;
+	long long from = std::max<long long>(0, P.winStart - PAGER_CHUNK_BYTES);
+	int want = static_cast<int>(P.winStart - from);
+	std::vector<char> buf(want);
+	int n = readAt(from, buf.data(), want);
+	if (n != want)
+		return 0;
+
+	// the bytes before the first newline belong to a line that starts further back
+	int skip = 0;
+	if (from > 0) {
+		const char* nl = static_cast<const char*>(memchr(buf.data(), '\n', n));
+		if (nl != nullptr && nl - buf.data() + 1 < n) {
+			skip = static_cast<int>(nl - buf.data()) + 1;
+		} else {
+			// the chunk is all the tail of one long line, load that line from where it starts
+			from = prevLineStart(P.winStart);
+			want = static_cast<int>(P.winStart - from);
+			buf.resize(want);
+			n = readAt(from, buf.data(), want);
+			if (n != want)
+				return 0;
+		}
+	}
+	std::vector<rowText> lines;
+	std::vector<int> bytes;
+	splitWindow(buf.data() + skip, n - skip, true, lines, bytes);
+	int added = static_cast<int>(lines.size());
+	editorSpliceRows(0, 0, lines.data(), added);
+	P.rowBytes.insert(P.rowBytes.begin(), bytes.begin(), bytes.end());
+	P.winStart = from + skip;
+	P.firstLine = std::max<long long>(0, P.firstLine - added);
+	if (P.winStart == 0) {
+		P.firstLine = 0;
+		P.lineExact = true;
+	}
+	E.cy += added;
+	E.rowoff += added;
+	return added;
+}
+
+// drops rows far from the cursor until the window fits the cap again
+static void pagerTrim() {
+	// every byte on disk costs about two in memory, for chars and render, the highlight spans are small
+	long long target = P.cap / 2;
+	int margin = E.screenrows * 2;
+	if (P.winEnd - P.winStart <= target)
+		return;
+
+	int top = 0;
+	long long dropped = 0;
+	while (top < E.rowoff - margin && P.winEnd - P.winStart - dropped > target)
+		dropped += P.rowBytes[top++];
+	if (top > 0) {
+		editorSpliceRows(0, top, nullptr, 0);
+		P.rowBytes.erase(P.rowBytes.begin(), P.rowBytes.begin() + top);
+		P.winStart += dropped;
+		P.firstLine += top;
+		E.cy -= top;
+		E.rowoff -= top;
+	}
+
+	int keep = E.numrows;
+	dropped = 0;
+	while (keep > E.rowoff + E.screenrows + margin && P.winEnd - P.winStart - dropped > target)
+		dropped += P.rowBytes[--keep];
+	if (keep < E.numrows) {
+		editorSpliceRows(keep, E.numrows - keep, nullptr, 0);
+		P.rowBytes.erase(P.rowBytes.begin() + keep, P.rowBytes.end());
+		P.winEnd -= dropped;
+	}
+}
+
+// keeps a couple of screens loaded around the cursor
+void editorPagerSlide() {
+	if (!P.active)
+		return;
+	int margin = E.screenrows * 2;
+	while (E.cy + margin >= E.numrows && pagerGrowForward() > 0)
+		;
+	while (E.rowoff < margin && pagerGrowBackward() > 0)
+		;
+	pagerTrim();
+	E.dirty = 0;
+}
+
+static void pagerLoadAt(long long offset, long long line, bool exact) {
+	editorSpliceRows(0, E.numrows, nullptr, 0);
+	P.rowBytes.clear();
+	P.winStart = offset;
+	P.winEnd = offset;
+	P.firstLine = line;
+	P.lineExact = exact;
+	E.cx = 0;
+	E.cy = 0;
+	E.rowoff = 0;
+	E.coloff = 0;
+	editorPagerSlide();
+	if (E.cy >= E.numrows)
+		E.cy = E.numrows > 0 ? E.numrows - 1 : 0;
+	E.rowoff = E.cy;
+}
+
+/*** public ***/
+
+void editorPagerRequest(long long capBytes) {
+	P.requested = true;
+	if (capBytes > 0)
+		P.cap = capBytes;
+}
+
+bool editorPagerWanted(const char* filename) {
+	long long mtime, size;
+	if (P.requested)
+		return true;
+	return editorStatFile(filename, &mtime, &size) == 0 && size > PAGER_AUTO_SIZE;
+}
+
+bool editorPagerActive() {
+	return P.active;
+}
+
+bool editorPagerOpen(const char* filename) {
+	P.file.open(filename, std::ios::binary);
+	if (!P.file.is_open())
+		return false;
+	P.file.seekg(0, std::ios::end);
+	P.fileSize = P.file.tellg();
+	P.active = true;
+
+	if (E.filename != nullptr)
+		free(E.filename);
+	E.filename = strdup(filename);
+	E.readonly = 1;
+	editorSelectSyntaxHighlight();
+
+	{
+		std::lock_guard<std::mutex> guard(indexLock);
+		lineIndex.assign(1, 0);
+		indexStep = PAGER_INDEX_STEP;
+		indexedBytes = 0;
+		indexedLines = 0;
+	}
+	indexDone = false;
+	indexStop = false;
+	indexer = std::thread(indexThread, std::string(filename));
+	pagerLoadAt(0, 0, true);
+	return true;
+}
+
+void editorPagerClose() {
+	if (!P.active)
+		return;
+	indexStop = true;
+	if (indexer.joinable())
+		indexer.join();
+	P.file.close();
+	P.active = false;
+}
+
+// once the indexer passes the window, estimated line numbers become exact
+bool editorPagerIdle() {
+	if (!P.active || P.lineExact)
+		return false;
+	long long line = indexedOffsetLine(P.winStart);
+	if (line < 0)
+		return false;
+	P.firstLine = line;
+	P.lineExact = true;
+	return true;
+}
+
+// jumps to a 1-based line number, or to a position in the file when target ends in '%'
+bool editorPagerGoto(const char* target) {
+	if (!P.active)
+		return false;
+	char* end;
+	double value = strtod(target, &end);
+	if (end == target)
+		return false;
+
+	if (*end == '%') {
+		if (value >= 100) {
+			pagerLoadAt(P.fileSize, 0, false);
+			P.lineExact = false;
+			long long line = indexedOffsetLine(P.winStart);
+			P.firstLine = line >= 0 ? line : P.winStart / averageLineBytes();
+			P.lineExact = line >= 0;
+			E.cy = E.numrows > 0 ? E.numrows - 1 : 0;
+			E.rowoff = E.cy >= E.screenrows ? E.cy - E.screenrows + 1 : 0;
+			return true;
+		}
+		long long offset = nextLineStart(static_cast<long long>(P.fileSize * std::max(0.0, value) / 100));
+		long long line = indexedOffsetLine(offset);
+		pagerLoadAt(offset, line >= 0 ? line : offset / averageLineBytes(), line >= 0);
+		return true;
+	}
+
+	long long line = std::max<long long>(0, static_cast<long long>(value) - 1);
+	long long offset = indexedLineOffset(line);
+	if (offset >= 0) {
+		pagerLoadAt(offset, line, true);
+	} else {
+		// not indexed yet, guess from the average line length seen so far
+		offset = nextLineStart(std::min(P.fileSize, line * averageLineBytes()));
+		pagerLoadAt(offset, line, false);
+	}
+	return true;
+}
+
+// file offset of a loaded row, what a pane holds on to when its rows leave the window
+long long editorPagerRowOffset(int row) {
+	long long offset = P.winStart;
+	for (int i = 0; i < row && i < static_cast<int>(P.rowBytes.size()); i++)
+		offset += P.rowBytes[i];
+	return offset;
+}
+
+// moves the window to a line start found earlier, returns the row that line landed on
+int editorPagerLoadOffset(long long offset) {
+	long long line = indexedOffsetLine(offset);
+	pagerLoadAt(offset, line >= 0 ? line : offset / averageLineBytes(), line >= 0);
+	return E.rowoff;
+}
+
+int editorPagerStatus(char* buf, int len) {
+	long long totalLines;
+	bool totalExact = indexDone;
+	{
+		std::lock_guard<std::mutex> guard(indexLock);
+		totalLines = indexedLines;
+	}
+	if (!totalExact)
+		totalLines = P.fileSize / averageLineBytes();
+	long long offset = P.winStart;
+	if (E.numrows > 0)
+		offset += (P.winEnd - P.winStart) * E.cy / E.numrows;
+	int percent = P.fileSize > 0 ? static_cast<int>(offset * 100 / P.fileSize) : 100;
+	return snprintf(buf, len, "%s | read-only | %s%lld/%s%lld %d%%", E.syntax ? E.syntax->filetype : "no ft",
+					P.lineExact ? "" : "~", P.firstLine + E.cy + 1, totalExact ? "" : "~", totalLines, percent);
+}
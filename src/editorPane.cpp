@@ -0,0 +1,353 @@
+#include "editorPane.hpp"
+#include "editorFold.hpp"
+#include "editorPager.hpp"
+#include "editorWrap.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*** layout ***/
+
+// Panes are the leaves of a tree of splits over the text area. They all look into the same rows
+// of the buffer on screen, a pane is only a cursor and a scroll position. The focused pane's copy
+// of those lives in E, like the buffer it shows.
+enum paneSplit {
+	PANE_LEAF = 0,
+	PANE_STACKED, // first above second, a bar between them
+	PANE_SIDE,	  // first left of second, a column of '|' between them
+	PANE_FREE,
+};
+
+struct editorPane {
+	int cx, cy;
+	int rowoff, coloff;
+	// a pager pane whose rows left the window keeps what it showed and where that was in the file
+	bool frozen;
+	long long offset;
+	std::vector<std::string> snapshot; // one drawn line per row, snapshotCols columns wide
+	int snapshotCols;
+};
+
+struct paneNode {
+	int split;
+	int parent, first, second;
+	int top, left, rows, cols;
+	editorPane view; // leaves only
+};
+
+// empty while the screen is a single pane
+static std::vector<paneNode> nodes;
+static int root = 0;
+static int focused = 0;
+
+static int newNode(int split, int parent) {
+	paneNode node = {};
+	node.split = split;
+	node.parent = parent;
+	for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+		if (nodes[i].split == PANE_FREE) {
+			nodes[i] = node;
+			return i;
+		}
+	}
+	nodes.push_back(node);
+	return static_cast<int>(nodes.size()) - 1;
+}
+
+static void freeNode(int n) {
+	nodes[n].split = PANE_FREE;
+	nodes[n].view.snapshot.clear();
+}
+
+static void layoutNode(int n, int top, int left, int rows, int cols) {
+	paneNode* node = &nodes[n];
+	node->top = top;
+	node->left = left;
+	node->rows = rows;
+	node->cols = cols;
+	if (node->split == PANE_STACKED) {
+		int first = (rows - 1) / 2;
+		layoutNode(node->first, top, left, first, cols);
+		layoutNode(node->second, top + first + 1, left, rows - first - 1, cols);
+	} else if (node->split == PANE_SIDE) {
+		int first = (cols - 1) / 2;
+		layoutNode(node->first, top, left, rows, first);
+		layoutNode(node->second, top, left + first + 1, rows, cols - first - 1);
+	}
+}
+
+// fits the panes to the screen and points E's view at the focused one, cheap enough for every frame
+void editorPaneLayout() {
+	int rows = E.screenrows - 2 > 1 ? E.screenrows - 2 : 1;
+	if (nodes.empty()) {
+		E.viewtop = 0;
+		E.viewleft = 0;
+		E.viewrows = rows;
+		E.viewcols = E.screencols;
+		return;
+	}
+	layoutNode(root, 0, 0, rows, E.screencols);
+	const paneNode* node = &nodes[focused];
+	E.viewtop = node->top;
+	E.viewleft = node->left;
+	E.viewrows = node->rows > 1 ? node->rows : 1;
+	E.viewcols = node->cols > 1 ? node->cols : 1;
+}
+
+static void saveView(editorPane* view) {
+	view->cx = E.cx;
+	view->cy = E.cy;
+	view->rowoff = E.rowoff;
+	view->coloff = E.coloff;
+	view->frozen = false;
+	view->snapshot.clear();
+}
+
+// gives E the cursor and scroll of leaf n, a frozen pager pane brings its rows back first
+static void focusLeaf(int n) {
+	saveView(&nodes[focused].view);
+	focused = n;
+	editorPane* view = &nodes[n].view;
+	if (view->frozen && editorPagerActive()) {
+		int top = editorPagerLoadOffset(view->offset);
+		view = &nodes[n].view;
+		E.cy = top + (view->cy - view->rowoff);
+		E.rowoff = top;
+	} else {
+		E.cy = view->cy;
+		E.rowoff = view->rowoff;
+	}
+	if (E.cy > E.numrows)
+		E.cy = E.numrows;
+	E.cx = view->cx;
+	E.coloff = view->coloff;
+	E.wrapoff = 0;
+	view->frozen = false;
+	view->snapshot.clear();
+	editorPaneLayout();
+}
+
+static int firstLeaf(int n) {
+	while (nodes[n].split != PANE_LEAF)
+		n = nodes[n].first;
+	return n;
+}
+
+static void collectLeaves(int n, std::vector<int>& leaves) {
+	if (nodes[n].split == PANE_LEAF) {
+		leaves.push_back(n);
+		return;
+	}
+	collectLeaves(nodes[n].first, leaves);
+	collectLeaves(nodes[n].second, leaves);
+}
+
+/*** commands ***/
+
+// splits the focused pane in two showing the same place, the new one above or left gets the focus
+bool editorPaneSplit(bool sideBySide) {
+	if (nodes.empty()) {
+		root = newNode(PANE_LEAF, -1);
+		focused = root;
+		editorPaneLayout();
+	}
+	const paneNode* node = &nodes[focused];
+	if (sideBySide ? node->cols < 2 * PANE_MIN_COLS + 1 : node->rows < 2 * PANE_MIN_ROWS + 1) {
+		if (nodes.size() == 1)
+			nodes.clear();
+		editorSetStatusMessage("Pane is too small to split");
+		return false;
+	}
+
+	int parent = focused;
+	int first = newNode(PANE_LEAF, parent);
+	int second = newNode(PANE_LEAF, parent);
+	saveView(&nodes[first].view);
+	saveView(&nodes[second].view);
+	nodes[parent].split = sideBySide ? PANE_SIDE : PANE_STACKED;
+	nodes[parent].first = first;
+	nodes[parent].second = second;
+	focused = first;
+	editorPaneLayout();
+	return true;
+}
+
+// closes the focused pane, its sibling takes over the room
+bool editorPaneClose() {
+	if (nodes.empty() || nodes[focused].parent < 0) {
+		editorSetStatusMessage("Only one pane");
+		return false;
+	}
+	int closing = focused;
+	int parent = nodes[closing].parent;
+	int sibling = nodes[parent].first == closing ? nodes[parent].second : nodes[parent].first;
+
+	// the sibling moves up into the parent's slot
+	int grand = nodes[parent].parent;
+	nodes[parent].split = nodes[sibling].split;
+	nodes[parent].first = nodes[sibling].first;
+	nodes[parent].second = nodes[sibling].second;
+	nodes[parent].view = nodes[sibling].view;
+	nodes[parent].parent = grand;
+	if (nodes[parent].split != PANE_LEAF) {
+		nodes[nodes[parent].first].parent = parent;
+		nodes[nodes[parent].second].parent = parent;
+	}
+	freeNode(sibling);
+
+	// focusLeaf saves E into the closing node, which is freed right after
+	focusLeaf(firstLeaf(parent));
+	freeNode(closing);
+	if (nodes[root].split == PANE_LEAF)
+		nodes.clear();
+	editorPaneLayout();
+	return true;
+}
+
+// keeps only the focused pane
+void editorPaneOnly() {
+	nodes.clear();
+	editorPaneLayout();
+}
+
+void editorPaneNext() {
+	if (nodes.empty()) {
+		editorSetStatusMessage("Only one pane, Ctrl-E split or vsplit");
+		return;
+	}
+	std::vector<int> leaves;
+	collectLeaves(root, leaves);
+	for (size_t i = 0; i < leaves.size(); i++) {
+		if (leaves[i] == focused) {
+			focusLeaf(leaves[(i + 1) % leaves.size()]);
+			return;
+		}
+	}
+}
+
+int editorPaneCount() {
+	int count = 0;
+	for (const paneNode& node : nodes)
+		if (node.split == PANE_LEAF)
+			count++;
+	return count > 0 ? count : 1;
+}
+
+/*** drawing ***/
+
+static void pad(struct abuf* ab, int n) {
+	static const char spaces[] = "                                ";
+	while (n > 0) {
+		int k = n < 32 ? n : 32;
+		abAppend(ab, spaces, k);
+		n -= k;
+	}
+}
+
+// line y of a pane, exactly its width so the next pane on the screen line starts in the right column
+static void drawPaneLine(struct abuf* ab, const paneNode* node, int y) {
+	const editorPane* view = &node->view;
+	if (view->frozen) {
+		// the screen was resized since, the lines kept no longer fit
+		if (y >= static_cast<int>(view->snapshot.size()) || view->snapshotCols != node->cols) {
+			pad(ab, node->cols);
+			return;
+		}
+		const std::string& line = view->snapshot[y];
+		abAppend(ab, line.data(), static_cast<int>(line.size()));
+		return;
+	}
+	// only the focused pane wraps, the others keep the width they were left at
+	bool isFocused = node == &nodes[focused];
+	int sub = 0;
+	int filerow = isFocused ? editorWrapRow(editorWrapTop() + y, &sub) : editorFoldRow(editorFoldLine(view->rowoff) + y);
+	int width = 0;
+	if (filerow < E.numrows) {
+		width = editorDrawRowSlice(ab, filerow, isFocused ? sub * node->cols + E.coloff : view->coloff, node->cols);
+	} else if (node->cols > 0) {
+		abAppend(ab, "~", 1);
+		width = 1;
+	}
+	pad(ab, node->cols - width);
+}
+
+static void drawNodeLine(struct abuf* ab, int n, int y) {
+	const paneNode* node = &nodes[n];
+	switch (node->split) {
+	case PANE_LEAF:
+		drawPaneLine(ab, node, y - node->top);
+		break;
+	case PANE_SIDE:
+		drawNodeLine(ab, node->first, y);
+		abAppend(ab, "|", 1);
+		drawNodeLine(ab, node->second, y);
+		break;
+	case PANE_STACKED:
+		if (y < nodes[node->second].top - 1) {
+			drawNodeLine(ab, node->first, y);
+		} else if (y >= nodes[node->second].top) {
+			drawNodeLine(ab, node->second, y);
+		} else {
+			abAppend(ab, "\x1b[7m", 4);
+			pad(ab, node->cols);
+			abAppend(ab, "\x1b[m", 3);
+		}
+		break;
+	}
+}
+
+// composes screen line y from the panes crossing it, returns false when the screen is not split
+bool editorPaneDrawLine(struct abuf* ab, int y) {
+	if (nodes.empty())
+		return false;
+	drawNodeLine(ab, root, y);
+	abAppend(ab, "\r\n", 2);
+	return true;
+}
+
+/*** row changes ***/
+
+// keeps the lines a pane shows, the pager is about to drop their rows
+static void freeze(paneNode* node) {
+	editorPane* view = &node->view;
+	view->offset = editorPagerRowOffset(view->rowoff);
+	view->snapshot.assign(node->rows, std::string());
+	view->snapshotCols = node->cols;
+	for (int y = 0; y < node->rows; y++) {
+		struct abuf ab = {nullptr, 0};
+		drawPaneLine(&ab, node, y);
+		view->snapshot[y].assign(ab.b ? ab.b : "", ab.len);
+		abFree(&ab);
+	}
+	view->frozen = true;
+}
+
+static void shiftRow(int* row, int at, int del, int ins) {
+	if (*row >= at + del)
+		*row += ins - del;
+	else if (*row > at)
+		*row = at;
+}
+
+// rows [at, at + del) are about to be replaced by ins rows, panes other than the focused one follow
+void editorPanesRowsMoved(int at, int del, int ins) {
+	for (int n = 0; n < static_cast<int>(nodes.size()); n++) {
+		paneNode* node = &nodes[n];
+		if (node->split != PANE_LEAF || n == focused || node->view.frozen)
+			continue;
+		editorPane* view = &node->view;
+		if (editorPagerActive() && del > 0 && view->rowoff < at + del && at < view->rowoff + node->rows) {
+			freeze(node);
+			continue;
+		}
+		shiftRow(&view->rowoff, at, del, ins);
+		shiftRow(&view->cy, at, del, ins);
+	}
+}
+
+// another buffer came on screen, every pane starts out where it was left
+void editorPanesReset() {
+	for (int n = 0; n < static_cast<int>(nodes.size()); n++)
+		if (nodes[n].split == PANE_LEAF && n != focused)
+			saveView(&nodes[n].view);
+}
@@ -1,5 +1,9 @@
 #include "editorPlatform.hpp"
 #include "editor.hpp"
+#include "editorHeadless.hpp"
+#include "editorHud.hpp"
+#include "editorTrace.hpp"
+#include "editorUtf8.hpp"
 #include <cassert>
 #include <ctime>
 
@@ -7,12 +11,45 @@
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <malloc.h>
+#include <psapi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
 #undef DELETE
 
 
 static DWORD originalConsoleMode;
+static UINT originalOutputCP;
+
+// the console hands out whole UTF-16 characters, the editor takes UTF-8 a byte at a time
+static char pendingBytes[4];
+static int pendingCount = 0;
+static int pendingNext = 0;
+static WCHAR highSurrogate = 0;
+
+static int queueCharacter(WCHAR unit) {
+	int cp = unit;
+	if (unit >= 0xd800 && unit <= 0xdbff) {
+		highSurrogate = unit;
+		return -1;
+	}
+	if (unit >= 0xdc00 && unit <= 0xdfff) {
+		if (highSurrogate == 0)
+			return -1;
+		cp = 0x10000 + ((highSurrogate - 0xd800) << 10) + (unit - 0xdc00);
+	}
+	highSurrogate = 0;
+	pendingCount = utf8Encode(cp, pendingBytes);
+	pendingNext = 1;
+	return static_cast<unsigned char>(pendingBytes[0]);
+}
 
-int readKey() {
+static int termReadKey() {
+	if (pendingNext < pendingCount)
+		return static_cast<unsigned char>(pendingBytes[pendingNext++]);
 	HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
 	DWORD numEvents = 0;
 	INPUT_RECORD ir;
@@ -29,8 +66,11 @@ int readKey() {
 				editorRefreshScreen();
 				refreshCount++;
 			}
+			editorIdle();
 			continue; // No events available, continue waiting
 		}
+		// an event is in, from here on it is handled rather than waited for
+		TRACE_SCOPE("readKey");
 
 		// Read input events
 		if (!ReadConsoleInput(hStdin, &ir, 1, &eventsRead)) {
@@ -47,6 +87,8 @@ int readKey() {
 #define KEY_EVENT TEMP_KEY_EVENT
 #undef TEMP_KEY_EVENT
 			bool ctrlPressed = (keyEvent.dwControlKeyState & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED)) != 0;
+			bool altPressed = (keyEvent.dwControlKeyState & (LEFT_ALT_PRESSED | RIGHT_ALT_PRESSED)) != 0;
+			bool shiftPressed = (keyEvent.dwControlKeyState & SHIFT_PRESSED) != 0;
 			bool keyDown = keyEvent.bKeyDown;
 
 			if (keyDown) {
@@ -58,17 +100,21 @@ int readKey() {
 
 				switch (keyEvent.wVirtualKeyCode) {
 				case VK_UP:
-					return ARROW_UP;
+					return altPressed ? ALT_ARROW_UP : shiftPressed ? SHIFT_ARROW_UP : ARROW_UP;
 				case VK_DOWN:
-					return ARROW_DOWN;
+					return altPressed ? ALT_ARROW_DOWN : shiftPressed ? SHIFT_ARROW_DOWN : ARROW_DOWN;
 				case VK_LEFT:
-					return ARROW_LEFT;
+					return shiftPressed ? SHIFT_ARROW_LEFT : ARROW_LEFT;
 				case VK_RIGHT:
-					return ARROW_RIGHT;
+					return shiftPressed ? SHIFT_ARROW_RIGHT : ARROW_RIGHT;
 				case VK_HOME:
-					return HOME_KEY;
+					return shiftPressed ? SHIFT_HOME : HOME_KEY;
 				case VK_END:
-					return END_KEY;
+					return shiftPressed ? SHIFT_END : END_KEY;
+				case VK_SPACE:
+					if (ctrlPressed)
+						return CTRL_KEY(' ');
+					return ' ';
 				case VK_PRIOR:
 					return PAGE_UP;
 				case VK_NEXT:
@@ -84,20 +130,31 @@ int readKey() {
 				case VK_BACK:
 					return BACKSPACE;
 				default:
-					if (keyEvent.uChar.AsciiChar == 0 || keyEvent.uChar.AsciiChar == -1) {
+					if (keyEvent.uChar.UnicodeChar == 0) {
 						continue; // Skip if no character code
 					}
-					if (ctrlPressed) {
-						return CTRL_KEY(keyEvent.uChar.AsciiChar);
+					if (ctrlPressed && keyEvent.uChar.UnicodeChar < 0x80) {
+						return CTRL_KEY(keyEvent.uChar.UnicodeChar);
+					}
+					if (keyEvent.uChar.UnicodeChar >= 0x80) {
+						int key = queueCharacter(keyEvent.uChar.UnicodeChar);
+						if (key == -1)
+							continue; // first half of a surrogate pair
+						return key;
 					}
-					return keyEvent.uChar.AsciiChar;
+					return keyEvent.uChar.UnicodeChar;
 				}
 			}
 		}
 	}
 }
 
-void updateWindowSize() {
+static bool termInputPending() {
+	DWORD numEvents = 0;
+	return GetNumberOfConsoleInputEvents(GetStdHandle(STD_INPUT_HANDLE), &numEvents) && numEvents > 0;
+}
+
+static void termWindowSize() {
 	CONSOLE_SCREEN_BUFFER_INFO csbi;
 	GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
 	int width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
@@ -114,7 +171,7 @@ void updateWindowSize() {
 	E.screenrows -= 2;
 }
 
-int enableRawMode() {
+static int termEnableRawMode() {
 	// assert(E.screencols != 0 || E.screenrows != 0);
 	HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
 	DWORD mode;
@@ -134,11 +191,15 @@ int enableRawMode() {
 		SetConsoleMode(hStdin, originalConsoleMode);
 		return -1; // Error setting console mode
 	}
+	// rows are written as UTF-8, whatever code page the console came up with
+	originalOutputCP = GetConsoleOutputCP();
+	SetConsoleOutputCP(CP_UTF8);
 	return 0;
 }
 
-void disableRawMode() {
+static void termDisableRawMode() {
 	std::cout << "\033[2J" << std::flush;
+	SetConsoleOutputCP(originalOutputCP);
 	// Restore the original console mode
 	HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
 
@@ -150,7 +211,7 @@ void disableRawMode() {
 	SetConsoleCursorInfo(hConsole, &ci);
 }
 
-void editorRefreshScreen() {
+static void termRefreshScreen() {
 	editorScroll();
 
 	struct abuf ab = {nullptr, 0};
@@ -162,10 +223,7 @@ void editorRefreshScreen() {
 	GetConsoleScreenBufferInfo(hConsole, &csbi);
 	GetConsoleCursorInfo(hConsole, &ci);
 
-	editorDrawRows(&ab);
-	editorDrawStatusBar(&ab);
-	editorDrawMessageBar(&ab);
-	editorDrawLineCount(&ab);
+	editorDrawScreen(&ab);
 
 	ci.bVisible = false;
 	SetConsoleCursorInfo(hConsole, &ci);
@@ -177,6 +235,7 @@ void editorRefreshScreen() {
 	SetConsoleCursorPosition(hConsole, {0, 0});
 
 	WriteConsoleA(hConsole, ab.b, ab.len, &written, nullptr);
+	editorHudFrame(ab.len);
 
 	ci.bVisible = true;
 	SetConsoleCursorInfo(hConsole, &ci);
@@ -184,6 +243,128 @@ void editorRefreshScreen() {
 	abFree(&ab);
 }
 
+// there is no cheap change notification for a single file, so the watcher just
+// tells the editor to compare timestamps about once a second
+static bool watching = false;
+static time_t lastPoll = 0;
+
+int watchFile(const char* filename) {
+	watching = filename != nullptr;
+	return 0;
+}
+
+void unwatchFile() {
+	watching = false;
+}
+
+bool fileChangedOnDisk() {
+	if (!watching || time(NULL) == lastPoll)
+		return false;
+	lastPoll = time(NULL);
+	return true;
+}
+
+// hands back the piped stdin as a crt descriptor and points the console input at the keyboard
+int openStdinStream() {
+	int fd = _dup(_fileno(stdin));
+	if (fd == -1)
+		return -1;
+	HANDLE con = CreateFileA("CONIN$", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+							 OPEN_EXISTING, 0, nullptr);
+	if (con == INVALID_HANDLE_VALUE) {
+		_close(fd);
+		return -1;
+	}
+	SetStdHandle(STD_INPUT_HANDLE, con);
+	_setmode(fd, _O_BINARY);
+	return fd;
+}
+
+int readStream(int fd, char* buf, int len) {
+	return _read(fd, buf, len);
+}
+
+void closeStream(int fd) {
+	_close(fd);
+}
+
+long long residentBytes() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return -1;
+	return static_cast<long long>(counters.WorkingSetSize);
+}
+
+size_t allocationSize(void* p) {
+	return _msize(p);
+}
+
+const char* mapFile(const char* path, long long* size) {
+	*size = 0;
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+							  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return NULL;
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (data == NULL)
+		return NULL;
+	*size = length.QuadPart;
+	return static_cast<const char*>(data);
+}
+
+void unmapFile(const char* data, long long) {
+	UnmapViewOfFile(data);
+}
+
+bool listDirectory(const char* dir, void (*fn)(void* ctx, const char* name, bool isDir), void* ctx) {
+	std::string pattern = std::string(dir) + "\\*";
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &entry, FindExSearchNameMatch, nullptr,
+								   FIND_FIRST_EX_LARGE_FETCH);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do {
+		const char* name = entry.cFileName;
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+		// junctions and directory links could lead back up the tree
+		bool isDir = (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		if (isDir && (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+			continue;
+		fn(ctx, name, isDir);
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+	return true;
+}
+
+bool currentDirectory(char* buf, int len) {
+	DWORD n = GetCurrentDirectoryA(static_cast<DWORD>(len), buf);
+	return n > 0 && n < static_cast<DWORD>(len);
+}
+
+bool cacheFilePath(const char* name, char* buf, int len) {
+	const char* base = getenv("LOCALAPPDATA");
+	if (base == NULL || *base == '\0')
+		return false;
+	std::string dir = std::string(base) + "\\kilo";
+	CreateDirectoryA(dir.c_str(), nullptr);
+	return snprintf(buf, len, "%s\\%s", dir.c_str(), name) < len;
+}
+
+bool replaceFile(const char* from, const char* to) {
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
 #elif defined(__unix__) || defined(linux) || defined(__APPLE__)
 #include <ctype.h>
 #include <errno.h>
@@ -192,11 +373,25 @@ void editorRefreshScreen() {
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <termios.h>
 #include <unistd.h>
 #include <signal.h>
+#include <dirent.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <string>
+#endif
 
 static struct termios orig_termios;
 void handleSigWinCh(int unused __attribute__((unused))) {
@@ -205,7 +400,7 @@ void handleSigWinCh(int unused __attribute__((unused))) {
 	if (E.cx > E.screencols) E.cx = E.screencols - 1;
 	editorRefreshScreen();
 }
-int enableRawMode() {
+static int termEnableRawMode() {
 	signal(SIGWINCH, handleSigWinCh);
 	write(STDOUT_FILENO, "\x1b[2J", 4); // clear screen
 
@@ -229,19 +424,48 @@ int enableRawMode() {
 	return 0;
 }
 
-void disableRawMode() {
+static void termDisableRawMode() {
 	write(STDOUT_FILENO, "\x1b[2J", 4); // clear screen
 	tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
 }
 
-int readKey() {
+// the rest of ESC [ 1 ; <modifier> <key>, what xterm sends for arrows with Shift, Alt or Ctrl held.
+// Combinations without a binding of their own act as the plain key
+static int readModifiedKey() {
+	char mod, key;
+	if (read(STDIN_FILENO, &mod, 1) != 1 || read(STDIN_FILENO, &key, 1) != 1)
+		return '\x1b';
+	bool alt = mod == '3';
+	bool shift = mod == '2';
+	switch (key) {
+	case 'A':
+		return alt ? ALT_ARROW_UP : shift ? SHIFT_ARROW_UP : ARROW_UP;
+	case 'B':
+		return alt ? ALT_ARROW_DOWN : shift ? SHIFT_ARROW_DOWN : ARROW_DOWN;
+	case 'C':
+		return shift ? SHIFT_ARROW_RIGHT : ARROW_RIGHT;
+	case 'D':
+		return shift ? SHIFT_ARROW_LEFT : ARROW_LEFT;
+	case 'H':
+		return shift ? SHIFT_HOME : HOME_KEY;
+	case 'F':
+		return shift ? SHIFT_END : END_KEY;
+	}
+	return '\x1b';
+}
+
+static int termReadKey() {
 	int nread;
 	char c;
 	while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
 		if (nread == -1 && errno != EAGAIN){
 			continue;
 		}
+		if (nread == 0)
+			editorIdle();
 	}
+	// the span starts with the first byte, the wait and the idle work above are not key latency
+	TRACE_SCOPE("readKey");
 
 	if (c == '\x1b') {
 		char seq[3];
@@ -255,6 +479,8 @@ int readKey() {
 			if (seq[1] >= '0' && seq[1] <= '9') {
 				if (read(STDIN_FILENO, &seq[2], 1) != 1)
 					return '\x1b';
+				if (seq[1] == '1' && seq[2] == ';')
+					return readModifiedKey();
 				if (seq[2] == '~') {
 					switch (seq[1]) {
 					case '1':
@@ -300,10 +526,16 @@ int readKey() {
 
 		return '\x1b';
 	} else {
-		return c;
+		// bytes of a UTF-8 character come one per call, as 128..255 rather than negative
+		return static_cast<unsigned char>(c);
 	}
 }
 
+static bool termInputPending() {
+	struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+	return poll(&pfd, 1, 0) > 0;
+}
+
 int getCursorPosition(int* rows, int* cols) {
 	char buf[32];
 	unsigned int i = 0;
@@ -328,7 +560,7 @@ int getCursorPosition(int* rows, int* cols) {
 	return 0;
 }
 
-void updateWindowSize() {
+static void termWindowSize() {
 	struct winsize ws;
 
 	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
@@ -344,7 +576,7 @@ void updateWindowSize() {
 }
 
 
-void editorRefreshScreen() {
+static void termRefreshScreen() {
 	editorScroll();
 
 	struct abuf ab = {nullptr, 0};
@@ -352,15 +584,262 @@ void editorRefreshScreen() {
 	abAppend(&ab, "\x1b[?25l", 6);
 	abAppend(&ab, "\x1b[H", 3);
 
-	editorDrawRows(&ab);
-	editorDrawStatusBar(&ab);
-	editorDrawMessageBar(&ab);
-	editorDrawLineCount(&ab);
+	editorDrawScreen(&ab);
 
 	abAppend(&ab, "\x1b[?25h", 6);
 
 	write(STDOUT_FILENO, ab.b, ab.len);
+	editorHudFrame(ab.len);
 	abFree(&ab);
 }
 
+#if defined(__linux__)
+// the directory is watched rather than the file, so saves that replace the file through a rename are seen too.
+// The descriptor is kept across watches, closing one stalls for milliseconds and buffer switches re-watch
+static int inotifyFd = -1;
+static int watchFd = -1;
+static std::string watchedName;
+
+int watchFile(const char* filename) {
+	unwatchFile();
+	if (filename == nullptr)
+		return -1;
+
+	std::string path = filename;
+	size_t slash = path.rfind('/');
+	std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+	watchedName = slash == std::string::npos ? path : path.substr(slash + 1);
+
+	if (inotifyFd == -1)
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd == -1)
+		return -1;
+	watchFd = inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+	return watchFd == -1 ? -1 : 0;
+}
+
+void unwatchFile() {
+	if (watchFd != -1)
+		inotify_rm_watch(inotifyFd, watchFd);
+	watchFd = -1;
+	watchedName.clear();
+}
+
+bool fileChangedOnDisk() {
+	if (inotifyFd == -1)
+		return false;
+	// events of a watch already removed may still be queued, the name check below drops them
+
+	bool changed = false;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(inotifyFd, buf, sizeof(buf))) > 0) {
+		for (char* p = buf; p < buf + len;) {
+			struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+			if (ev->len && watchedName == ev->name)
+				changed = true;
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+	return changed;
+}
+
+#else
+// no inotify, compare timestamps about once a second instead
+static bool watching = false;
+static time_t lastPoll = 0;
+
+int watchFile(const char* filename) {
+	watching = filename != nullptr;
+	return 0;
+}
+
+void unwatchFile() {
+	watching = false;
+}
+
+bool fileChangedOnDisk() {
+	if (!watching || time(NULL) == lastPoll)
+		return false;
+	lastPoll = time(NULL);
+	return true;
+}
 #endif
+
+// hands back the piped stdin as its own descriptor and reopens the terminal as stdin for the keyboard
+int openStdinStream() {
+	if (isatty(STDIN_FILENO))
+		return -1;
+	int tty = open("/dev/tty", O_RDWR);
+	if (tty == -1)
+		return -1;
+	int fd = dup(STDIN_FILENO);
+	if (fd == -1 || dup2(tty, STDIN_FILENO) == -1) {
+		close(tty);
+		return -1;
+	}
+	close(tty);
+	return fd;
+}
+
+int readStream(int fd, char* buf, int len) {
+	ssize_t n;
+	do {
+		n = read(fd, buf, len);
+	} while (n == -1 && errno == EINTR);
+	return static_cast<int>(n);
+}
+
+void closeStream(int fd) {
+	close(fd);
+}
+
+// -1 where the platform has no cheap way to ask
+long long residentBytes() {
+#if defined(__linux__)
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return -1;
+	long long pages = -1, resident = -1;
+	int n = fscanf(f, "%lld %lld", &pages, &resident);
+	fclose(f);
+	return n == 2 ? resident * sysconf(_SC_PAGESIZE) : -1;
+#else
+	return -1;
+#endif
+}
+
+// what the allocator really reserved for a block, which is at least what was asked for
+size_t allocationSize(void* p) {
+#if defined(__APPLE__)
+	return malloc_size(p);
+#else
+	return malloc_usable_size(p);
+#endif
+}
+
+// maps a file for reading, NULL when it is empty or can't be opened
+const char* mapFile(const char* path, long long* size) {
+	*size = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	*size = st.st_size;
+	return static_cast<const char*>(data);
+}
+
+void unmapFile(const char* data, long long size) {
+	munmap(const_cast<char*>(data), size);
+}
+
+// calls fn for each entry of dir but . and .., returns false if dir can't be read. Links to directories
+// are left out, they could lead back up the tree
+bool listDirectory(const char* dir, void (*fn)(void* ctx, const char* name, bool isDir), void* ctx) {
+	DIR* d = opendir(dir);
+	if (d == NULL)
+		return false;
+	std::string path;
+	while (struct dirent* entry = readdir(d)) {
+		const char* name = entry->d_name;
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+		bool isDir = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+			path.assign(dir).append("/").append(name);
+			struct stat st;
+			if (stat(path.c_str(), &st) == -1)
+				continue;
+			if (S_ISDIR(st.st_mode) && entry->d_type == DT_LNK)
+				continue;
+			isDir = S_ISDIR(st.st_mode);
+		}
+		fn(ctx, name, isDir);
+	}
+	closedir(d);
+	return true;
+}
+
+// the working directory as an absolute path, false if it does not fit in buf
+bool currentDirectory(char* buf, int len) {
+	return getcwd(buf, len) != NULL;
+}
+
+// where a file the editor keeps between runs goes, the directory is made on first use. False when
+// there is no home to put it in
+bool cacheFilePath(const char* name, char* buf, int len) {
+	std::string dir;
+	const char* xdg = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if (xdg && *xdg)
+		dir = xdg;
+	else if (home && *home)
+		dir = std::string(home) + "/.cache";
+	else
+		return false;
+	mkdir(dir.c_str(), 0700);
+	dir += "/kilo";
+	mkdir(dir.c_str(), 0700);
+	return snprintf(buf, len, "%s/%s", dir.c_str(), name) < len;
+}
+
+// puts from in the place of to in one step, readers see the old file or the new one
+bool replaceFile(const char* from, const char* to) {
+	return rename(from, to) == 0;
+}
+
+#endif
+
+/*** backend ***/
+
+// the terminal functions above, unless a keystroke script is being replayed headless
+
+int enableRawMode() {
+	return editorHeadlessActive() ? 0 : termEnableRawMode();
+}
+
+void disableRawMode() {
+	if (!editorHeadlessActive())
+		termDisableRawMode();
+}
+
+void updateWindowSize() {
+	if (editorHeadlessActive())
+		editorHeadlessWindowSize();
+	else
+		termWindowSize();
+}
+
+int readKey() {
+	int key;
+	if (editorHeadlessActive()) {
+		key = editorHeadlessReadKey();
+	} else {
+		key = termReadKey();
+		editorRecordKey(key);
+	}
+	editorHudKey();
+	return key;
+}
+
+bool inputPending() {
+	// replayed keys only arrive when asked for, so idle work always runs to completion
+	return editorHeadlessActive() ? false : termInputPending();
+}
+
+void editorRefreshScreen() {
+	TRACE_SCOPE("editorRefreshScreen");
+	if (editorHeadlessActive())
+		editorHeadlessRefreshScreen();
+	else
+		termRefreshScreen();
+}
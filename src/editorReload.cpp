@@ -0,0 +1,311 @@
+#include "editorReload.hpp"
+#include "editorEol.hpp"
+#include "editorPlatform.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <vector>
+
+/*** disk state ***/
+
+int editorStatFile(const char* filename, long long* mtime, long long* size) {
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return -1;
+#if defined(__linux__)
+	*mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+	*mtime = static_cast<long long>(st.st_mtime);
+#endif
+	*size = static_cast<long long>(st.st_size);
+	return 0;
+}
+
+// records what is on disk right now, so our own writes are not reported as external changes
+void editorRememberDiskState() {
+	E.disk_changed = 0;
+	if (E.filename == NULL || editorStatFile(E.filename, &E.disk_mtime, &E.disk_size) != 0) {
+		E.disk_mtime = -1;
+		E.disk_size = -1;
+	}
+}
+
+/*** line diff ***/
+
+struct diffHunk {
+	int oldStart, oldLen;
+	int newStart, newLen;
+};
+
+static uint64_t hashLine(const char* s, int len) {
+	uint64_t h = 1469598103934665603ULL;
+	for (int i = 0; i < len; i++) {
+		h ^= static_cast<unsigned char>(s[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static bool rowEquals(const erow* row, const rowText* line) {
+	return row->size == line->len && row->crlf == line->crlf && memcmp(row->chars, line->s, line->len) == 0;
+}
+
+// Myers' O(ND) diff over line hashes, hunks come out in order. Returns false if the
+// edit distance is above maxd, the caller then treats the whole region as one hunk.
+static bool myersDiff(const uint64_t* a, int n, const uint64_t* b, int m, int maxd, std::vector<diffHunk>& hunks) {
+	int max = n + m;
+	if (max > maxd)
+		max = maxd;
+	int offset = max + 1;
+	std::vector<int> v(2 * max + 3, 0);
+	// trace[d] holds v[-d-1 .. d+1] as it was before step d, so memory stays O(D^2)
+	std::vector<std::vector<int>> trace;
+
+	int found = -1;
+	for (int d = 0; d <= max && found < 0; d++) {
+		trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+		for (int k = -d; k <= d; k += 2) {
+			int x;
+			if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+				x = v[offset + k + 1];
+			else
+				x = v[offset + k - 1] + 1;
+			int y = x - k;
+			while (x < n && y < m && a[x] == b[y]) {
+				x++;
+				y++;
+			}
+			v[offset + k] = x;
+			if (x >= n && y >= m) {
+				found = d;
+				break;
+			}
+		}
+	}
+	if (found < 0)
+		return false;
+
+	// walk back from the end, collecting single line edits in reverse
+	std::vector<diffHunk> edits;
+	int x = n;
+	int y = m;
+	for (int d = found; d > 0; d--) {
+		const std::vector<int>& vd = trace[d];
+		int base = d + 1;
+		int k = x - y;
+		int prev_k;
+		if (k == -d || (k != d && vd[base + k - 1] < vd[base + k + 1]))
+			prev_k = k + 1;
+		else
+			prev_k = k - 1;
+		int prev_x = vd[base + prev_k];
+		int prev_y = prev_x - prev_k;
+		while (x > prev_x && y > prev_y) {
+			x--;
+			y--;
+		}
+		if (x == prev_x)
+			edits.push_back({prev_x, 0, prev_y, 1});
+		else
+			edits.push_back({prev_x, 1, prev_y, 0});
+		x = prev_x;
+		y = prev_y;
+	}
+
+	// merge edits that touch each other into hunks
+	for (int i = static_cast<int>(edits.size()) - 1; i >= 0; i--) {
+		const diffHunk& e = edits[i];
+		if (!hunks.empty()) {
+			diffHunk& h = hunks.back();
+			if (h.oldStart + h.oldLen == e.oldStart && h.newStart + h.newLen == e.newStart) {
+				h.oldLen += e.oldLen;
+				h.newLen += e.newLen;
+				continue;
+			}
+		}
+		hunks.push_back(e);
+	}
+	return true;
+}
+
+// maps a row index of the old buffer to the new one, rows inside a changed hunk go to its start
+static int mapRow(int row, const std::vector<diffHunk>& hunks) {
+	int delta = 0;
+	for (const diffHunk& h : hunks) {
+		if (row < h.oldStart)
+			break;
+		if (row < h.oldStart + h.oldLen) {
+			int offset = row - h.oldStart;
+			if (offset >= h.newLen)
+				offset = h.newLen > 0 ? h.newLen - 1 : 0;
+			return h.newStart + offset;
+		}
+		delta += h.newLen - h.oldLen;
+	}
+	return row + delta;
+}
+
+// The diff pairs lines up by hash only. Walks the rows it kept between start and end and turns any pair
+// whose text differs, a hash collision, into a hunk of its own, merged with the hunks it touches.
+static void confirmMatches(std::vector<diffHunk>& hunks, int start, int end, const std::vector<rowText>& lines) {
+	std::vector<diffHunk> out;
+	auto add = [&](const diffHunk& e) {
+		if (!out.empty()) {
+			diffHunk& h = out.back();
+			if (h.oldStart + h.oldLen == e.oldStart && h.newStart + h.newLen == e.newStart) {
+				h.oldLen += e.oldLen;
+				h.newLen += e.newLen;
+				return;
+			}
+		}
+		out.push_back(e);
+	};
+	int x = start;
+	int y = start;
+	for (size_t i = 0; i <= hunks.size(); i++) {
+		int stop = i < hunks.size() ? hunks[i].oldStart : end;
+		for (; x < stop; x++, y++)
+			if (!rowEquals(&E.row[x], &lines[y]))
+				add({x, 1, y, 1});
+		if (i == hunks.size())
+			break;
+		add(hunks[i]);
+		x = hunks[i].oldStart + hunks[i].oldLen;
+		y = hunks[i].newStart + hunks[i].newLen;
+	}
+	hunks.swap(out);
+}
+
+/*** reload ***/
+
+// splits the file contents the same way editorOpen does
+static void splitLines(const std::string& data, std::vector<rowText>& lines) {
+	const char* p = data.data();
+	const char* end = p + data.size();
+	while (p < end) {
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = nl ? nl : end;
+		int len = static_cast<int>(lineEnd - p);
+		bool crlf = nl && len > 0 && p[len - 1] == '\r';
+		lines.push_back({p, crlf ? len - 1 : len, crlf});
+		if (!nl)
+			break;
+		p = nl + 1;
+	}
+}
+
+// brings the buffer in line with the file on disk, only the rows that differ are replaced
+bool editorReload() {
+	if (E.filename == NULL)
+		return false;
+
+	std::ifstream file(E.filename, std::ios::binary);
+	if (!file.is_open())
+		return false;
+	file.seekg(0, std::ios::end);
+	std::streamoff filesize = file.tellg();
+	file.seekg(0, std::ios::beg);
+	std::string data(static_cast<size_t>(filesize > 0 ? filesize : 0), '\0');
+	file.read(&data[0], filesize);
+	data.resize(static_cast<size_t>(file.gcount()));
+
+	std::vector<rowText> lines;
+	splitLines(data, lines);
+	eolCounts counts = {0, 0};
+	eolCount(data.data(), static_cast<int>(data.size()), 0, &counts);
+	int n = E.numrows;
+	int m = static_cast<int>(lines.size());
+
+	// common prefix and suffix are compared directly, only the rest goes through the diff
+	int prefix = 0;
+	while (prefix < n && prefix < m && rowEquals(&E.row[prefix], &lines[prefix]))
+		prefix++;
+	int suffix = 0;
+	while (suffix < n - prefix && suffix < m - prefix &&
+		   rowEquals(&E.row[n - 1 - suffix], &lines[m - 1 - suffix]))
+		suffix++;
+
+	int oldLen = n - prefix - suffix;
+	int newLen = m - prefix - suffix;
+	std::vector<diffHunk> hunks;
+	if (oldLen == 0 || newLen == 0) {
+		if (oldLen != 0 || newLen != 0)
+			hunks.push_back({0, oldLen, 0, newLen});
+	} else {
+		std::vector<uint64_t> a(oldLen);
+		std::vector<uint64_t> b(newLen);
+		for (int i = 0; i < oldLen; i++)
+			a[i] = hashLine(E.row[prefix + i].chars, E.row[prefix + i].size) ^ E.row[prefix + i].crlf;
+		for (int i = 0; i < newLen; i++)
+			b[i] = hashLine(lines[prefix + i].s, lines[prefix + i].len) ^ lines[prefix + i].crlf;
+		if (!myersDiff(a.data(), oldLen, b.data(), newLen, RELOAD_MAX_DIFF, hunks)) {
+			hunks.clear();
+			hunks.push_back({0, oldLen, 0, newLen});
+		}
+	}
+	for (diffHunk& h : hunks) {
+		h.oldStart += prefix;
+		h.newStart += prefix;
+	}
+	confirmMatches(hunks, prefix, n - suffix, lines);
+
+	int cy = mapRow(E.cy, hunks);
+	int rowoff = mapRow(E.rowoff, hunks);
+
+	// last hunk first, so the row indexes of the earlier ones stay valid
+	for (int i = static_cast<int>(hunks.size()) - 1; i >= 0; i--) {
+		const diffHunk& h = hunks[i];
+		editorSpliceRows(h.oldStart, h.oldLen, &lines[h.newStart], h.newLen);
+	}
+
+	E.cy = cy > E.numrows ? E.numrows : cy;
+	E.rowoff = rowoff > E.cy ? E.cy : rowoff;
+	int rowlen = E.cy < E.numrows ? E.row[E.cy].size : 0;
+	if (E.cx > rowlen)
+		E.cx = rowlen;
+
+	E.eol = eolStyle(&counts);
+	E.noeol = !data.empty() && data.back() != '\n';
+	E.dirty = 0;
+	editorRememberDiskState();
+	editorSetStatusMessage("Reloaded from disk: %d changed region%s", static_cast<int>(hunks.size()),
+						   hunks.size() == 1 ? "" : "s");
+	return true;
+}
+
+void editorCheckFileChanged() {
+	if (E.filename == NULL || !fileChangedOnDisk())
+		return;
+	editorCheckDiskState();
+}
+
+// compares the file with what was loaded, reloading a clean buffer and warning about a modified one
+void editorCheckDiskState() {
+	if (E.filename == NULL)
+		return;
+
+	long long mtime, size;
+	if (editorStatFile(E.filename, &mtime, &size) != 0) {
+		if (E.disk_size >= 0) {
+			E.disk_changed = 1;
+			E.disk_mtime = -1;
+			E.disk_size = -1;
+			editorSetStatusMessage("WARNING!!! File was removed from disk.");
+			editorRefreshScreen();
+		}
+		return;
+	}
+	if (mtime == E.disk_mtime && size == E.disk_size)
+		return;
+
+	if (E.dirty) {
+		E.disk_mtime = mtime;
+		E.disk_size = size;
+		E.disk_changed = 1;
+		editorSetStatusMessage("WARNING!!! File changed on disk. Ctrl-R = reload | Ctrl-S = overwrite");
+	} else {
+		editorReload();
+	}
+	editorRefreshScreen();
+}
@@ -0,0 +1,102 @@
+#include "editorSearch.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*** substring search ***/
+
+#if defined(SEARCH_SSE2)
+static inline int lowestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long at;
+	_BitScanForward(&at, mask);
+	return static_cast<int>(at);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// The first and the last byte of the needle are compared at 16 positions a step on SSE2, only where
+// both match are the bytes in between compared. Text rarely has both at the right distance, so most
+// steps end after two compares and a movemask.
+const char* searchFind(const char* s, size_t n, const char* needle, size_t len) {
+	if (len == 0)
+		return s;
+	if (len > n)
+		return NULL;
+	if (len == 1)
+		return static_cast<const char*>(memchr(s, needle[0], n));
+	size_t i = 0;
+#if defined(SEARCH_SSE2)
+	__m128i first = _mm_set1_epi8(needle[0]);
+	__m128i last = _mm_set1_epi8(needle[len - 1]);
+	for (; i + len - 1 + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + len - 1));
+		unsigned int mask =
+			static_cast<unsigned int>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+		while (mask) {
+			int bit = lowestBit(mask);
+			if (memcmp(s + i + bit + 1, needle + 1, len - 2) == 0)
+				return s + i + bit;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	// memchr is vectorized by the C library wherever it matters
+	while (i + len <= n) {
+		const char* p = static_cast<const char*>(memchr(s + i, needle[0], n - len + 1 - i));
+		if (p == NULL)
+			return NULL;
+		if (memcmp(p + 1, needle + 1, len - 1) == 0)
+			return p;
+		i = p - s + 1;
+	}
+	return NULL;
+}
+
+/*** subsequence ***/
+
+static inline bool isLower(char c) {
+	return c >= 'a' && c <= 'z';
+}
+
+// Compares 16 bytes a step against the query byte looked for, the next step starts right behind each
+// one found. Paths are mostly shorter than two blocks, so the block that runs past the end is loaded
+// whole and its bytes past n are masked off rather than walked one at a time. Setting bit 5 turns
+// exactly the upper case letters into lower case ones, so a letter is looked for with that bit set in
+// the text, and the text needs no folded copy
+bool searchSubsequence(const char* s, size_t n, const char* q, size_t qlen, int* at) {
+	size_t i = 0, k = 0;
+#if defined(SEARCH_SSE2)
+	while (k < qlen && i < n) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+		if (isLower(q[k]))
+			block = _mm_or_si128(block, _mm_set1_epi8(0x20));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(q[k]))));
+		if (n - i < 16)
+			mask &= (1u << (n - i)) - 1;
+		if (mask == 0) {
+			i += 16;
+			continue;
+		}
+		int bit = lowestBit(mask);
+		at[k++] = static_cast<int>(i + bit);
+		i += bit + 1;
+	}
+#else
+	for (; k < qlen && i < n; i++) {
+		char c = isLower(q[k]) ? static_cast<char>(s[i] | 0x20) : s[i];
+		if (c == q[k])
+			at[k++] = static_cast<int>(i);
+	}
+#endif
+	return k == qlen;
+}
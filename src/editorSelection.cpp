@@ -0,0 +1,396 @@
+#include "editorSelection.hpp"
+#include "editorCursor.hpp"
+#include "editorMem.hpp"
+#include "editorTrace.hpp"
+#include "editorWords.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*** selection ***/
+
+static bool marking = false;
+static bool shifted = false; // the mark came from a shifted motion and goes with the next plain one
+static int markCx, markCy;
+
+void editorSelectionMark() {
+	editorCursorsClear();
+	marking = true;
+	shifted = false;
+	markCx = E.cx;
+	markCy = E.cy;
+}
+
+void editorSelectionClear() {
+	marking = false;
+	shifted = false;
+}
+
+// the rows may have changed under the mark since it was set, a reload for one
+static void clampPoint(int* cx, int* cy) {
+	if (*cy > E.numrows)
+		*cy = E.numrows;
+	int size = *cy < E.numrows ? E.row[*cy].size : 0;
+	if (*cx > size)
+		*cx = size;
+}
+
+// the selection in text order, false when there is no mark or nothing between it and the cursor
+static bool selectionBounds(int* ay, int* ax, int* by, int* bx) {
+	if (!marking)
+		return false;
+	int mx = markCx, my = markCy;
+	clampPoint(&mx, &my);
+	bool markFirst = my != E.cy ? my < E.cy : mx < E.cx;
+	*ay = markFirst ? my : E.cy;
+	*ax = markFirst ? mx : E.cx;
+	*by = markFirst ? E.cy : my;
+	*bx = markFirst ? E.cx : mx;
+	return *ay != *by || *ax != *bx;
+}
+
+bool editorSelectionActive() {
+	int ay, ax, by, bx;
+	return selectionBounds(&ay, &ax, &by, &bx);
+}
+
+// the selected characters [from, to) of a row, and whether its line ending is selected as well
+bool editorSelectionOnRow(int filerow, int* from, int* to, bool* eol) {
+	int ay, ax, by, bx;
+	if (!selectionBounds(&ay, &ax, &by, &bx) || filerow < ay || filerow > by)
+		return false;
+	*from = filerow == ay ? ax : 0;
+	*to = filerow == by ? bx : E.row[filerow].size;
+	*eol = filerow < by;
+	return *from < *to || *eol;
+}
+
+/*** register ***/
+
+// Lines of text held outside the buffer, a row per line. Rows cut whole are the buffer's own rows moved
+// here with their caches, often together with the row array they were in, so a cut copies no text.
+struct textRows {
+	erow* base; // row array, the lines are [first, first + rows)
+	int first;
+	int rows;
+	bool trailing; // the text ends with a line ending, so an empty line follows the rows
+	char* block;   // what the rows' text points into when it was copied in one go, NULL when they own it
+};
+
+static textRows reg;
+// text the register let go of or a deleted selection left, freed a slice at a time while idle
+static std::vector<textRows> retired;
+
+static int lineCount(const textRows* t) {
+	return t->rows + (t->trailing ? 1 : 0);
+}
+
+static const char* lineText(const textRows* t, int i, int* len) {
+	if (i >= t->rows) {
+		*len = 0;
+		return "";
+	}
+	*len = t->base[t->first + i].size;
+	return t->base[t->first + i].chars;
+}
+
+int editorRegisterLines() {
+	return lineCount(&reg);
+}
+
+// frees up to budget rows from the end of t, returns how many it freed. The row array and the block go
+// with the last row
+static int freeText(textRows* t, int budget) {
+	editorWordsSettle(t->base, t->base + t->first + t->rows);
+	int freed = 0;
+	while (t->rows > 0 && freed < budget) {
+		erow* row = &t->base[t->first + --t->rows];
+		if (t->block)
+			row->chars = NULL;
+		editorFreeRow(row);
+		freed++;
+	}
+	if (t->rows == 0) {
+		memFree(MEM_CHARS, t->block);
+		memFree(MEM_ROWS, t->base);
+		*t = textRows{};
+	}
+	return freed;
+}
+
+// hands t to the idle slices to free, small text goes right away
+static void retireText(textRows* t) {
+	if (t->rows > RETIRED_ROWS_SLICE)
+		retired.push_back(*t);
+	else
+		freeText(t, t->rows);
+	*t = textRows{};
+}
+
+// frees a slice of the retired text, returns true while some is left
+bool editorSelectionIdle() {
+	int budget = RETIRED_ROWS_SLICE;
+	while (!retired.empty() && budget > 0) {
+		budget -= freeText(&retired.back(), budget);
+		if (retired.back().rows == 0)
+			retired.pop_back();
+	}
+	return !retired.empty();
+}
+
+// a row that only has text, for the parts of lines the selection starts and ends in
+static void pieceRow(erow* row, char* chars, int len) {
+	memset(row, 0, sizeof(erow));
+	row->chars = chars;
+	row->size = len;
+	row->ascii = true;
+	row->ntabs = -1;
+}
+
+static void ownedPieceRow(erow* row, const char* s, int len) {
+	char* chars = static_cast<char*>(memAlloc(MEM_CHARS, len + 1));
+	memcpy(chars, s, len);
+	chars[len] = '\0';
+	pieceRow(row, chars, len);
+}
+
+// row y keeps its first cx bytes and gets s after them
+static void joinRow(int y, int cx, const char* s, int len, bool crlf) {
+	erow* row = &E.row[y];
+	row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, cx + len + 1));
+	memcpy(&row->chars[cx], s, len);
+	row->size = cx + len;
+	row->chars[row->size] = '\0';
+	row->crlf = crlf;
+	editorUpdateRow(row);
+	E.dirty++;
+}
+
+// Moves the text between two points into out and leaves the cursor where it started. The rows in
+// between leave the buffer in one editorTakeRows, only the two rows at the ends have text copied.
+static void removeRange(int ay, int ax, int by, int bx, textRows* out) {
+	TRACE_SCOPE("removeRange");
+	*out = textRows{};
+	erow* first = &E.row[ay];
+	if (ay == by) {
+		out->base = static_cast<erow*>(memAlloc(MEM_ROWS, sizeof(erow)));
+		out->rows = 1;
+		ownedPieceRow(&out->base[0], &first->chars[ax], bx - ax);
+		editorRowDelChars(first, ax, bx - ax);
+		E.cx = ax;
+		return;
+	}
+
+	erow head;
+	ownedPieceRow(&head, &first->chars[ax], first->size - ax);
+	bool crlf = first->crlf;
+	// down to the end of the text there is no row to take a tail from, the text ends with a line ending
+	out->trailing = by == E.numrows;
+	out->base = editorTakeRows(ay + 1, out->trailing ? by - ay - 1 : by - ay, 1, &out->first);
+	out->base[--out->first] = head;
+	out->rows = out->trailing ? by - ay : by - ay + 1;
+	if (out->trailing) {
+		joinRow(ay, ax, "", 0, crlf);
+	} else {
+		// the last row went whole, its tail comes back onto the first one
+		erow* last = &out->base[out->first + out->rows - 1];
+		joinRow(ay, ax, &last->chars[bx], last->size - bx, last->crlf);
+		last->size = bx;
+		last->chars[bx] = '\0';
+		editorRowDropCaches(last);
+	}
+	E.cx = ax;
+	E.cy = ay;
+}
+
+static void deleteSelection() {
+	int ay, ax, by, bx;
+	if (!selectionBounds(&ay, &ax, &by, &bx))
+		return;
+	textRows removed;
+	removeRange(ay, ax, by, bx, &removed);
+	retireText(&removed);
+	editorSelectionClear();
+}
+
+// copies the selection into one block of text with a row pointing at each line of it
+void editorCopy() {
+	TRACE_SCOPE("editorCopy");
+	int ay, ax, by, bx;
+	if (!selectionBounds(&ay, &ax, &by, &bx)) {
+		editorSetStatusMessage("Nothing selected");
+		return;
+	}
+	retireText(&reg);
+	reg.trailing = by == E.numrows;
+	reg.rows = reg.trailing ? by - ay : by - ay + 1;
+	size_t bytes = 0;
+	for (int y = ay; y < ay + reg.rows; y++)
+		bytes += (y == by ? bx : E.row[y].size) - (y == ay ? ax : 0) + 1;
+	reg.base = static_cast<erow*>(memAlloc(MEM_ROWS, sizeof(erow) * reg.rows));
+	reg.block = static_cast<char*>(memAlloc(MEM_CHARS, bytes));
+	char* at = reg.block;
+	for (int y = ay; y < ay + reg.rows; y++) {
+		int from = y == ay ? ax : 0;
+		int len = (y == by ? bx : E.row[y].size) - from;
+		memcpy(at, &E.row[y].chars[from], len);
+		at[len] = '\0';
+		pieceRow(&reg.base[y - ay], at, len);
+		at += len + 1;
+	}
+	editorSelectionClear();
+	int lines = lineCount(&reg);
+	editorSetStatusMessage("Copied %d line%s", lines, lines == 1 ? "" : "s");
+}
+
+void editorCut() {
+	int ay, ax, by, bx;
+	if (!selectionBounds(&ay, &ax, &by, &bx)) {
+		editorSetStatusMessage("Nothing selected");
+		return;
+	}
+	retireText(&reg);
+	removeRange(ay, ax, by, bx, &reg);
+	editorSelectionClear();
+}
+
+// Puts the register in at the cursor. The cursor's row keeps its head and takes the first line, the
+// rest of the lines go in with one editorSpliceRows and the last of them takes the row's tail.
+void editorPaste() {
+	TRACE_SCOPE("editorPaste");
+	int lines = lineCount(&reg);
+	if (lines == 0) {
+		editorSetStatusMessage("Nothing to paste");
+		return;
+	}
+	deleteSelection();
+	if (E.cy == E.numrows)
+		editorInsertRow(E.numrows, "", 0);
+	erow* row = &E.row[E.cy];
+	int len;
+	const char* text = lineText(&reg, 0, &len);
+	if (lines == 1) {
+		row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + len + 1));
+		memmove(&row->chars[E.cx + len], &row->chars[E.cx], row->size - E.cx + 1);
+		memcpy(&row->chars[E.cx], text, len);
+		row->size += len;
+		editorRowChanged(row, E.cx, len);
+		E.dirty++;
+		E.cx += len;
+		return;
+	}
+
+	// pasted lines end the way the row they go into does
+	bool crlf = row->crlf;
+	std::vector<rowText> ins(lines - 1);
+	for (int i = 1; i < lines; i++) {
+		ins[i - 1].s = lineText(&reg, i, &ins[i - 1].len);
+		ins[i - 1].crlf = crlf;
+	}
+	int lastLen = ins[lines - 2].len;
+	std::string last(ins[lines - 2].s, lastLen);
+	last.append(&row->chars[E.cx], row->size - E.cx);
+	ins[lines - 2].s = last.data();
+	ins[lines - 2].len = static_cast<int>(last.size());
+
+	joinRow(E.cy, E.cx, text, len, crlf);
+	editorSpliceRows(E.cy + 1, 0, ins.data(), lines - 1);
+	E.cy += lines - 1;
+	E.cx = lastLen;
+}
+
+/*** keys ***/
+
+// motion for a shifted key, the same as its plain one
+static void moveShifted(int c) {
+	switch (c) {
+	case SHIFT_ARROW_UP:
+		editorMoveCursor(ARROW_UP);
+		break;
+	case SHIFT_ARROW_DOWN:
+		editorMoveCursor(ARROW_DOWN);
+		break;
+	case SHIFT_ARROW_LEFT:
+		editorMoveCursor(ARROW_LEFT);
+		break;
+	case SHIFT_ARROW_RIGHT:
+		editorMoveCursor(ARROW_RIGHT);
+		break;
+	case SHIFT_HOME:
+		E.cx = 0;
+		break;
+	case SHIFT_END:
+		if (E.cy < E.numrows)
+			E.cx = E.row[E.cy].size;
+		break;
+	}
+}
+
+// handles the keys that make and use the selection, returns false for those that go on to the usual
+// path. Typing over a selection replaces it
+bool editorSelectionKey(int c) {
+	switch (c) {
+	case CTRL_KEY(' '):
+		if (marking && !shifted) {
+			editorSelectionClear();
+			editorSetStatusMessage("Mark cleared");
+		} else {
+			editorSelectionMark();
+			editorSetStatusMessage("Mark set");
+		}
+		return true;
+	case SHIFT_ARROW_UP:
+	case SHIFT_ARROW_DOWN:
+	case SHIFT_ARROW_LEFT:
+	case SHIFT_ARROW_RIGHT:
+	case SHIFT_HOME:
+	case SHIFT_END:
+		if (!marking) {
+			editorSelectionMark();
+			shifted = true;
+		}
+		moveShifted(c);
+		return true;
+	case CTRL_KEY('c'):
+		editorCopy();
+		return true;
+	case CTRL_KEY('x'):
+		if (!editorRejectReadOnly())
+			editorCut();
+		return true;
+	case CTRL_KEY('v'):
+		if (!editorRejectReadOnly())
+			editorPaste();
+		return true;
+	case '\x1b':
+		if (!marking)
+			return false;
+		editorSelectionClear();
+		return true;
+	case ARROW_UP:
+	case ARROW_DOWN:
+	case ARROW_LEFT:
+	case ARROW_RIGHT:
+	case HOME_KEY:
+	case END_KEY:
+	case PAGE_UP:
+	case PAGE_DOWN:
+		if (shifted)
+			editorSelectionClear();
+		return false;
+	case BACKSPACE:
+	case CTRL_KEY('h'):
+	case DEL_KEY:
+		if (!editorSelectionActive())
+			return false;
+		if (!editorRejectReadOnly())
+			deleteSelection();
+		return true;
+	}
+	if (c == '\r' || c == '\n' || c == '\t' || (c >= 32 && c < 256 && c != 127)) {
+		if (!E.readonly)
+			deleteSelection();
+		editorSelectionClear();
+	}
+	return false;
+}
@@ -0,0 +1,204 @@
+#include "editorStream.hpp"
+#include "editorEol.hpp"
+#include "editorMem.hpp"
+#include "editorPlatform.hpp"
+#include "editorTrace.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*** stdin streaming ***/
+
+// a run of complete lines read from the pipe, the rows point into data
+struct streamBatch {
+	std::string data;
+	std::vector<rowText> lines;
+	eolCounts counts = {0, 0};
+	bool noeol = false; // the last line of the input, which ended without a newline
+};
+
+static std::mutex streamLock;
+static std::condition_variable streamDrained; // the reader waits on it while STREAM_MAX_BATCHES are queued
+static std::deque<streamBatch*> pending;
+static bool streamStarted = false;
+static std::atomic<bool> streamRunning(false);
+static std::atomic<bool> streamDone(false);
+static std::atomic<long long> bytesRead(0);
+// line endings of everything drained so far, only touched on the main thread
+static eolCounts streamed = {0, 0};
+
+static long long batchBytes(const streamBatch* batch) {
+	return static_cast<long long>(sizeof(streamBatch) + batch->data.capacity() +
+								  batch->lines.capacity() * sizeof(rowText));
+}
+
+static void pushBatch(streamBatch* batch) {
+	if (batch->lines.empty()) {
+		delete batch;
+		return;
+	}
+	editorMemAdd(MEM_STREAM, batchBytes(batch));
+	// a slow drain holds the reader back instead of letting the queue grow past the rows shown
+	std::unique_lock<std::mutex> guard(streamLock);
+	streamDrained.wait(guard, [] { return pending.size() < STREAM_MAX_BATCHES; });
+	pending.push_back(batch);
+}
+
+// splits the bytes of a batch into lines, anything after the last newline is handed back as the carry
+static void splitBatch(streamBatch* batch, std::string& carry, bool eof) {
+	const char* base = batch->data.data();
+	const char* p = base;
+	const char* end = base + batch->data.size();
+	while (p < end) {
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!nl && !eof) {
+			carry.assign(p, end - p);
+			batch->data.resize(p - base);
+			break;
+		}
+		const char* lineEnd = nl ? nl : end;
+		int len = static_cast<int>(lineEnd - p);
+		bool crlf = nl && len > 0 && p[len - 1] == '\r';
+		batch->lines.push_back({p, crlf ? len - 1 : len, crlf});
+		if (!nl) {
+			batch->noeol = true;
+			break;
+		}
+		p = nl + 1;
+	}
+	eolCount(batch->data.data(), static_cast<int>(batch->data.size()), 0, &batch->counts);
+}
+
+// the last newline among the n bytes at p, NULL for none
+static const char* lastNewline(const char* p, int n) {
+	while (n > 0) {
+		if (p[--n] == '\n')
+			return p + n;
+	}
+	return NULL;
+}
+
+static void trackCarry(const std::string& carry, long long* tracked) {
+	long long bytes = static_cast<long long>(carry.capacity());
+	editorMemAdd(MEM_STREAM, bytes - *tracked);
+	*tracked = bytes;
+}
+
+// Reads are appended to the carry until one brings a newline. Everything up to it goes out as a batch
+// and only the bytes after it are copied back, so a line longer than a read is never copied again
+// for every read it spans.
+static void readerThread(int fd) {
+	std::string carry;
+	long long carryBytes = 0;
+	char* buf = static_cast<char*>(memAlloc(MEM_STREAM, STREAM_READ_SIZE));
+	editorTraceThread("stdin reader");
+	while (true) {
+		TRACE_SCOPE("readerThread");
+		int n = readStream(fd, buf, STREAM_READ_SIZE);
+		if (n <= 0)
+			break;
+		bytesRead += n;
+
+		carry.append(buf, n);
+		const char* nl = lastNewline(carry.data() + carry.size() - n, n);
+		if (nl == NULL) {
+			trackCarry(carry, &carryBytes);
+			continue;
+		}
+		size_t cut = nl - carry.data() + 1;
+		streamBatch* batch = new streamBatch;
+		batch->data.swap(carry);
+		carry.assign(batch->data, cut, std::string::npos);
+		batch->data.resize(cut);
+		trackCarry(carry, &carryBytes);
+		splitBatch(batch, carry, false);
+		pushBatch(batch);
+	}
+	if (!carry.empty()) {
+		streamBatch* batch = new streamBatch;
+		batch->data.swap(carry);
+		splitBatch(batch, carry, true);
+		pushBatch(batch);
+	}
+	trackCarry(carry, &carryBytes);
+	memFree(MEM_STREAM, buf);
+	closeStream(fd);
+	streamDone = true;
+}
+
+bool editorStreamStart(int fd) {
+	if (fd < 0 || streamRunning)
+		return false;
+	streamStarted = true;
+	streamRunning = true;
+	streamDone = false;
+	std::thread(readerThread, fd).detach();
+	return true;
+}
+
+bool editorStreamActive() {
+	return streamRunning;
+}
+
+// moves finished batches into the row store, returns true if any rows were added
+bool editorStreamDrain() {
+	if (!streamRunning)
+		return false;
+	TRACE_SCOPE("editorStreamDrain");
+
+	auto start = std::chrono::steady_clock::now();
+	bool added = false;
+	while (true) {
+		streamBatch* batch = nullptr;
+		{
+			std::lock_guard<std::mutex> guard(streamLock);
+			if (!pending.empty()) {
+				batch = pending.front();
+				pending.pop_front();
+			}
+		}
+		if (batch == nullptr)
+			break;
+		streamDrained.notify_one();
+
+		// streamed text is not an edit, so it must not mark the buffer as modified
+		int dirty = E.dirty;
+		editorSpliceRows(E.numrows, 0, batch->lines.data(), static_cast<int>(batch->lines.size()));
+		E.dirty = dirty;
+		streamed.lines += batch->counts.lines;
+		streamed.crlf += batch->counts.crlf;
+		E.eol = eolStyle(&streamed);
+		E.noeol = batch->noeol;
+		editorMemAdd(MEM_STREAM, -batchBytes(batch));
+		delete batch;
+		added = true;
+
+		if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(STREAM_DRAIN_BUDGET_MS))
+			return true;
+	}
+
+	if (streamDone) {
+		std::lock_guard<std::mutex> guard(streamLock);
+		if (pending.empty()) {
+			streamRunning = false;
+			added = true;
+		}
+	}
+	return added;
+}
+
+// formats the loading indicator for the status bar, returns 0 when nothing was ever streamed
+int editorStreamStatus(char* buf, int len) {
+	if (!streamStarted) {
+		buf[0] = '\0';
+		return 0;
+	}
+	double mb = bytesRead / (1024.0 * 1024.0);
+	return snprintf(buf, len, "[%.1f MB%s]", mb, streamRunning ? " loading" : "");
+}
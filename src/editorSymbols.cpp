@@ -0,0 +1,354 @@
+#include "editorSymbols.hpp"
+#include "editorMem.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*** index ***/
+
+struct symbolIndex {
+	std::vector<editorSymbol> list; // by row, at most one per row
+	long long tracked;				// bytes reported to the memory accounting
+};
+
+static void track(symbolIndex* ix) {
+	long long bytes = static_cast<long long>(ix->list.capacity() * sizeof(editorSymbol));
+	editorMemAdd(MEM_SYMBOLS, bytes - ix->tracked);
+	ix->tracked = bytes;
+}
+
+void editorSymbolsFree(symbolIndex* ix) {
+	if (ix == NULL)
+		return;
+	editorMemAdd(MEM_SYMBOLS, -ix->tracked);
+	delete ix;
+}
+
+// the first symbol at or after row
+static std::vector<editorSymbol>::iterator atRow(symbolIndex* ix, int row) {
+	// rows are highlighted top down when a file loads, their symbols go on the end
+	if (ix->list.empty() || ix->list.back().row < row)
+		return ix->list.end();
+	return std::lower_bound(ix->list.begin(), ix->list.end(), row,
+							[](const editorSymbol& s, int r) { return s.row < r; });
+}
+
+// rows [at, at + del) were replaced by ins others, the symbols below them move along
+void editorSymbolsRowsMoved(int at, int del, int ins) {
+	symbolIndex* ix = E.symbols;
+	if (ix == NULL || ix->list.empty())
+		return;
+	auto from = atRow(ix, at);
+	auto to = atRow(ix, at + del);
+	from = ix->list.erase(from, to);
+	for (auto it = from; it != ix->list.end(); ++it)
+		it->row += ins - del;
+}
+
+/*** finding declarations ***/
+
+// punctuation is a token of its own, its byte is its type
+enum { TOK_WORD = 256, TOK_KEYWORD, TOK_TYPE };
+
+struct symbolToken {
+	int at;
+	int len;
+	int type;
+};
+
+static inline bool identByte(unsigned char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+// the tokens of a row that are code, words carry the keyword class the highlighter gave them
+static int tokenize(const erow* row, const unsigned char* cls, symbolToken* out) {
+	const unsigned char* s = reinterpret_cast<const unsigned char*>(row->chars);
+	int n = 0;
+	for (int j = 0; j < row->size && n < SYMBOLS_MAX_TOKENS;) {
+		int hl = cls[j];
+		if (hl == HL_COMMENT || hl == HL_MLCOMMENT || hl == HL_STRING || hl == HL_NUMBER || isspace(s[j])) {
+			j++;
+			continue;
+		}
+		if (!identByte(s[j])) {
+			out[n++] = {j, 1, s[j]};
+			j++;
+			continue;
+		}
+		int k = j;
+		while (k < row->size && identByte(s[k]) && cls[k] == hl)
+			k++;
+		if (s[j] < '0' || s[j] > '9')
+			out[n++] = {j, k - j, hl == HL_KEYWORD1 ? TOK_KEYWORD : hl == HL_KEYWORD2 ? TOK_TYPE : TOK_WORD};
+		j = k;
+	}
+	return n;
+}
+
+struct symbolTokens {
+	const char* s;
+	const symbolToken* t;
+	int n;
+
+	bool is(int i, const char* word) const {
+		int len = static_cast<int>(strlen(word));
+		return i >= 0 && i < n && t[i].type >= TOK_WORD && t[i].len == len && memcmp(s + t[i].at, word, len) == 0;
+	}
+	bool punct(int i, int c) const {
+		return i >= 0 && i < n && t[i].type == c;
+	}
+	bool word(int i) const {
+		return i >= 0 && i < n && t[i].type == TOK_WORD;
+	}
+};
+
+static bool found(const symbolTokens& tok, int first, int last, int kind, editorSymbol* sym) {
+	sym->col = tok.t[first].at;
+	sym->kind = kind;
+	sym->name.assign(tok.s + tok.t[first].at, tok.t[last].at + tok.t[last].len - tok.t[first].at);
+	return true;
+}
+
+// Looks for a declaration worth listing on one row: a #define, a struct, union, enum or class with a
+// body, a typedef, or a function defined at the start of a line. The keyword classes tell the type
+// names and keywords from other words, which is all the parsing C needs at this level.
+static bool findSymbol(const erow* row, const unsigned char* cls, editorSymbol* sym) {
+	// indented rows only ever hold a struct or the like, and those start with a keyword
+	bool indented = isspace(static_cast<unsigned char>(row->chars[0]));
+	if (indented && memchr(cls, HL_KEYWORD1, row->size) == NULL)
+		return false;
+	symbolToken t[SYMBOLS_MAX_TOKENS];
+	symbolTokens tok = {row->chars, t, tokenize(row, cls, t)};
+	int n = tok.n;
+	if (n == 0)
+		return false;
+
+	if (tok.punct(0, '#'))
+		return tok.is(1, "define") && tok.word(2) && found(tok, 2, 2, SYM_MACRO, sym);
+
+	for (int i = 0; i < n; i++) {
+		if (t[i].type != TOK_KEYWORD)
+			continue;
+		int kind = tok.is(i, "struct")	? SYM_STRUCT
+				   : tok.is(i, "union") ? SYM_UNION
+				   : tok.is(i, "enum")	? SYM_ENUM
+				   : tok.is(i, "class") ? SYM_CLASS
+										: -1;
+		if (kind < 0)
+			continue;
+		int j = i + 1;
+		if (kind == SYM_ENUM && (tok.is(j, "class") || tok.is(j, "struct")))
+			j++;
+		// a forward declaration or a variable of the type is not where it is defined
+		if (tok.word(j) && (j + 1 == n || tok.punct(j + 1, '{') || tok.punct(j + 1, ':')))
+			return found(tok, j, j, kind, sym);
+		break;
+	}
+
+	if (tok.is(0, "typedef")) {
+		if (!tok.punct(n - 1, ';'))
+			return false;
+		// a function pointer type is named inside the first parentheses
+		for (int i = 0; i + 2 < n; i++)
+			if (tok.punct(i, '(') && tok.punct(i + 1, '*') && tok.word(i + 2))
+				return found(tok, i + 2, i + 2, SYM_TYPEDEF, sym);
+		return n >= 3 && tok.word(n - 2) && found(tok, n - 2, n - 2, SYM_TYPEDEF, sym);
+	}
+
+	// A function definition starts at the left edge with its return type, the name right before the
+	// first parenthesis. A prototype ends in a ; and a global with an initializer has an = first.
+	if (indented || (t[0].type == TOK_KEYWORD && !tok.is(0, "static") && !tok.is(0, "struct") &&
+					 !tok.is(0, "union") && !tok.is(0, "enum") && !tok.is(0, "class")))
+		return false;
+	int p = 0;
+	while (p < n && !tok.punct(p, '(')) {
+		if (tok.punct(p, '=') || tok.punct(p, ';'))
+			return false;
+		p++;
+	}
+	if (p == n || !tok.word(p - 1) || tok.punct(n - 1, ';'))
+		return false;
+	int start = p - 1;
+	if (tok.punct(start - 1, '~'))
+		start--;
+	while (tok.punct(start - 1, ':') && tok.punct(start - 2, ':') && tok.word(start - 3))
+		start -= 3;
+	// a bare name at the left edge is a call or a macro, a method of a class needs no return type
+	if (start == 0 && start == p - 1)
+		return false;
+	return found(tok, start, p - 1, SYM_FUNCTION, sym);
+}
+
+// keeps the row's entry in step with what the highlighter just saw on it, cls is NULL for rows that
+// are too long to hold a declaration
+void editorSymbolsRow(const erow* row, const unsigned char* cls) {
+	editorSymbol sym;
+	bool has = cls != NULL && E.syntax != NULL && !E.readonly && row->size > 0 && findSymbol(row, cls, &sym);
+	symbolIndex* ix = E.symbols;
+	if (ix == NULL) {
+		if (!has)
+			return;
+		ix = E.symbols = new symbolIndex();
+		ix->tracked = 0;
+	}
+	auto it = atRow(ix, row->idx);
+	bool there = it != ix->list.end() && it->row == row->idx;
+	if (!has) {
+		if (there)
+			ix->list.erase(it);
+		return;
+	}
+	sym.row = row->idx;
+	if (there) {
+		if (it->kind != sym.kind || it->col != sym.col || it->name != sym.name)
+			*it = std::move(sym);
+		return;
+	}
+	ix->list.insert(it, std::move(sym));
+	track(ix);
+}
+
+/*** jumping ***/
+
+static const char* kindNames[SYM_KINDS] = {"function", "struct", "union", "enum", "class", "typedef", "macro"};
+
+static void jumpTo(const editorSymbol& sym) {
+	E.cy = sym.row < E.numrows ? sym.row : E.numrows;
+	E.cx = E.cy < E.numrows && sym.col <= E.row[E.cy].size ? sym.col : 0;
+}
+
+// the symbol named name, a method also answers to its name without the class; the first one below
+// row after is taken, wrapping around to the top. Returns its place in the list or -1
+int editorSymbolsFind(const char* name, int len, int after) {
+	symbolIndex* ix = E.symbols;
+	if (ix == NULL || ix->list.empty())
+		return -1;
+	int n = static_cast<int>(ix->list.size());
+	int from = static_cast<int>(atRow(ix, after + 1) - ix->list.begin());
+	for (int k = 0; k < n; k++) {
+		const std::string& s = ix->list[(from + k) % n].name;
+		int at = static_cast<int>(s.size()) - len;
+		if (at < 0 || memcmp(s.data() + at, name, len) != 0)
+			continue;
+		if (at == 0 || (at >= 2 && s[at - 1] == ':' && s[at - 2] == ':'))
+			return (from + k) % n;
+	}
+	return -1;
+}
+
+// Ctrl-], to the declaration of the identifier under the cursor, again for the next one of that name
+void editorSymbolsJump() {
+	if (E.cy >= E.numrows)
+		return;
+	erow* row = &E.row[E.cy];
+	int start = E.cx;
+	int end = E.cx;
+	while (start > 0 && identByte(static_cast<unsigned char>(row->chars[start - 1])))
+		start--;
+	while (end < row->size && identByte(static_cast<unsigned char>(row->chars[end])))
+		end++;
+	if (start == end) {
+		editorSetStatusMessage("No identifier under the cursor");
+		return;
+	}
+	int k = editorSymbolsFind(&row->chars[start], end - start, E.cy);
+	if (k < 0) {
+		editorSetStatusMessage("No declaration of %.*s in this buffer", end - start, &row->chars[start]);
+		return;
+	}
+	const editorSymbol& sym = E.symbols->list[k];
+	editorSetStatusMessage("%s %s, line %d", kindNames[sym.kind], sym.name.c_str(), sym.row + 1);
+	jumpTo(sym);
+}
+
+/*** outline ***/
+
+static std::vector<int> shown; // places in the list that match the query, in row order
+static int selected;
+
+static bool containsFolded(const std::string& name, const std::string& query) {
+	if (query.size() > name.size())
+		return false;
+	for (size_t i = 0; i + query.size() <= name.size(); i++) {
+		size_t k = 0;
+		while (k < query.size() && tolower(static_cast<unsigned char>(name[i + k])) == query[k])
+			k++;
+		if (k == query.size())
+			return true;
+	}
+	return false;
+}
+
+// as many symbols as fit over the top rows, scrolled so the selected one is among them
+static void outlineShow() {
+	const std::vector<editorSymbol>& list = E.symbols->list;
+	int rows = E.screenrows - 3 > 1 ? E.screenrows - 3 : 1;
+	int first = selected >= rows ? selected - rows + 1 : 0;
+	char line[128];
+	snprintf(line, sizeof(line), "%d of %d symbols\n", static_cast<int>(shown.size()), static_cast<int>(list.size()));
+	std::string panel = line;
+	for (int k = first; k < static_cast<int>(shown.size()) && k < first + rows; k++) {
+		const editorSymbol& sym = list[shown[k]];
+		snprintf(line, sizeof(line), "%s%-9s", k == selected ? "> " : "  ", kindNames[sym.kind]);
+		panel += line;
+		panel += sym.name;
+		snprintf(line, sizeof(line), "  :%d\n", sym.row + 1);
+		panel += line;
+	}
+	free(E.panel);
+	E.panel = strdup(panel.c_str());
+}
+
+// with nothing typed the list starts at the declaration the cursor is in
+static void outlineRun(const char* query) {
+	std::string folded = query;
+	for (char& c : folded)
+		c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+	const std::vector<editorSymbol>& list = E.symbols->list;
+	shown.clear();
+	selected = 0;
+	for (int k = 0; k < static_cast<int>(list.size()); k++) {
+		if (!containsFolded(list[k].name, folded))
+			continue;
+		if (folded.empty() && list[k].row <= E.cy)
+			selected = static_cast<int>(shown.size());
+		shown.push_back(k);
+	}
+	outlineShow();
+}
+
+static void outlineCallback(char* query, int key) {
+	if (key == '\r' || key == '\n' || key == '\x1b' || key == CTRL_KEY('q'))
+		return;
+	if (key == ARROW_UP || key == ARROW_DOWN) {
+		if (key == ARROW_UP && selected > 0)
+			selected--;
+		else if (key == ARROW_DOWN && selected + 1 < static_cast<int>(shown.size()))
+			selected++;
+		outlineShow();
+		return;
+	}
+	outlineRun(query);
+}
+
+// Ctrl-T, the declarations of the buffer in order, narrowed by what is typed
+void editorSymbolsOutline() {
+	if (E.symbols == NULL || E.symbols->list.empty()) {
+		editorSetStatusMessage("No declarations in this buffer");
+		return;
+	}
+	outlineRun("");
+	char* picked = editorPrompt("Outline: %s (Use ESC/Arrows/Enter)", outlineCallback, PROMPT_ACCEPT_EMPTY);
+	free(E.panel);
+	E.panel = NULL;
+	if (picked) {
+		if (shown.empty())
+			editorSetStatusMessage("No declaration matches %s", picked);
+		else
+			jumpTo(E.symbols->list[shown[selected]]);
+		free(picked);
+	}
+	shown.clear();
+}
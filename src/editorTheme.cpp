@@ -0,0 +1,305 @@
+#include "editorTheme.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+/*** themes ***/
+
+// A theme is text, one "class = [bold] [reverse] color" per line, lines starting with # are comments. A color is
+// #rrggbb, one of the 16 ANSI names (which keep the terminal's own palette) or "default". Reverse swaps the color
+// with the background, which is how the selection and the brackets paired at the cursor are drawn when a theme
+// does not say otherwise.
+static const char* const builtinThemes[][2] = {
+	{"default", "comment = cyan\n"
+				"mlcomment = cyan\n"
+				"keyword1 = yellow\n"
+				"keyword2 = green\n"
+				"string = magenta\n"
+				"number = red\n"
+				"match = blue\n"},
+	{"dark", "normal = #d4d4d4\n"
+			 "comment = #6a9955\n"
+			 "mlcomment = #6a9955\n"
+			 "keyword1 = #c586c0\n"
+			 "keyword2 = #569cd6\n"
+			 "string = #ce9178\n"
+			 "number = #b5cea8\n"
+			 "match = bold #ffd700\n"},
+	{"solarized", "normal = #839496\n"
+				  "comment = #586e75\n"
+				  "mlcomment = #586e75\n"
+				  "keyword1 = #859900\n"
+				  "keyword2 = #b58900\n"
+				  "string = #2aa198\n"
+				  "number = #d33682\n"
+				  "match = bold #268bd2\n"},
+};
+
+static const char* const classNames[HL_CLASSES] = {"normal",   "comment", "mlcomment", "keyword1",
+												   "keyword2", "string",  "number",	   "match",
+												   "selection", "bracket"};
+
+static const char* const ansiNames[16] = {"black",		   "red",		   "green",			 "yellow",
+										  "blue",		   "magenta",	   "cyan",			 "white",
+										  "bright-black",  "bright-red",   "bright-green",	 "bright-yellow",
+										  "bright-blue",   "bright-magenta", "bright-cyan",	 "bright-white"};
+
+// xterm's default palette, what the ANSI colors most likely look like
+static const int ansiRgb[16] = {0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+								0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff};
+
+enum themeColorKind {
+	THEME_COLOR_DEFAULT = 0,
+	THEME_COLOR_ANSI,
+	THEME_COLOR_RGB,
+};
+
+struct themeColor {
+	int kind;
+	int value; // ANSI index or 0xrrggbb
+	bool bold;
+	bool reverse;
+};
+
+themeSgr themeSequences[HL_CLASSES];
+themeSgr themeReset;
+int themeRowStartId = HL_NORMAL;
+
+static themeColor themeColors[HL_CLASSES];
+static std::string themeName;
+static colorDepth depth = COLOR_16;
+
+/*** color depth ***/
+
+// COLORTERM is what truecolor terminals set, TERM names the 256 color ones
+static colorDepth detectColorDepth() {
+	const char* colorterm = getenv("COLORTERM");
+	if (colorterm && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+		return COLOR_TRUE;
+	// Windows Terminal takes 24 bit colors but does not say so
+	if (getenv("WT_SESSION"))
+		return COLOR_TRUE;
+	const char* term = getenv("TERM");
+	if (term && strstr(term, "256color"))
+		return COLOR_256;
+	return COLOR_16;
+}
+
+static int colorDistance(int a, int b) {
+	int dr = ((a >> 16) & 0xff) - ((b >> 16) & 0xff);
+	int dg = ((a >> 8) & 0xff) - ((b >> 8) & 0xff);
+	int db = (a & 0xff) - (b & 0xff);
+	return dr * dr + dg * dg + db * db;
+}
+
+static int nearestAnsi(int rgb) {
+	int best = 0;
+	for (int i = 1; i < 16; i++)
+		if (colorDistance(rgb, ansiRgb[i]) < colorDistance(rgb, ansiRgb[best]))
+			best = i;
+	return best;
+}
+
+// the closest of the 6x6x6 cube and the gray ramp of the 256 color palette
+static int nearest256(int rgb) {
+	static const int levels[6] = {0, 95, 135, 175, 215, 255};
+	int idx[3];
+	int cube = 0;
+	for (int c = 0; c < 3; c++) {
+		int v = (rgb >> (16 - 8 * c)) & 0xff;
+		idx[c] = v < 48 ? 0 : v < 115 ? 1 : (v - 35) / 40;
+		cube = (cube << 8) | levels[idx[c]];
+	}
+	int r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+	int avg = (r + g + b) / 3;
+	int grayIdx = avg < 8 ? 0 : avg > 238 ? 23 : (avg - 8) / 10;
+	int grayLevel = 8 + grayIdx * 10;
+	int gray = (grayLevel << 16) | (grayLevel << 8) | grayLevel;
+	if (colorDistance(rgb, gray) < colorDistance(rgb, cube))
+		return 232 + grayIdx;
+	return 16 + 36 * idx[0] + 6 * idx[1] + idx[2];
+}
+
+/*** sequences ***/
+
+static int ansiCode(int idx) {
+	return idx < 8 ? 30 + idx : 90 + idx - 8;
+}
+
+// the SGR parameters for a color at the current depth
+static int colorParams(char* buf, int len, const themeColor& c) {
+	if (c.kind == THEME_COLOR_DEFAULT)
+		return snprintf(buf, len, "39");
+	if (c.kind == THEME_COLOR_ANSI)
+		return snprintf(buf, len, "%d", ansiCode(c.value));
+	int r = (c.value >> 16) & 0xff, g = (c.value >> 8) & 0xff, b = c.value & 0xff;
+	switch (depth) {
+	case COLOR_TRUE:
+		return snprintf(buf, len, "38;2;%d;%d;%d", r, g, b);
+	case COLOR_256:
+		return snprintf(buf, len, "38;5;%d", nearest256(c.value));
+	default:
+		return snprintf(buf, len, "%d", ansiCode(nearestAnsi(c.value)));
+	}
+}
+
+// turns the theme colors into escape sequences, once per theme or depth change
+static void buildSequences() {
+	bool bold = false, reverse = false;
+	for (int i = 0; i < HL_CLASSES; i++) {
+		bold = bold || themeColors[i].bold;
+		reverse = reverse || themeColors[i].reverse;
+	}
+
+	// attributes only some classes have are switched off explicitly by the others
+	for (int i = 0; i < HL_CLASSES; i++) {
+		char params[24];
+		colorParams(params, sizeof(params), themeColors[i]);
+		char attrs[8] = "";
+		if (bold)
+			strcat(attrs, themeColors[i].bold ? "1;" : "22;");
+		if (reverse)
+			strcat(attrs, themeColors[i].reverse ? "7;" : "27;");
+		themeSgr* sgr = &themeSequences[i];
+		sgr->len = snprintf(sgr->seq, sizeof(sgr->seq), "\x1b[%s%sm", attrs, params);
+		sgr->id = i;
+		for (int j = 0; j < i; j++) {
+			if (strcmp(themeSequences[j].seq, sgr->seq) == 0) {
+				sgr->id = themeSequences[j].id;
+				break;
+			}
+		}
+	}
+	// a row starts and ends in the terminal's default colors, so normal text needs no escape unless it has a color
+	themeReset.len = snprintf(themeReset.seq, sizeof(themeReset.seq), bold || reverse ? "\x1b[m" : "\x1b[39m");
+	const themeColor& normal = themeColors[HL_NORMAL];
+	bool plain = normal.kind == THEME_COLOR_DEFAULT && !normal.bold && !normal.reverse;
+	themeRowStartId = plain ? themeSequences[HL_NORMAL].id : -1;
+}
+
+/*** loading ***/
+
+// takes word off the front of s when it is there, with the blanks after it
+static bool takeWord(const char** s, const char* word) {
+	size_t n = strlen(word);
+	if (strncmp(*s, word, n) != 0 || ((*s)[n] != ' ' && (*s)[n] != '\t'))
+		return false;
+	*s += n;
+	while (**s == ' ' || **s == '\t')
+		(*s)++;
+	return true;
+}
+
+static bool parseColor(const char* s, themeColor* c) {
+	c->bold = false;
+	c->reverse = false;
+	while (true) {
+		if (takeWord(&s, "bold"))
+			c->bold = true;
+		else if (takeWord(&s, "reverse"))
+			c->reverse = true;
+		else
+			break;
+	}
+	if (strcmp(s, "default") == 0) {
+		c->kind = THEME_COLOR_DEFAULT;
+		return true;
+	}
+	if (s[0] == '#' && strlen(s) == 7 && strspn(s + 1, "0123456789abcdefABCDEF") == 6) {
+		c->kind = THEME_COLOR_RGB;
+		c->value = static_cast<int>(strtol(s + 1, NULL, 16));
+		return true;
+	}
+	for (int i = 0; i < 16; i++) {
+		if (strcmp(s, ansiNames[i]) == 0) {
+			c->kind = THEME_COLOR_ANSI;
+			c->value = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void trim(std::string& s) {
+	size_t start = s.find_first_not_of(" \t\r");
+	size_t end = s.find_last_not_of(" \t\r");
+	s = start == std::string::npos ? std::string() : s.substr(start, end - start + 1);
+}
+
+// fills colors from theme text, classes it does not mention stay at the terminal default
+static bool parseTheme(const std::string& text, themeColor* colors) {
+	for (int i = 0; i < HL_CLASSES; i++)
+		colors[i] = {THEME_COLOR_DEFAULT, 0, false, i == HL_SELECTION || i == HL_BRACKET};
+	size_t at = 0;
+	while (at < text.size()) {
+		size_t nl = text.find('\n', at);
+		std::string line = text.substr(at, nl == std::string::npos ? std::string::npos : nl - at);
+		at = nl == std::string::npos ? text.size() : nl + 1;
+		trim(line);
+		if (line.empty() || line[0] == '#')
+			continue;
+		size_t eq = line.find('=');
+		if (eq == std::string::npos)
+			return false;
+		std::string name = line.substr(0, eq);
+		std::string value = line.substr(eq + 1);
+		trim(name);
+		trim(value);
+		int cls = -1;
+		for (int i = 0; i < HL_CLASSES; i++)
+			if (name == classNames[i])
+				cls = i;
+		if (cls < 0 || !parseColor(value.c_str(), &colors[cls]))
+			return false;
+	}
+	return true;
+}
+
+// loads a built-in theme by name or a theme file by path
+bool editorThemeLoad(const char* theme) {
+	std::string text;
+	bool found = false;
+	for (const auto& builtin : builtinThemes) {
+		if (strcmp(builtin[0], theme) == 0) {
+			text = builtin[1];
+			found = true;
+		}
+	}
+	if (!found) {
+		std::ifstream file(theme, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	themeColor colors[HL_CLASSES];
+	if (!parseTheme(text, colors))
+		return false;
+	memcpy(themeColors, colors, sizeof(colors));
+	themeName = theme;
+	buildSequences();
+	return true;
+}
+
+const char* editorThemeName() {
+	return themeName.c_str();
+}
+
+void editorSetColorDepth(colorDepth d) {
+	depth = d;
+	buildSequences();
+}
+
+colorDepth editorColorDepth() {
+	return depth;
+}
+
+// picks the depth from the environment and loads the default theme
+void editorThemeInit() {
+	depth = detectColorDepth();
+	editorThemeLoad(DEFAULT_THEME);
+}
@@ -0,0 +1,150 @@
+#include "editorTrace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*** rings ***/
+
+struct traceEvent {
+	const char* name;
+	long long start; // nanoseconds since tracing started
+	long long dur;
+};
+
+// Every thread writes its own ring, so recording never takes a lock. The dump reads the rings
+// from another thread and drops whatever the writer may have overwritten meanwhile.
+struct traceRing {
+	traceEvent events[TRACE_RING_EVENTS];
+	std::atomic<unsigned long long> head;
+	int tid;
+	const char* name;
+	traceRing* next;
+};
+
+static std::atomic<traceRing*> rings(nullptr);
+static std::atomic<int> nextTid(1);
+static std::atomic<bool> tracing(false);
+static thread_local traceRing* ownRing = nullptr;
+static std::chrono::steady_clock::time_point epoch;
+static char* tracePath = nullptr;
+
+// rings are never freed, a thread may still be writing to its ring when the dump runs
+static traceRing* threadRing() {
+	if (ownRing)
+		return ownRing;
+	traceRing* ring = new traceRing;
+	ring->head = 0;
+	ring->tid = nextTid++;
+	ring->name = nullptr;
+	ring->next = rings.load();
+	while (!rings.compare_exchange_weak(ring->next, ring))
+		;
+	ownRing = ring;
+	return ring;
+}
+
+long long editorTraceNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void editorTraceRecord(const char* name, long long start) {
+	long long end = editorTraceNow();
+	traceRing* ring = threadRing();
+	unsigned long long h = ring->head.load(std::memory_order_relaxed);
+	traceEvent* ev = &ring->events[h % TRACE_RING_EVENTS];
+	ev->name = name;
+	ev->start = start;
+	ev->dur = end - start;
+	ring->head.store(h + 1, std::memory_order_release);
+}
+
+/*** control ***/
+
+// starts recording, path is where the trace goes at exit
+bool editorTraceStart(const char* path) {
+	if (!KILO_TRACE)
+		return false;
+	free(tracePath);
+	tracePath = strdup(path);
+	epoch = std::chrono::steady_clock::now();
+	tracing = true;
+	editorTraceThread("main");
+	return true;
+}
+
+bool editorTracing() {
+	return tracing.load(std::memory_order_relaxed);
+}
+
+const char* editorTracePath() {
+	return tracePath;
+}
+
+// names the calling thread in the trace viewer
+void editorTraceThread(const char* name) {
+	if (editorTracing())
+		threadRing()->name = name;
+}
+
+static void jsonName(FILE* out, const char* s) {
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', out);
+		fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+// writes every event still in the rings, can be called while recording goes on
+bool editorTraceDump(const char* path) {
+	FILE* out = fopen(path, "w");
+	if (out == NULL)
+		return false;
+
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	const char* sep = "";
+	std::vector<traceEvent> events;
+	for (traceRing* ring = rings.load(); ring; ring = ring->next) {
+		if (ring->name) {
+			fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": ", sep,
+					ring->tid);
+			jsonName(out, ring->name);
+			fprintf(out, "}}");
+			sep = ",\n";
+		}
+
+		unsigned long long head = ring->head.load(std::memory_order_acquire);
+		unsigned long long first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+		events.clear();
+		for (unsigned long long i = first; i < head; i++)
+			events.push_back(ring->events[i % TRACE_RING_EVENTS]);
+		// anything the writer got to while we copied may be torn, and once the ring has wrapped so may the
+		// slot it is writing now, which is not published yet
+		unsigned long long now = ring->head.load(std::memory_order_acquire);
+		unsigned long long torn = now - head + (head >= TRACE_RING_EVENTS ? 1 : 0);
+		size_t skip = torn < events.size() ? static_cast<size_t>(torn) : events.size();
+
+		for (size_t i = skip; i < events.size(); i++) {
+			fprintf(out, "%s{\"name\": ", sep);
+			jsonName(out, events[i].name);
+			fprintf(out, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}", ring->tid,
+					events[i].start / 1e3, events[i].dur / 1e3);
+			sep = ",\n";
+		}
+	}
+	fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
+
+// writes the trace to the path given at start and stops recording
+void editorTraceStop() {
+	if (!editorTracing() || tracePath == nullptr)
+		return;
+	tracing = false;
+	if (!editorTraceDump(tracePath))
+		fprintf(stderr, "Cannot write %s\n", tracePath);
+}
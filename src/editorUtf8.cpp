@@ -0,0 +1,342 @@
+#include "editorUtf8.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define UTF8_NEON 1
+#endif
+
+/*** ascii scan ***/
+
+static inline int lowestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return static_cast<int>(idx);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Number of leading bytes of s below 0x80 and other than stop. Nearly every row of source code is
+// ASCII all the way, so this is what decides how much the UTF-8 handling costs: 16 bytes a step
+// where the CPU has vectors, 8 bytes as a word otherwise.
+int utf8SkipPlain(const char* s, int n, char stop) {
+	int i = 0;
+#if defined(UTF8_SSE2)
+	__m128i stops = _mm_set1_epi8(stop);
+	// a byte is interesting when its top bit is set, a matched stop becomes 0xff so it is too
+	for (; i + 64 <= n; i += 64) {
+		const __m128i* q = reinterpret_cast<const __m128i*>(s + i);
+		__m128i a = _mm_loadu_si128(q), b = _mm_loadu_si128(q + 1);
+		__m128i c = _mm_loadu_si128(q + 2), d = _mm_loadu_si128(q + 3);
+		a = _mm_or_si128(a, _mm_cmpeq_epi8(a, stops));
+		b = _mm_or_si128(b, _mm_cmpeq_epi8(b, stops));
+		c = _mm_or_si128(c, _mm_cmpeq_epi8(c, stops));
+		d = _mm_or_si128(d, _mm_cmpeq_epi8(d, stops));
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))))
+			break;
+	}
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, stops))));
+		if (mask)
+			return i + lowestBit(mask);
+	}
+#elif defined(UTF8_NEON)
+	uint8x16_t stops = vdupq_n_u8(static_cast<uint8_t>(stop));
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i));
+		if (vmaxvq_u8(v) >= 0x80 || vmaxvq_u8(vceqq_u8(v, stops)))
+			break;
+	}
+#else
+	uint64_t stops = 0x0101010101010101ULL * static_cast<unsigned char>(stop);
+	for (; i + 8 <= n; i += 8) {
+		uint64_t word;
+		memcpy(&word, s + i, 8);
+		uint64_t same = word ^ stops;
+		// the classic has-zero-byte test finds a byte equal to stop
+		if ((word | ((same - 0x0101010101010101ULL) & ~same)) & 0x8080808080808080ULL)
+			break;
+	}
+#endif
+	while (i < n && static_cast<unsigned char>(s[i]) < 0x80 && s[i] != stop)
+		i++;
+	return i;
+}
+
+int utf8AsciiPrefix(const char* s, int n) {
+	// 0xff is never ASCII, stopping at it as well changes nothing
+	return utf8SkipPlain(s, n, '\xff');
+}
+
+bool utf8IsAscii(const char* s, int n) {
+	return utf8AsciiPrefix(s, n) == n;
+}
+
+/*** decoding ***/
+
+// Decodes the character at s, returns its length in bytes. Overlong forms, surrogates, values past
+// U+10FFFF and cut off sequences are not characters: *cp is -1 for those and only one byte is used,
+// so a stray byte never swallows the text after it.
+int utf8Decode(const char* s, int n, int* cp) {
+	const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+	unsigned char c = u[0];
+	if (c < 0x80) {
+		*cp = c;
+		return 1;
+	}
+	int len;
+	int value;
+	int min;
+	if (c >= 0xc2 && c <= 0xdf) {
+		len = 2;
+		value = c & 0x1f;
+		min = 0x80;
+	} else if (c >= 0xe0 && c <= 0xef) {
+		len = 3;
+		value = c & 0x0f;
+		min = 0x800;
+	} else if (c >= 0xf0 && c <= 0xf4) {
+		len = 4;
+		value = c & 0x07;
+		min = 0x10000;
+	} else {
+		*cp = -1;
+		return 1;
+	}
+	if (len > n) {
+		*cp = -1;
+		return 1;
+	}
+	for (int i = 1; i < len; i++) {
+		if ((u[i] & 0xc0) != 0x80) {
+			*cp = -1;
+			return 1;
+		}
+		value = (value << 6) | (u[i] & 0x3f);
+	}
+	if (value < min || value > 0x10ffff || (value >= 0xd800 && value <= 0xdfff)) {
+		*cp = -1;
+		return 1;
+	}
+	*cp = value;
+	return len;
+}
+
+// writes cp as UTF-8, returns the number of bytes, at most 4
+int utf8Encode(int cp, char* out) {
+	if (cp < 0x80) {
+		out[0] = static_cast<char>(cp);
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = static_cast<char>(0xc0 | (cp >> 6));
+		out[1] = static_cast<char>(0x80 | (cp & 0x3f));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = static_cast<char>(0xe0 | (cp >> 12));
+		out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+		out[2] = static_cast<char>(0x80 | (cp & 0x3f));
+		return 3;
+	}
+	out[0] = static_cast<char>(0xf0 | (cp >> 18));
+	out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+	out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+	out[3] = static_cast<char>(0x80 | (cp & 0x3f));
+	return 4;
+}
+
+// whether all of s is well formed UTF-8, the ASCII stretches are skipped a vector at a time
+bool utf8Valid(const char* s, int n) {
+	int i = 0;
+	while (i < n) {
+		i += utf8AsciiPrefix(s + i, n - i);
+		if (i >= n)
+			break;
+		int cp;
+		i += utf8Decode(s + i, n - i, &cp);
+		if (cp < 0)
+			return false;
+	}
+	return true;
+}
+
+/*** width ***/
+
+struct codeRange {
+	int first;
+	int last;
+};
+
+// marks that draw on top of the character before them, and the invisible format characters
+static const codeRange zeroWidth[] = {
+	{0x0300, 0x036f},	{0x0483, 0x0489},	{0x0591, 0x05bd},	{0x05bf, 0x05bf},	{0x05c1, 0x05c2},
+	{0x05c4, 0x05c5},	{0x05c7, 0x05c7},	{0x0610, 0x061a},	{0x064b, 0x065f},	{0x0670, 0x0670},
+	{0x06d6, 0x06dc},	{0x06df, 0x06e4},	{0x06e7, 0x06e8},	{0x06ea, 0x06ed},	{0x0711, 0x0711},
+	{0x0730, 0x074a},	{0x07a6, 0x07b0},	{0x07eb, 0x07f3},	{0x0816, 0x082d},	{0x0859, 0x085b},
+	{0x08d3, 0x0902},	{0x093a, 0x093a},	{0x093c, 0x093c},	{0x0941, 0x0948},	{0x094d, 0x094d},
+	{0x0951, 0x0957},	{0x0962, 0x0963},	{0x0981, 0x0981},	{0x09bc, 0x09bc},	{0x09c1, 0x09c4},
+	{0x09cd, 0x09cd},	{0x09e2, 0x09e3},	{0x0a01, 0x0a02},	{0x0a3c, 0x0a3c},	{0x0a41, 0x0a51},
+	{0x0a70, 0x0a71},	{0x0a81, 0x0a82},	{0x0abc, 0x0abc},	{0x0ac1, 0x0ac8},	{0x0acd, 0x0acd},
+	{0x0b01, 0x0b01},	{0x0b3c, 0x0b3c},	{0x0b41, 0x0b44},	{0x0b4d, 0x0b4d},	{0x0bc0, 0x0bc0},
+	{0x0bcd, 0x0bcd},	{0x0c3e, 0x0c40},	{0x0c46, 0x0c56},	{0x0cbc, 0x0cbc},	{0x0ccc, 0x0ccd},
+	{0x0d41, 0x0d44},	{0x0d4d, 0x0d4d},	{0x0dca, 0x0dca},	{0x0dd2, 0x0dd6},	{0x0e31, 0x0e31},
+	{0x0e34, 0x0e3a},	{0x0e47, 0x0e4e},	{0x0eb1, 0x0eb1},	{0x0eb4, 0x0ebc},	{0x0ec8, 0x0ecd},
+	{0x0f18, 0x0f19},	{0x0f35, 0x0f35},	{0x0f37, 0x0f37},	{0x0f39, 0x0f39},	{0x0f71, 0x0f7e},
+	{0x0f80, 0x0f84},	{0x0f86, 0x0f87},	{0x0f8d, 0x0fbc},	{0x102d, 0x1030},	{0x1032, 0x1037},
+	{0x1039, 0x103a},	{0x1160, 0x11ff},	{0x135d, 0x135f},	{0x1712, 0x1714},	{0x17b4, 0x17b5},
+	{0x17b7, 0x17bd},	{0x17c6, 0x17c6},	{0x17c9, 0x17d3},	{0x180b, 0x180f},	{0x1ab0, 0x1aff},
+	{0x1dc0, 0x1dff},	{0x200b, 0x200f},	{0x202a, 0x202e},	{0x2060, 0x2064},	{0x20d0, 0x20f0},
+	{0x2cef, 0x2cf1},	{0x2de0, 0x2dff},	{0x302a, 0x302d},	{0x3099, 0x309a},	{0xa66f, 0xa672},
+	{0xa674, 0xa67d},	{0xa69e, 0xa69f},	{0xa8e0, 0xa8f1},	{0xfe00, 0xfe0f},	{0xfe20, 0xfe2f},
+	{0xfeff, 0xfeff},	{0x1f3fb, 0x1f3ff}, {0xe0000, 0xe0fff},
+};
+
+// East Asian wide and fullwidth characters, and the emoji terminals draw two cells wide
+static const codeRange doubleWidth[] = {
+	{0x1100, 0x115f},	{0x231a, 0x231b},	{0x2329, 0x232a},	{0x23e9, 0x23ec},	{0x23f0, 0x23f0},
+	{0x23f3, 0x23f3},	{0x25fd, 0x25fe},	{0x2614, 0x2615},	{0x2648, 0x2653},	{0x267f, 0x267f},
+	{0x2693, 0x2693},	{0x26a1, 0x26a1},	{0x26aa, 0x26ab},	{0x26bd, 0x26be},	{0x26c4, 0x26c5},
+	{0x26ce, 0x26ce},	{0x26d4, 0x26d4},	{0x26ea, 0x26ea},	{0x26f2, 0x26f3},	{0x26f5, 0x26f5},
+	{0x26fa, 0x26fa},	{0x26fd, 0x26fd},	{0x2705, 0x2705},	{0x270a, 0x270b},	{0x2728, 0x2728},
+	{0x274c, 0x274c},	{0x274e, 0x274e},	{0x2753, 0x2755},	{0x2757, 0x2757},	{0x2795, 0x2797},
+	{0x27b0, 0x27b0},	{0x27bf, 0x27bf},	{0x2b1b, 0x2b1c},	{0x2b50, 0x2b50},	{0x2b55, 0x2b55},
+	{0x2e80, 0x303e},	{0x3041, 0x33ff},	{0x3400, 0x4dbf},	{0x4e00, 0x9fff},	{0xa000, 0xa4cf},
+	{0xa960, 0xa97f},	{0xac00, 0xd7a3},	{0xf900, 0xfaff},	{0xfe10, 0xfe19},	{0xfe30, 0xfe6f},
+	{0xff00, 0xff60},	{0xffe0, 0xffe6},	{0x16fe0, 0x16fe4}, {0x17000, 0x18cff}, {0x1b000, 0x1b2ff},
+	{0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf}, {0x1f18e, 0x1f18e}, {0x1f191, 0x1f19a}, {0x1f200, 0x1f202},
+	{0x1f210, 0x1f23b}, {0x1f240, 0x1f248}, {0x1f250, 0x1f251}, {0x1f260, 0x1f265}, {0x1f300, 0x1f320},
+	{0x1f32d, 0x1f335}, {0x1f337, 0x1f37c}, {0x1f37e, 0x1f393}, {0x1f3a0, 0x1f3ca}, {0x1f3cf, 0x1f3d3},
+	{0x1f3e0, 0x1f3f0}, {0x1f3f4, 0x1f3f4}, {0x1f3f8, 0x1f3fa}, {0x1f400, 0x1f43e}, {0x1f440, 0x1f440},
+	{0x1f442, 0x1f4fc}, {0x1f4ff, 0x1f53d}, {0x1f54b, 0x1f54e}, {0x1f550, 0x1f567}, {0x1f57a, 0x1f57a},
+	{0x1f595, 0x1f596}, {0x1f5a4, 0x1f5a4}, {0x1f5fb, 0x1f64f}, {0x1f680, 0x1f6c5}, {0x1f6cc, 0x1f6cc},
+	{0x1f6d0, 0x1f6d2}, {0x1f6d5, 0x1f6d7}, {0x1f6eb, 0x1f6ec}, {0x1f6f4, 0x1f6fc}, {0x1f7e0, 0x1f7eb},
+	{0x1f90c, 0x1f93a}, {0x1f93c, 0x1f945}, {0x1f947, 0x1f9ff}, {0x1fa70, 0x1faff}, {0x20000, 0x2fffd},
+	{0x30000, 0x3fffd},
+};
+
+static bool inRanges(const codeRange* ranges, int count, int cp) {
+	if (cp < ranges[0].first || cp > ranges[count - 1].last)
+		return false;
+	int lo = 0;
+	int hi = count - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (cp > ranges[mid].last)
+			lo = mid + 1;
+		else if (cp < ranges[mid].first)
+			hi = mid - 1;
+		else
+			return true;
+	}
+	return false;
+}
+
+#define RANGES(table) table, static_cast<int>(sizeof(table) / sizeof(table[0]))
+
+// Terminal cells taken by cp. Control characters are drawn as one inverse symbol, like a byte that
+// is not UTF-8 (cp == -1), so they count one.
+int utf8Width(int cp) {
+	if (cp < 0x300)
+		return 1;
+	if (inRanges(RANGES(zeroWidth), cp))
+		return 0;
+	if (inRanges(RANGES(doubleWidth), cp))
+		return 2;
+	return 1;
+}
+
+// whether the terminal can be sent cp as it is, the C1 controls and broken bytes are drawn as symbols
+bool utf8Printable(int cp) {
+	return cp >= 0xa0 || (cp >= 0x20 && cp < 0x7f);
+}
+
+/*** grapheme clusters ***/
+
+static bool regionalIndicator(int cp) {
+	return cp >= 0x1f1e6 && cp <= 0x1f1ff;
+}
+
+// A cluster is what the cursor steps over as one: a character with the marks, variation selectors
+// and skin tones after it, emoji joined by ZWJ, and pairs of regional indicators (flags). The full
+// Unicode rules also know Hangul jamo and Indic conjuncts, which the widths above already handle
+// well enough for an editor.
+int utf8NextCluster(const char* s, int n, int at) {
+	if (at >= n)
+		return n;
+	// plain ASCII followed by ASCII, the common case
+	if (static_cast<unsigned char>(s[at]) < 0x80 && (at + 1 >= n || static_cast<unsigned char>(s[at + 1]) < 0x80))
+		return at + 1;
+
+	int cp;
+	int i = at + utf8Decode(s + at, n - at, &cp);
+	if (cp < 0)
+		return i;
+	bool flag = regionalIndicator(cp);
+	while (i < n) {
+		int next;
+		int len = utf8Decode(s + i, n - i, &next);
+		if (next < 0)
+			break;
+		bool extends = (next >= 0x300 && utf8Width(next) == 0) || cp == UTF8_ZWJ;
+		if (!extends && !(flag && regionalIndicator(next)))
+			break;
+		flag = false;
+		cp = next;
+		i += len;
+	}
+	return i;
+}
+
+// start of the character before at, a stray continuation byte counts as a character of its own
+static int prevChar(const char* s, int at) {
+	int p = at - 1;
+	int steps = 0;
+	while (p > 0 && steps < 3 && (static_cast<unsigned char>(s[p]) & 0xc0) == 0x80) {
+		p--;
+		steps++;
+	}
+	int cp;
+	if (p + utf8Decode(s + p, at - p, &cp) == at)
+		return p;
+	return at - 1;
+}
+
+// start of the cluster that ends at at. Clusters are defined going forward, so this backs up to a
+// character that surely starts one and walks forward from there
+int utf8PrevCluster(const char* s, int n, int at) {
+	if (at <= 0)
+		return 0;
+	if (at > n)
+		at = n;
+	if (static_cast<unsigned char>(s[at - 1]) < 0x80 && (at >= n || static_cast<unsigned char>(s[at]) < 0x80))
+		return at - 1;
+
+	int start = prevChar(s, at);
+	while (start > 0) {
+		int cp;
+		utf8Decode(s + start, n - start, &cp);
+		int before = prevChar(s, start);
+		int prev;
+		utf8Decode(s + before, n - before, &prev);
+		bool joined = (cp >= 0x300 && utf8Width(cp) == 0) || prev == UTF8_ZWJ ||
+					  (regionalIndicator(cp) && regionalIndicator(prev));
+		if (!joined)
+			break;
+		start = before;
+	}
+	int cluster = start;
+	for (;;) {
+		int next = utf8NextCluster(s, n, cluster);
+		if (next >= at)
+			return cluster;
+		cluster = next;
+	}
+}
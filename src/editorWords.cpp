@@ -0,0 +1,500 @@
+#include "editorWords.hpp"
+#include "editorMem.hpp"
+#include "editorTrace.hpp"
+#include <cstring>
+#include <queue>
+
+/*** index ***/
+
+// A node of the trie over the identifiers of a buffer, node 0 is the root. Children hang off their
+// parent as a list through sibling, a node is the identifier spelled by the bytes on its way up.
+struct wordNode {
+	unsigned int child;	  // first child, 0 for none
+	unsigned int sibling; // next child of the same parent
+	unsigned int parent;
+	unsigned int count;	  // times the identifier ending here appears in the buffer
+	unsigned int best;	  // no count below this node is higher, raised as counts grow and lowered by lookups
+	unsigned int hash;	  // of the identifier ending here, set once it is in the table
+	unsigned char byte;
+	unsigned char len;	  // depth, the length of the identifier
+};
+
+// Nodes live in one array and are never removed: an identifier that is gone keeps its node with a
+// count of zero, which is also what makes the ids in the rows stable. The table finds the node of a
+// whole identifier without walking the trie down from the root.
+struct wordIndex {
+	wordNode* nodes;
+	unsigned int nnodes;
+	unsigned int cap;
+	unsigned int* table; // node ids, open addressing, 0 for an empty slot
+	unsigned int mask;
+	unsigned int used;
+	bool stale; // some row has words_stale set
+};
+
+// eight bytes at a time, identifiers are short and this runs for every one the highlighter passes
+static unsigned int hashWord(const char* s, int len) {
+	unsigned long long h = static_cast<unsigned long long>(len) * 0x9E3779B97F4A7C15ull;
+	for (int i = 0; i < len; i += 8) {
+		unsigned long long w = 0;
+		memcpy(&w, s + i, len - i < 8 ? len - i : 8);
+		h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 31;
+	}
+	return static_cast<unsigned int>(h ^ (h >> 32));
+}
+
+static wordIndex* newIndex() {
+	wordIndex* ix = static_cast<wordIndex*>(memAlloc(MEM_WORDS, sizeof(wordIndex)));
+	ix->cap = 1024;
+	ix->nodes = static_cast<wordNode*>(memAlloc(MEM_WORDS, sizeof(wordNode) * ix->cap));
+	memset(&ix->nodes[0], 0, sizeof(wordNode));
+	ix->nnodes = 1;
+	ix->mask = 1023;
+	ix->table = static_cast<unsigned int*>(memAlloc(MEM_WORDS, sizeof(unsigned int) * (ix->mask + 1)));
+	memset(ix->table, 0, sizeof(unsigned int) * (ix->mask + 1));
+	ix->used = 0;
+	ix->stale = false;
+	return ix;
+}
+
+// rows taken out of the buffer in bulk, their identifiers are let go of a slice at a time
+struct wordRelease {
+	wordIndex* index;
+	erow* rows;
+	int n; // rows still counted, from the front
+};
+
+static std::vector<wordRelease> releases;
+
+void editorWordsFree(wordIndex* ix) {
+	if (ix == NULL)
+		return;
+	for (size_t i = releases.size(); i-- > 0;)
+		if (releases[i].index == ix)
+			releases.erase(releases.begin() + i);
+	memFree(MEM_WORDS, ix->nodes);
+	memFree(MEM_WORDS, ix->table);
+	memFree(MEM_WORDS, ix);
+}
+
+static void growTable(wordIndex* ix) {
+	unsigned int mask = ix->mask * 2 + 1;
+	unsigned int* table = static_cast<unsigned int*>(memAlloc(MEM_WORDS, sizeof(unsigned int) * (mask + 1)));
+	memset(table, 0, sizeof(unsigned int) * (mask + 1));
+	for (unsigned int i = 0; i <= ix->mask; i++) {
+		unsigned int id = ix->table[i];
+		if (id == 0)
+			continue;
+		unsigned int j = ix->nodes[id].hash & mask;
+		while (table[j])
+			j = (j + 1) & mask;
+		table[j] = id;
+	}
+	memFree(MEM_WORDS, ix->table);
+	ix->table = table;
+	ix->mask = mask;
+}
+
+// the child of parent for byte c, added when create is set, 0 when there is none
+static unsigned int childOf(wordIndex* ix, unsigned int parent, unsigned char c, bool create) {
+	for (unsigned int k = ix->nodes[parent].child; k; k = ix->nodes[k].sibling)
+		if (ix->nodes[k].byte == c)
+			return k;
+	if (!create)
+		return 0;
+	if (ix->nnodes == ix->cap) {
+		ix->cap *= 2;
+		ix->nodes = static_cast<wordNode*>(memRealloc(MEM_WORDS, ix->nodes, sizeof(wordNode) * ix->cap));
+	}
+	unsigned int id = ix->nnodes++;
+	wordNode* node = &ix->nodes[id];
+	memset(node, 0, sizeof(wordNode));
+	node->parent = parent;
+	node->byte = c;
+	node->len = ix->nodes[parent].len + 1;
+	node->sibling = ix->nodes[parent].child;
+	ix->nodes[parent].child = id;
+	return id;
+}
+
+// whether node id spells s, compared from the end up
+static bool spells(const wordIndex* ix, unsigned int id, const char* s, int len) {
+	for (int i = len - 1; i >= 0; i--) {
+		if (ix->nodes[id].byte != static_cast<unsigned char>(s[i]))
+			return false;
+		id = ix->nodes[id].parent;
+	}
+	return true;
+}
+
+// the table slot of identifier s, or the empty slot it would go in
+static unsigned int findSlot(const wordIndex* ix, const char* s, int len, unsigned int h) {
+	unsigned int i = h & ix->mask;
+	for (; ix->table[i]; i = (i + 1) & ix->mask) {
+		unsigned int id = ix->table[i];
+		const wordNode* node = &ix->nodes[id];
+		if (node->hash == h && node->len == len && spells(ix, id, s, len))
+			break;
+	}
+	return i;
+}
+
+// the node of identifier s, added to the trie and the table the first time it is seen
+static unsigned int intern(wordIndex* ix, const char* s, int len) {
+	if ((ix->used + 1) * 2 > ix->mask)
+		growTable(ix);
+	unsigned int h = hashWord(s, len);
+	unsigned int i = findSlot(ix, s, len, h);
+	if (ix->table[i])
+		return ix->table[i];
+	unsigned int id = 0;
+	for (int k = 0; k < len; k++)
+		id = childOf(ix, id, static_cast<unsigned char>(s[k]), true);
+	ix->nodes[id].hash = h;
+	ix->table[i] = id;
+	ix->used++;
+	return id;
+}
+
+// a count going up raises the bounds above it, one going down leaves them high for a lookup to fix
+static void countWord(wordIndex* ix, unsigned int id, int delta) {
+	if (delta < 0) {
+		ix->nodes[id].count--;
+		return;
+	}
+	unsigned int count = ++ix->nodes[id].count;
+	for (unsigned int k = id;; k = ix->nodes[k].parent) {
+		if (ix->nodes[k].best >= count)
+			break;
+		ix->nodes[k].best = count;
+		if (k == 0)
+			break;
+	}
+}
+
+/*** indexing rows ***/
+
+// what an identifier is made of, bytes of multibyte characters included
+struct wordBytes {
+	bool in[256];
+};
+
+static constexpr wordBytes makeWordBytes() {
+	wordBytes t = {};
+	for (int c = 0; c < 256; c++)
+		t.in[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+	return t;
+}
+
+static constexpr wordBytes wordTable = makeWordBytes();
+
+static inline bool wordByte(unsigned char c) {
+	return wordTable.in[c];
+}
+
+// the highlight classes an identifier can be in, strings, comments and numbers are not looked at
+#define WORD_CLASSES ((1u << HL_NORMAL) | (1u << HL_KEYWORD1) | (1u << HL_KEYWORD2))
+
+// the row being indexed, between editorWordsBegin and editorWordsEnd
+static struct {
+	bool on;
+	int start; // first character of the identifier being read, -1 between identifiers
+	std::vector<unsigned int> ids;
+} scan;
+
+// buffers that are only read from are not indexed, there is nothing to complete in them
+void editorWordsBegin(erow* row) {
+	(void)row;
+	scan.on = !E.readonly;
+	if (!scan.on)
+		return;
+	if (E.words == NULL)
+		E.words = newIndex();
+	scan.start = -1;
+	scan.ids.clear();
+}
+
+static void addWord(const erow* row, int start, int end) {
+	int len = end - start;
+	if (len < WORDS_MIN_LEN || len > WORDS_MAX_LEN)
+		return;
+	if (row->chars[start] >= '0' && row->chars[start] <= '9')
+		return;
+	scan.ids.push_back(intern(E.words, &row->chars[start], len));
+}
+
+// cls holds the class of each character in [from, to), an identifier can go on into the next piece
+void editorWordsScan(const erow* row, int from, int to, const unsigned char* cls) {
+	if (!scan.on)
+		return;
+	const unsigned char* chars = reinterpret_cast<const unsigned char*>(row->chars);
+	int start = scan.start;
+	for (int j = from; j < to; j++) {
+		bool word = wordByte(chars[j]) && ((1u << cls[j - from]) & WORD_CLASSES);
+		if (word && start < 0) {
+			start = j;
+		} else if (!word && start >= 0) {
+			addWord(row, start, j);
+			start = -1;
+		}
+	}
+	scan.start = start;
+}
+
+// counts what the row has now and stops counting what it had before
+void editorWordsEnd(erow* row) {
+	if (!scan.on)
+		return;
+	scan.on = false;
+	if (scan.start >= 0)
+		addWord(row, scan.start, row->size);
+	row->words_stale = false;
+
+	int n = static_cast<int>(scan.ids.size());
+	if (n == row->nwords && (n == 0 || memcmp(scan.ids.data(), row->words, sizeof(unsigned int) * n) == 0))
+		return;
+	for (int i = 0; i < n; i++)
+		countWord(E.words, scan.ids[i], 1);
+	for (int i = 0; i < row->nwords; i++)
+		countWord(E.words, row->words[i], -1);
+	if (n == 0) {
+		memFree(MEM_WORDS, row->words);
+		row->words = NULL;
+	} else {
+		row->words = static_cast<unsigned int*>(memRealloc(MEM_WORDS, row->words, sizeof(unsigned int) * n));
+		memcpy(row->words, scan.ids.data(), sizeof(unsigned int) * n);
+	}
+	row->nwords = n;
+}
+
+static void releaseRow(wordIndex* ix, erow* row) {
+	for (int i = 0; i < row->nwords; i++)
+		countWord(ix, row->words[i], -1);
+	row->nwords = 0;
+}
+
+// a row leaving the buffer stops counting, its array goes when the row is freed
+void editorWordsRelease(erow* row) {
+	releaseRow(E.words, row);
+}
+
+// Rows leaving together, like a cut, which would otherwise cost a visit to every row the cut itself
+// never has to touch. Until editorWordsIdle gets to them they still count, a lookup catches up first.
+void editorWordsReleaseRows(erow* rows, int n) {
+	if (E.words == NULL || n <= 0)
+		return;
+	if (n <= RETIRED_ROWS_SLICE) {
+		for (int i = 0; i < n; i++)
+			releaseRow(E.words, &rows[i]);
+		return;
+	}
+	releases.push_back({E.words, rows, n});
+}
+
+// releases up to budget rows from the end of r, returns how many
+static int releaseSlice(wordRelease* r, int budget) {
+	int done = 0;
+	while (r->n > 0 && done < budget) {
+		releaseRow(r->index, &r->rows[--r->n]);
+		done++;
+	}
+	return done;
+}
+
+// a slice of the rows waiting to be released, returns true while some are left
+bool editorWordsIdle() {
+	int budget = RETIRED_ROWS_SLICE;
+	while (!releases.empty() && budget > 0) {
+		budget -= releaseSlice(&releases.back(), budget);
+		if (releases.back().n == 0)
+			releases.pop_back();
+	}
+	return !releases.empty();
+}
+
+// rows in [from, to) are about to be freed, whatever of them is still counted is released now
+void editorWordsSettle(const erow* from, const erow* to) {
+	for (size_t i = releases.size(); i-- > 0;) {
+		if (releases[i].rows < from || releases[i].rows >= to)
+			continue;
+		releaseSlice(&releases[i], releases[i].n);
+		releases.erase(releases.begin() + i);
+	}
+}
+
+// the row changed but still counts what it had, editorWordsFlush indexes it again
+void editorWordsStale(erow* row) {
+	if (E.words == NULL || E.readonly)
+		return;
+	row->words_stale = true;
+	E.words->stale = true;
+}
+
+// brings the index of the shown buffer up to date before a lookup
+void editorWordsFlush() {
+	if (E.words == NULL)
+		return;
+	for (size_t i = releases.size(); i-- > 0;) {
+		if (releases[i].index != E.words)
+			continue;
+		releaseSlice(&releases[i], releases[i].n);
+		releases.erase(releases.begin() + i);
+	}
+	if (!E.words->stale)
+		return;
+	TRACE_SCOPE("editorWordsFlush");
+	for (int i = 0; i < E.numrows; i++)
+		if (E.row[i].words_stale)
+			editorRowIndexWords(&E.row[i]);
+	E.words->stale = false;
+}
+
+/*** lookup ***/
+
+// a node still to be looked into or an identifier ready to be handed out, by the count it may reach
+struct wordPending {
+	unsigned int bound;
+	unsigned int id;
+	bool word;
+};
+
+// Highest bound first; an identifier comes before a subtree with the same bound, since nothing in
+// there can beat it. Ties go to the older node so the order stays the same between lookups.
+struct wordPendingOrder {
+	bool operator()(const wordPending& a, const wordPending& b) const {
+		if (a.bound != b.bound)
+			return a.bound < b.bound;
+		if (a.word != b.word)
+			return b.word;
+		return a.id > b.id;
+	}
+};
+
+static std::string spell(const wordIndex* ix, unsigned int id) {
+	char buf[WORDS_MAX_LEN];
+	int len = ix->nodes[id].len;
+	for (int i = len - 1; i >= 0; i--) {
+		buf[i] = static_cast<char>(ix->nodes[id].byte);
+		id = ix->nodes[id].parent;
+	}
+	return std::string(buf, len);
+}
+
+// Best first through the subtree of the prefix: an identifier is handed out once no bound left in the
+// queue is above its count, so the first max out are the top ones without looking at the rest. Bounds
+// left high by counts that went down are brought back to the truth as nodes are opened.
+// self is the identifier being completed when the cursor is inside one, it is counted once less.
+int editorWordsComplete(const char* prefix, int len, const char* self, int selfLen, std::vector<std::string>& out,
+						int max) {
+	out.clear();
+	wordIndex* ix = E.words;
+	if (ix == NULL || len <= 0 || len >= WORDS_MAX_LEN)
+		return 0;
+	unsigned int skip = 0;
+	if (selfLen > len && selfLen <= WORDS_MAX_LEN)
+		skip = ix->table[findSlot(ix, self, selfLen, hashWord(self, selfLen))];
+	unsigned int top = 0;
+	for (int i = 0; i < len; i++) {
+		top = childOf(ix, top, static_cast<unsigned char>(prefix[i]), false);
+		if (top == 0)
+			return 0;
+	}
+
+	std::priority_queue<wordPending, std::vector<wordPending>, wordPendingOrder> queue;
+	queue.push({ix->nodes[top].best, top, false});
+	while (!queue.empty() && static_cast<int>(out.size()) < max) {
+		wordPending p = queue.top();
+		queue.pop();
+		if (p.word) {
+			out.push_back(spell(ix, p.id));
+			continue;
+		}
+		wordNode* node = &ix->nodes[p.id];
+		unsigned int best = node->count;
+		unsigned int count = p.id == top ? 0 : node->count;
+		if (p.id == skip && count > 0)
+			count--;
+		if (count > 0)
+			queue.push({count, p.id, true});
+		for (unsigned int k = node->child; k; k = ix->nodes[k].sibling) {
+			unsigned int bound = ix->nodes[k].best;
+			if (bound == 0)
+				continue;
+			queue.push({bound, k, false});
+			if (bound > best)
+				best = bound;
+		}
+		node->best = best;
+	}
+	return static_cast<int>(out.size());
+}
+
+/*** completion ***/
+
+// what the last completion put in, so pressing the key again right after it swaps in the next one
+static struct {
+	wordIndex* index; // of the buffer it was in
+	int cy;
+	int start; // where the identifier starts
+	int typed; // bytes of it that were typed, the rest came from the candidate
+	int end;
+	int dirty; // E.dirty right after, any other edit in between starts over
+	int pick;
+	std::vector<std::string> candidates;
+} last;
+
+static void insertText(erow* row, int at, const char* s, int len) {
+	row->chars = static_cast<char*>(memRealloc(MEM_CHARS, row->chars, row->size + len + 1));
+	memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+	memcpy(&row->chars[at], s, len);
+	row->size += len;
+	editorRowChanged(row, at, len);
+	E.dirty++;
+}
+
+// Ctrl-N, completes the identifier in front of the cursor with the most frequent one in the buffer that
+// starts with it, again right after to go through the others
+void editorComplete() {
+	if (E.cy >= E.numrows)
+		return;
+	erow* row = &E.row[E.cy];
+	bool again = last.index == E.words && last.index != NULL && last.cy == E.cy && last.end == E.cx &&
+				 last.dirty == E.dirty && last.end <= row->size && !last.candidates.empty();
+	if (again) {
+		editorRowDelChars(row, last.start + last.typed, last.end - last.start - last.typed);
+		last.pick = (last.pick + 1) % static_cast<int>(last.candidates.size());
+	} else {
+		int start = E.cx;
+		while (start > 0 && wordByte(static_cast<unsigned char>(row->chars[start - 1])))
+			start--;
+		if (start == E.cx || (row->chars[start] >= '0' && row->chars[start] <= '9')) {
+			editorSetStatusMessage("Nothing to complete");
+			return;
+		}
+		// completing in the middle of an identifier must not offer that same identifier back
+		int end = E.cx;
+		while (end < row->size && wordByte(static_cast<unsigned char>(row->chars[end])))
+			end++;
+		editorWordsFlush();
+		editorWordsComplete(&row->chars[start], E.cx - start, &row->chars[start], end - start, last.candidates,
+							WORDS_MAX_CANDIDATES);
+		if (last.candidates.empty()) {
+			editorSetStatusMessage("No completions for \"%.*s\"", E.cx - start, &row->chars[start]);
+			last.index = NULL;
+			return;
+		}
+		last.index = E.words;
+		last.cy = E.cy;
+		last.start = start;
+		last.typed = E.cx - start;
+		last.pick = 0;
+	}
+
+	const std::string& word = last.candidates[last.pick];
+	insertText(row, last.start + last.typed, word.data() + last.typed, static_cast<int>(word.size()) - last.typed);
+	last.end = last.start + static_cast<int>(word.size());
+	last.dirty = E.dirty;
+	E.cx = last.end;
+	editorSetStatusMessage("Completion %d of %d", last.pick + 1, static_cast<int>(last.candidates.size()));
+}
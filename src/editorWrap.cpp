@@ -0,0 +1,266 @@
+#include "editorWrap.hpp"
+#include "editorFold.hpp"
+#include "editorMem.hpp"
+#include "editorTrace.hpp"
+#include <climits>
+#include <vector>
+
+/*** layout index ***/
+
+// Lines each row takes at the width it was last measured at, and a Fenwick tree over them in which
+// folded rows count none, so a row and its line convert in log time. A new width only gets the rows
+// around the screen measured, editorWrapIdle gets to the others a slice at a time. Until then those keep
+// what they took at the old width: lines far off the screen are numbered differently, the ones on it
+// are laid out right. Rows moving leave the tree out of date from the first one on, the next lookup
+// brings it back.
+struct wrapIndex {
+	std::vector<int> lines; // lines of each row, folds not counted
+	std::vector<int> tree;	// 1 based, entry i sums rows [i - lowbit(i), i)
+	int width;
+	int dirty;			// the tree is out of date past this entry, INT_MAX when it is not
+	int sweep;			// rows from here on may still be measured at an older width
+	long long tracked;	// bytes reported to the memory accounting
+};
+
+static bool wrapping; // soft wrap is on, in every buffer
+
+static inline int lowbit(int i) {
+	return i & -i;
+}
+
+static int textWidth() {
+	return E.viewcols > 0 ? E.viewcols : 1;
+}
+
+// the last line takes the column after the end too, the cursor may stand there
+static inline int measure(int rsize, int width) {
+	return rsize / width + 1;
+}
+
+static void track(wrapIndex* ix) {
+	long long bytes = static_cast<long long>((ix->lines.capacity() + ix->tree.capacity()) * sizeof(int));
+	editorMemAdd(MEM_WRAP, bytes - ix->tracked);
+	ix->tracked = bytes;
+}
+
+void editorWrapFree(wrapIndex* ix) {
+	if (ix == NULL)
+		return;
+	editorMemAdd(MEM_WRAP, -ix->tracked);
+	delete ix;
+}
+
+// Entries past dirty are summed again from the rows, with the ones below them that are still right
+// added in. A row's weight is its lines, nothing when a fold hides it.
+static void rebuild(wrapIndex* ix) {
+	int n = static_cast<int>(ix->lines.size());
+	int d = ix->dirty;
+	ix->dirty = INT_MAX;
+	if (static_cast<int>(ix->tree.size()) != n + 1) {
+		ix->tree.resize(n + 1);
+		track(ix);
+	}
+	if (d >= n)
+		return;
+	TRACE_SCOPE("wrapRebuild");
+	int r = d;
+	if (editorFoldHidden(r)) {
+		for (int end = editorFoldNext(r); r < end && r < n; r++)
+			ix->tree[r + 1] = 0;
+	}
+	while (r < n) {
+		ix->tree[r + 1] = ix->lines[r];
+		int end = editorFoldEnd(r);
+		for (r++; r <= end && r < n; r++)
+			ix->tree[r + 1] = 0;
+	}
+	for (int i = d + 1; i <= n; i++) {
+		for (int step = lowbit(i) / 2; step > 0; step /= 2)
+			if (i - step <= d)
+				ix->tree[i] += ix->tree[i - step];
+		if (i + lowbit(i) <= n)
+			ix->tree[i + lowbit(i)] += ix->tree[i];
+	}
+}
+
+// the index of the shown buffer ready for a lookup, NULL with wrap off
+static wrapIndex* ready() {
+	if (!wrapping)
+		return NULL;
+	wrapIndex* ix = E.wraps;
+	if (ix == NULL) {
+		// every row counts one line until it is measured
+		ix = E.wraps = new wrapIndex();
+		ix->lines.assign(E.numrows, 1);
+		ix->width = textWidth();
+		ix->dirty = 0;
+		ix->sweep = 0;
+		ix->tracked = 0;
+	}
+	if (ix->dirty != INT_MAX)
+		rebuild(ix);
+	return ix;
+}
+
+// lines of the rows before row
+static int prefix(const wrapIndex* ix, int row) {
+	int sum = 0;
+	for (int i = row; i > 0; i -= lowbit(i))
+		sum += ix->tree[i];
+	return sum;
+}
+
+// measures row at the index's width, the tree follows unless it is rebuilt from there anyway
+static void remeasure(wrapIndex* ix, int row) {
+	int now = measure(E.row[row].rsize, ix->width);
+	int delta = now - ix->lines[row];
+	if (delta == 0)
+		return;
+	ix->lines[row] = now;
+	if (row >= ix->dirty || editorFoldHidden(row))
+		return;
+	int n = static_cast<int>(ix->lines.size());
+	for (int i = row + 1; i <= n && i <= ix->dirty; i += lowbit(i))
+		ix->tree[i] += delta;
+}
+
+/*** lines ***/
+
+bool editorWrapActive() {
+	return wrapping;
+}
+
+// the first line row is on
+int editorWrapLine(int row) {
+	wrapIndex* ix = ready();
+	if (ix == NULL)
+		return editorFoldLine(row);
+	int n = static_cast<int>(ix->lines.size());
+	if (row > n)
+		return prefix(ix, n) + row - n;
+	return prefix(ix, row < 0 ? 0 : row);
+}
+
+// the row on line, *sub is which of its lines that is
+int editorWrapRow(int line, int* sub) {
+	*sub = 0;
+	wrapIndex* ix = ready();
+	if (ix == NULL)
+		return editorFoldRow(line);
+	int n = static_cast<int>(ix->lines.size());
+	int step = 1;
+	while (step * 2 <= n)
+		step *= 2;
+	// the most rows whose lines all come before this one
+	int pos = 0;
+	for (; step > 0; step /= 2) {
+		if (pos + step <= n && ix->tree[pos + step] <= line) {
+			pos += step;
+			line -= ix->tree[pos];
+		}
+	}
+	if (pos >= n)
+		return n + line;
+	*sub = line;
+	return pos;
+}
+
+// which of its row's lines screen column rx is on
+int editorWrapSub(int rx) {
+	return wrapping ? rx / textWidth() : 0;
+}
+
+// where on its line screen column rx is drawn
+int editorWrapColumn(int rx) {
+	return wrapping ? rx % textWidth() : rx - E.coloff;
+}
+
+// the line at the top of the text area
+int editorWrapTop() {
+	return editorWrapLine(E.rowoff) + (wrapping ? E.wrapoff : 0);
+}
+
+/*** measuring ***/
+
+// a screen of rows from row on, walking up or down
+static void remeasureFrom(wrapIndex* ix, int row, int dir) {
+	for (int k = 0; k < E.viewrows && row >= 0 && row < E.numrows; k++) {
+		remeasure(ix, row);
+		row = dir > 0 ? editorFoldNext(row) : editorFoldPrev(row);
+	}
+}
+
+// A resize or a pane of another width starts measuring every row again. The rows a scroll can bring
+// up next are done now, whatever is above the cursor or below the top, the rest is left to the idle ticks.
+void editorWrapViewport() {
+	wrapIndex* ix = ready();
+	if (ix == NULL)
+		return;
+	if (ix->width != textWidth()) {
+		ix->width = textWidth();
+		ix->sweep = 0;
+	}
+	remeasureFrom(ix, E.rowoff, 1);
+	remeasureFrom(ix, E.cy, -1);
+	remeasureFrom(ix, E.cy, 1);
+}
+
+// the row was rendered again, its width may have changed
+void editorWrapRowSized(int row) {
+	wrapIndex* ix = E.wraps;
+	if (ix == NULL || row < 0 || row >= static_cast<int>(ix->lines.size()))
+		return;
+	remeasure(ix, row);
+}
+
+// a fold from row on opened or closed, the rows it hides count no lines
+void editorWrapFoldsChanged(int row) {
+	wrapIndex* ix = E.wraps;
+	if (ix != NULL && row < ix->dirty)
+		ix->dirty = row < 0 ? 0 : row;
+}
+
+// rows [at, at + del) were replaced by ins others, they count a line each until they are rendered
+void editorWrapRowsMoved(int at, int del, int ins) {
+	wrapIndex* ix = E.wraps;
+	if (ix == NULL)
+		return;
+	int n = static_cast<int>(ix->lines.size());
+	if (at > n)
+		at = n;
+	if (del > n - at)
+		del = n - at;
+	if (del > 0)
+		ix->lines.erase(ix->lines.begin() + at, ix->lines.begin() + at + del);
+	if (ins > 0)
+		ix->lines.insert(ix->lines.begin() + at, ins, 1);
+	if (ix->sweep >= at + del)
+		ix->sweep += ins - del;
+	else if (ix->sweep > at)
+		ix->sweep = at;
+	if (at < ix->dirty)
+		ix->dirty = at;
+	track(ix);
+}
+
+// measures a slice of the rows a new width left behind, returns true while some are left
+bool editorWrapIdle() {
+	wrapIndex* ix = E.wraps;
+	if (ix == NULL)
+		return false;
+	int n = static_cast<int>(ix->lines.size());
+	if (ix->sweep >= n)
+		return false;
+	int end = n - ix->sweep > WRAP_SLICE ? ix->sweep + WRAP_SLICE : n;
+	for (int r = ix->sweep; r < end; r++)
+		remeasure(ix, r);
+	ix->sweep = end;
+	return end < n;
+}
+
+void editorWrapToggle() {
+	wrapping = !wrapping;
+	E.wrapoff = 0;
+	E.coloff = 0;
+	editorSetStatusMessage(wrapping ? "Soft wrap on" : "Soft wrap off");
+}
@@ -1,18 +1,91 @@
 #include "editor.hpp"
+#include "editorHeadless.hpp"
+#include "editorHud.hpp"
+#include "editorPager.hpp"
+#include "editorTheme.hpp"
+#include "editorTrace.hpp"
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 
+static int usage(const char* program) {
+	std::cerr << "Usage: " << program
+			  << " [--pager[=<MB>]] [--record=<script>] [--replay=<script> [--size=<rows>x<cols>]]\n"
+			  << "       [--trace=<file>] [--latency-log=<file>] [--theme=<name | file>] [--colors=16|256|true] [file | -]"
+			  << std::endl;
+	return 1;
+}
+
 int main(int argc, char** argv) {
+	const char* replay = nullptr;
+	int rows = HEADLESS_DEFAULT_ROWS;
+	int cols = HEADLESS_DEFAULT_COLS;
+	editorThemeInit();
+	int argi = 1;
+	for (; argi < argc && strncmp(argv[argi], "--", 2) == 0; argi++) {
+		if (strcmp(argv[argi], "--pager") == 0) {
+			editorPagerRequest(0);
+		} else if (strncmp(argv[argi], "--pager=", 8) == 0) {
+			editorPagerRequest(atoll(argv[argi] + 8) << 20);
+		} else if (strncmp(argv[argi], "--replay=", 9) == 0) {
+			replay = argv[argi] + 9;
+		} else if (strncmp(argv[argi], "--record=", 9) == 0) {
+			if (!editorRecordStart(argv[argi] + 9)) {
+				std::cerr << "Cannot write " << argv[argi] + 9 << std::endl;
+				return 1;
+			}
+		} else if (strncmp(argv[argi], "--trace=", 8) == 0) {
+			if (!editorTraceStart(argv[argi] + 8)) {
+				std::cerr << "Built without tracing, rebuild with -DKILO_TRACE=ON" << std::endl;
+				return 1;
+			}
+		} else if (strncmp(argv[argi], "--latency-log=", 14) == 0) {
+			if (!editorHudLogStart(argv[argi] + 14)) {
+				std::cerr << "Cannot write " << argv[argi] + 14 << std::endl;
+				return 1;
+			}
+		} else if (strncmp(argv[argi], "--theme=", 8) == 0) {
+			if (!editorThemeLoad(argv[argi] + 8)) {
+				std::cerr << "Cannot load theme " << argv[argi] + 8 << std::endl;
+				return 1;
+			}
+		} else if (strcmp(argv[argi], "--colors=16") == 0) {
+			editorSetColorDepth(COLOR_16);
+		} else if (strcmp(argv[argi], "--colors=256") == 0) {
+			editorSetColorDepth(COLOR_256);
+		} else if (strcmp(argv[argi], "--colors=true") == 0) {
+			editorSetColorDepth(COLOR_TRUE);
+		} else if (strncmp(argv[argi], "--size=", 7) == 0) {
+			if (sscanf(argv[argi] + 7, "%dx%d", &rows, &cols) != 2)
+				return usage(argv[0]);
+		} else {
+			return usage(argv[0]);
+		}
+	}
+	if (replay && !editorHeadlessStart(replay, rows, cols)) {
+		std::cerr << "Cannot read " << replay << std::endl;
+		return 1;
+	}
+
 	std::string filepath;
-	if (argc == 1) {
+	if (argi == argc && replay) {
+		// no one to ask, a replay without a file starts empty
+	} else if (argi == argc) {
 		std::cout << "Enter filename (or just press enter): ";
 		getline(std::cin, filepath);
+	} else {
+		filepath = argv[argi];
 	}
-	filepath = filepath;
 	if (filepath.empty()) {
 		editorStart(nullptr);
 	} else {
 		editorStart(filepath.c_str());
 	}
+	editorRecordStop();
+	editorTraceStop();
+	editorHudLogStop();
+	if (replay)
+		editorHeadlessReport(stdout);
 	return 0;
 }
\ No newline at end of file